@@ -1,7 +1,12 @@
 #include "App.h"
+#include "CollisionSystem.h"
 #include "SiloSystem.h"
+#include "util/alloc.h"
+#include "util/profile.h"
 
 #include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #include <glm/gtc/matrix_transform.hpp>
@@ -19,66 +24,35 @@ static double const SHIP_MISSILE_SPEED = 500.0f;
 static int const SILO_COUNT = 5;
 static int const SHIP_COUNT = 10;
 
-std::string const CAMERAS[] = {"View: Front", "View: Top", "View: Unum", "View: Duo", "View: Ship"};
-float const THRUSTS[] = {250.0f, 1250.0f, 5000.0f};
+// The ship gets a larger bounding sphere for collision detection, as do missiles (see SiloSystem).
+static float const SHIP_COLLISION_PADDING = 10.0f;
+
+// Masses of the bodies which attract under gravity (see GravitySystem). Ruber's
+// pull on the ship is what it was before any other bodies attracted.
+static float const RUBER_MASS = 90000000.0f;
+static float const UNUM_MASS = 1000000.0f;
+static float const DUO_MASS = 2000000.0f;
+static float const PRIMUS_MASS = 250000.0f;
+static float const SECUNDUS_MASS = 500000.0f;
+static float const SHIP_MASS = 1.0f;
+
+// Silo beacons and missile engine glows are dynamic point lights.
+static LightComponent const SILO_BEACON{glm::vec3{0.0f, 150.0f, 0.0f}, glm::vec3{1.0f, 0.1f, 0.1f}, 2.0f, 800.0f};
+
 static std::string const WARPS[] = {"View: Unum", "View: Duo"};
 static double const SCALINGS[] = {
   1.00, // ACE_SPEED
   0.40, // PILOT_SPEED
   0.16, // TRAINEE_SPEED
   0.08, // DEBUG_SPEED
+  10.0, // WARP_10
+  100.0, // WARP_100
+  1000.0, // WARP_1000
 };
 
-// Query result object for interfacing with the EntityDatabase
-struct OrbitalEntity {
-  std::string id;
-  PositionComponent* position;
-  OrbitComponent* orbit;
-};
-template<>
-struct EntityQuery<OrbitalEntity> {
-  typedef OrbitalEntity Entity;
-
-  static bool Query(EntityDatabase& entities, std::string id, OrbitalEntity* const entity) {
-    auto posItr = entities.positions.find(id);
-    auto orbitItr = entities.orbits.find(id);
-
-    if (posItr == entities.positions.end() || orbitItr == entities.orbits.end()) {
-      return false;
-    }
-
-    entity->id = id;
-    entity->position = &posItr->second;
-    entity->orbit = &orbitItr->second;
-    return true;
-  }
-};
-
-// Query result object for interfacing with the EntityDatabase
-struct CollidableEntity {
-  std::string id;
-  PositionComponent* position;
-  ModelComponent* model;
-};
-
-template<>
-struct EntityQuery<CollidableEntity> {
-  typedef CollidableEntity Entity;
-
-  static bool Query(EntityDatabase& entities, std::string id, CollidableEntity* const entity) {
-    auto posItr = entities.positions.find(id);
-    auto modelItr = entities.models.find(id);
-
-    if (posItr == entities.positions.end() || modelItr == entities.models.end()) {
-      return false;
-    }
-
-    entity->id = id;
-    entity->position = &posItr->second;
-    entity->model = &modelItr->second;
-    return true;
-  }
-};
+// The longest single time step, in game seconds, taken while nothing is close to interacting.
+// Orbits, coasting missiles and timers are exact over steps of any length.
+static double const COARSE_STEP = 1.0;
 
 
 // Provides the current time-coupling between the game world and the real world.
@@ -86,7 +60,7 @@ double App::GetTimeScaling() const {
   return SCALINGS[this->state.time_scaling_idx];
 }
 
-void App::OnAcquireContext(GLFWwindow* window) {
+void App::OnAcquireContext(GLFWwindow* window, AssetRegistry& registry) {
   cout << "Running version " << VERSION
        << " with OpenGL version " << glGetString(GL_VERSION)
        << ", GLSL version " << glGetString(GL_SHADING_LANGUAGE_VERSION)
@@ -112,52 +86,59 @@ void App::OnAcquireContext(GLFWwindow* window) {
   // Clearing the color buffer will make everything black.
   glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 
-  // Load our models into GPU memory
-  this->debugMesh = loadMeshFromFile("models/debug.tri");
-  this->ruberMesh = loadMeshFromFile("models/ruber.tri");
-  this->unumMesh = loadMeshFromFile("models/unum.tri");
-  this->duoMesh = loadMeshFromFile("models/duo.tri");
-  this->primusMesh = loadMeshFromFile("models/primus.tri");
-  this->secundusMesh = loadMeshFromFile("models/secundus.tri");
-  this->siloMesh = loadMeshFromFile("models/silo.tri");
-  this->shipMesh = loadMeshFromFile("models/ship.tri");
-  this->missileMesh = loadMeshFromFile("models/missile.tri");
-
-  // Give ships and missiles a larger bounding sphere for collision detection
-  this->shipMesh.boundingRadius += 10;
-  this->missileMesh.boundingRadius += 10;
+  // Load our models into GPU memory, along with any assets queued before us.
+  this->debugMesh = registry.LoadMesh("models/debug.tri");
+  this->ruberMesh = registry.LoadMesh("models/ruber.tri");
+  this->unumMesh = registry.LoadMesh("models/unum.tri");
+  this->duoMesh = registry.LoadMesh("models/duo.tri");
+  this->primusMesh = registry.LoadMesh("models/primus.tri");
+  this->secundusMesh = registry.LoadMesh("models/secundus.tri");
+  this->siloMesh = registry.LoadMesh("models/silo.tri");
+  this->shipMesh = registry.LoadMesh("models/ship.tri");
+  this->missileMesh = registry.LoadMesh("models/missile.tri");
+  registry.Finish();
 
   // Instantiate the Ruber system orbiting bodies.
   {
     state.entities.positions.insert(std::make_pair("Ruber", PositionComponent{"::world", glm::vec3{0.0f, 0.0f, 0.0f}}));
-    state.entities.models.insert(std::make_pair("Ruber", ModelComponent{&this->ruberMesh}));
+    state.entities.models.insert(std::make_pair("Ruber", ModelComponent{this->ruberMesh}));
+    state.entities.masses.insert(std::make_pair("Ruber", MassComponent{RUBER_MASS, true}));
 
     state.entities.positions.insert(std::make_pair("Unum", PositionComponent{"Ruber", glm::vec3{4000.0f, 0.0f, 0.0f}}));
-    state.entities.orbits.insert(std::make_pair("Unum", OrbitComponent{2.0*M_PI/63.0, 2.0*M_PI/63.0}));
-    state.entities.models.insert(std::make_pair("Unum", ModelComponent{&this->unumMesh}));
+    state.entities.orbits.insert(std::make_pair("Unum", OrbitComponent{glm::vec3{4000.0f, 0.0f, 0.0f}, 2.0*M_PI/63.0, 2.0*M_PI/63.0}));
+    state.entities.models.insert(std::make_pair("Unum", ModelComponent{this->unumMesh}));
+    state.entities.masses.insert(std::make_pair("Unum", MassComponent{UNUM_MASS}));
 
     state.entities.positions.insert(std::make_pair("Unum Silo", PositionComponent{"Unum", glm::vec3{0.0f, 250.0f, 0.0f}}));
-    state.entities.models.insert(std::make_pair("Unum Silo", ModelComponent{&this->siloMesh}));
+    state.entities.models.insert(std::make_pair("Unum Silo", ModelComponent{this->siloMesh}));
     state.entities.silos.insert(std::make_pair("Unum Silo", SiloComponent{SILO_COUNT, SILO_RANGE, MISSILE_RANGE, SILO_MISSILE_SPEED}));
+    state.entities.lights.insert(std::make_pair("Unum Silo", SILO_BEACON));
+    state.entities.schedules.insert(std::make_pair("Unum Silo", ScheduleComponent{}));
 
     state.entities.positions.insert(std::make_pair("Duo", PositionComponent{"Ruber", glm::vec3{-9000.0f, 0.0f, 0.0f}}));
-    state.entities.orbits.insert(std::make_pair("Duo", OrbitComponent{2.0*M_PI/126.0, 2.0*M_PI/126.0}));
-    state.entities.models.insert(std::make_pair("Duo", ModelComponent{&this->duoMesh}));
+    state.entities.orbits.insert(std::make_pair("Duo", OrbitComponent{glm::vec3{-9000.0f, 0.0f, 0.0f}, 2.0*M_PI/126.0, 2.0*M_PI/126.0}));
+    state.entities.models.insert(std::make_pair("Duo", ModelComponent{this->duoMesh}));
+    state.entities.masses.insert(std::make_pair("Duo", MassComponent{DUO_MASS}));
 
     state.entities.positions.insert(std::make_pair("Primus", PositionComponent{"Duo", glm::vec3{900.0f, 0.0f, 0.0f}}));
-    state.entities.orbits.insert(std::make_pair("Primus", OrbitComponent{2.0*M_PI/63.0, 2.0*M_PI/63.0}));
-    state.entities.models.insert(std::make_pair("Primus", ModelComponent{&this->primusMesh}));
+    state.entities.orbits.insert(std::make_pair("Primus", OrbitComponent{glm::vec3{900.0f, 0.0f, 0.0f}, 2.0*M_PI/63.0, 2.0*M_PI/63.0}));
+    state.entities.models.insert(std::make_pair("Primus", ModelComponent{this->primusMesh}));
+    state.entities.masses.insert(std::make_pair("Primus", MassComponent{PRIMUS_MASS}));
 
     state.entities.positions.insert(std::make_pair("Secundus", PositionComponent{"Duo", glm::vec3{1750.0f, 0.0f, 0.0f}}));
-    state.entities.orbits.insert(std::make_pair("Secundus", OrbitComponent{2.0*M_PI/126.0, 2.0*M_PI/126.0}));
-    state.entities.models.insert(std::make_pair("Secundus", ModelComponent{&this->secundusMesh}));
+    state.entities.orbits.insert(std::make_pair("Secundus", OrbitComponent{glm::vec3{1750.0f, 0.0f, 0.0f}, 2.0*M_PI/126.0, 2.0*M_PI/126.0}));
+    state.entities.models.insert(std::make_pair("Secundus", ModelComponent{this->secundusMesh}));
+    state.entities.masses.insert(std::make_pair("Secundus", MassComponent{SECUNDUS_MASS}));
 
     state.entities.positions.insert(std::make_pair("Secundus Silo", PositionComponent{"Secundus", glm::vec3{0.0f, 200.0f, 0.0f}}));
-    state.entities.models.insert(std::make_pair("Secundus Silo", ModelComponent{&this->siloMesh}));
+    state.entities.models.insert(std::make_pair("Secundus Silo", ModelComponent{this->siloMesh}));
     state.entities.silos.insert(std::make_pair("Secundus Silo", SiloComponent{SILO_COUNT, SILO_RANGE, MISSILE_RANGE, SILO_MISSILE_SPEED}));
+    state.entities.lights.insert(std::make_pair("Secundus Silo", SILO_BEACON));
+    state.entities.schedules.insert(std::make_pair("Secundus Silo", ScheduleComponent{}));
 
     state.entities.positions.insert(std::make_pair("ship", PositionComponent{"::world", glm::vec3{5000.0f, 1000.0f, 5000.0f}}));
-    state.entities.models.insert(std::make_pair("ship", ModelComponent{&this->shipMesh}));
+    state.entities.models.insert(std::make_pair("ship", ModelComponent{this->shipMesh, SHIP_COLLISION_PADDING}));
+    state.entities.masses.insert(std::make_pair("ship", MassComponent{SHIP_MASS}));
     state.entities.silos.insert(std::make_pair("ship", SiloComponent{SHIP_COUNT, SHIP_RANGE, MISSILE_RANGE, SHIP_MISSILE_SPEED}));
   }
 
@@ -188,8 +169,8 @@ void App::OnReleaseContext() {
 static bool g_IS_MODDED = false;
 
 // Computes the view matrix from the world to the given entity.
-glm::mat4 App::GetViewMatrix(std::string const& id) const {
-  PositionComponent const& position = state.entities.positions.at(id);
+glm::mat4 App::GetViewMatrix(std::string const& id) {
+  PositionComponent const& position = state.entities.GetPosition(id);
   CameraComponent const& camera = state.entities.cameras.at(id);
 
   glm::mat4 viewMatrix = glm::lookAt(
@@ -199,36 +180,19 @@ glm::mat4 App::GetViewMatrix(std::string const& id) const {
   );
 
   if (state.entities.positions.find(position.parent) != state.entities.positions.end()) {
-    PositionComponent const& parent = state.entities.positions.at(position.parent);
+    PositionComponent const& parent = state.entities.GetPosition(position.parent);
     viewMatrix *= glm::mat4_cast(glm::inverse(parent.orientation));
   }
 
   PositionComponent const* current = &position;
   while (state.entities.positions.find(current->parent) != state.entities.positions.end()) {
-    current = &state.entities.positions.at(current->parent);
+    current = &state.entities.GetPosition(current->parent);
     viewMatrix *= glm::translate(glm::mat4{1.0f}, -current->translation);
   }
 
   return viewMatrix;
 }
 
-// Computes the model matrix from the given entity to the world.
-glm::mat4 App::GetWorldMatrix(std::string const& id) const {
-  PositionComponent const& position = state.entities.positions.at(id);
-
-  glm::mat4 worldMatrix =
-      glm::translate(glm::mat4{1.0f}, position.translation)
-    * glm::mat4_cast(position.orientation);
-
-  PositionComponent const* current = &position;
-  while (state.entities.positions.find(current->parent) != state.entities.positions.end()) {
-    current = &state.entities.positions.at(current->parent);
-    worldMatrix = glm::translate(glm::mat4{1.0f}, current->translation) * worldMatrix;
-  }
-
-  return worldMatrix;
-}
-
 // Processes keyboard input.
 void App::OnKeyEvent(int key, int action, int mods) {
   // This is a workaround for a bug in GLFW which prevents modifier key releases
@@ -257,13 +221,22 @@ void App::OnKeyEvent(int key, int action, int mods) {
   } else if (action == GLFW_PRESS && key == GLFW_KEY_G) {
     this->state.gravity_enabled = !this->state.gravity_enabled;
   } else if (action == GLFW_PRESS && key == GLFW_KEY_F) {
-    SiloSystem::FireMissile(state, "ship", SILO_TARGETING, &this->missileMesh);
+    SiloSystem::FireMissile(state, "ship", SILO_TARGETING, this->missileMesh);
   } else if (action == GLFW_PRESS && key == GLFW_KEY_A) {
     this->state.is_lit_global = !state.is_lit_global;
   } else if (action == GLFW_PRESS && key == GLFW_KEY_P) {
     this->state.is_lit_ruber = !state.is_lit_ruber;
   } else if (action == GLFW_PRESS && key == GLFW_KEY_H) {
     this->state.is_lit_headlight = !state.is_lit_headlight;
+  } else if (action == GLFW_PRESS && key == GLFW_KEY_C) {
+    this->state.gpu_driven = !state.gpu_driven;
+  } else if (action == GLFW_PRESS && key == GLFW_KEY_F3) {
+    this->state.show_hud = !state.show_hud;
+  } else if (action == GLFW_PRESS && key == GLFW_KEY_F12) {
+    // Only does anything if the profiler, or allocation tracking, is compiled in.
+    printProfileStats();
+    writeProfileTrace();
+    printAllocStats();
   }
 }
 
@@ -302,8 +275,111 @@ static void get_input_vectors(GLFWwindow* const window, glm::vec3* const rotatio
   }
 }
 
+// An upper bound on how fast an entity moves through the world over the next
+// coarse step, in units per second, from its own orbit or fall and those of its
+// ancestors.
+static double GetSpeedBound(EntityDatabase& entities, std::string const& id) {
+  double speed = 0.0;
+  for (auto positionItr = entities.positions.find(id); positionItr != entities.positions.end(); positionItr = entities.positions.find(positionItr->second.parent)) {
+    std::string const* current = &positionItr->first;
+
+    auto orbitItr = entities.orbits.find(*current);
+    if (orbitItr != entities.orbits.end()) {
+      speed += fabs(orbitItr->second.orbital_velocity) * glm::length(orbitItr->second.epoch_translation);
+    }
+
+    auto fallItr = entities.falls.find(*current);
+    if (fallItr != entities.falls.end()) {
+      speed += glm::length(fallItr->second.velocity) + glm::length(fallItr->second.acceleration) * COARSE_STEP;
+    }
+  }
+  return speed;
+}
+
+double App::GetStepSize(double fine_step, double available) {
+  double const steps = floor(std::min(GetCoarseStepLimit(), available) / fine_step);
+  return std::max(steps, 1.0) * fine_step;
+}
+
+double App::GetCoarseStepLimit() {
+  double limit = COARSE_STEP;
+
+  // A steered ship needs every step. (A falling one doesn't: GravitySystem substeps it.)
+  bool const ship_alive = !state.entities.silos.at("ship").destroyed;
+  if (ship_alive) {
+    glm::vec3 rotation{0.0f};
+    glm::vec3 translation{0.0f};
+    get_input_vectors(this->window, &rotation, &translation);
+    if (glm::length(rotation) != 0 || glm::length(translation) != 0) {
+      return 0.0;
+    }
+  }
+
+  // Missiles coast in straight lines until they start homing, which needs every step.
+  double const homing_time_to_live = MissileComponent::MAX_LIFETIME - MissileComponent::IDLE_PERIOD;
+  for (auto const& missile : state.entities.missiles) {
+    double const idle_left = missile.second.time_to_live - homing_time_to_live;
+    if (idle_left <= 0) {
+      return 0.0;
+    }
+    limit = std::min(limit, idle_left);
+  }
+
+  if (!ship_alive) {
+    return limit;
+  }
+
+  glm::vec3 const ship_position = state.entities.GetWorldPosition("ship");
+  double const ship_speed = GetSpeedBound(state.entities, "ship");
+
+  // Silos fire as soon as the ship comes within range, so don't step past that.
+  for (auto const& silo : state.entities.silos) {
+    SiloComponent const& component = silo.second;
+    if (component.range <= 0.0 || component.destroyed || component.missiles <= 0 || component.current_missile != "") {
+      continue;
+    }
+
+    glm::vec3 const silo_position = state.entities.GetWorldPosition(silo.first);
+    double const gap = glm::length(silo_position - ship_position) - component.range;
+    double const speed = ship_speed + GetSpeedBound(state.entities, silo.first);
+    if (gap <= 0.0) {
+      return 0.0;
+    } else if (speed > 0.0) {
+      limit = std::min(limit, gap / speed);
+    }
+  }
+
+  // Nor past the ship touching anything. (CollisionSystem skips anything whose mesh
+  // is still loading, the ship included.)
+  ModelComponent const& ship_model = state.entities.models.at("ship");
+  if (!ship_model.mesh) {
+    return limit;
+  }
+  float const ship_radius = ship_model.mesh->boundingRadius + ship_model.collisionPadding;
+  for (auto entity : state.entities.Query<CollidableEntity>()) {
+    if (*entity.id == "ship" || state.entities.missiles.find(*entity.id) != state.entities.missiles.end() || !entity.model->mesh) {
+      continue;
+    }
+
+    glm::vec3 const position = state.entities.GetWorldPosition(*entity.id);
+    float const radius = entity.model->mesh->boundingRadius + entity.model->collisionPadding;
+    double const gap = glm::length(position - ship_position) - (ship_radius + radius);
+    double const speed = ship_speed + GetSpeedBound(state.entities, *entity.id);
+    if (gap <= 0.0) {
+      return 0.0;
+    } else if (speed > 0.0) {
+      limit = std::min(limit, gap / speed);
+    }
+  }
+
+  return limit;
+}
+
 // Updates the application state.
 void App::OnTimeStep(double delta) {
+  PROFILE_ZONE("App::OnTimeStep");
+  ALLOC_SCOPE("App::OnTimeStep");
+
   // Handle ship navigation, if we aren't dead...
   if (!state.entities.silos.at("ship").destroyed) {
     // ship navigation
@@ -329,103 +405,8 @@ void App::OnTimeStep(double delta) {
 
     // Orient the translation vector down the ship's heading.
     ship_position.translation += ship_position.orientation * translation;
-
-    // Update ship's position with respect to Ruber's gravity
-    if (this->state.gravity_enabled) {
-      PositionComponent& sun_position = state.entities.positions.at("Ruber");
-
-      glm::vec3 distance_vector = sun_position.translation - ship_position.translation;
-      float distance = glm::length(distance_vector);
-
-      glm::vec3 gravity_vector = (90000000.0f / (distance*distance)) * (distance_vector / distance);
-      ship_position.translation += gravity_vector * (float)delta;
-    }
   }
 
-  // Update all orbiting bodies
-  for (auto entity : state.entities.Query<OrbitalEntity>()) {
-    // Rotate the entity
-    if (glm::length(entity.orbit->angular_velocity) != 0) {
-      entity.position->orientation =
-          glm::normalize(glm::rotate(
-            entity.position->orientation,
-            glm::length(entity.orbit->angular_velocity * (float)delta),
-            entity.orbit->angular_velocity
-          ));
-    }
-
-    // Translate the entity
-    entity.position->translation = glm::rotate(
-      entity.position->translation,
-      (float)(entity.orbit->orbital_velocity * delta),
-      glm::vec3{0.0f, 1.0f, 0.0f}
-    );
-  }
-
-  // Check for collisions.
-  auto view = state.entities.Query<CollidableEntity>();
-  for (auto itr1 = view.begin(); itr1 != view.end();) {
-    auto entity = *itr1;
-    bool entity_destroyed = false;
-
-    // Don't test missiles which are not targeting for collision
-    if (state.entities.missiles.find(entity.id) != state.entities.missiles.end()) {
-      if (state.entities.missiles.at(entity.id).time_to_live > MissileComponent::MAX_LIFETIME - MissileComponent::IDLE_PERIOD) {
-        ++itr1;
-        continue;
-      }
-    }
-
-    for (auto itr2 = view.begin(); itr2 != view.end();) {
-      auto collidable = *itr2;
-      auto collidable_destroyed = false;
-
-      // Don't test missiles which are not targeting for collision
-      if (state.entities.missiles.find(collidable.id) != state.entities.missiles.end()) {
-        if (state.entities.missiles.at(collidable.id).time_to_live > MissileComponent::MAX_LIFETIME - MissileComponent::IDLE_PERIOD) {
-          ++itr2;
-          continue;
-        }
-      }
-
-      // Don't collide with ourself
-      if (collidable.id != entity.id) {
-        glm::vec3 pos1 = glm::vec3{GetWorldMatrix(entity.id) * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
-        glm::vec3 pos2 = glm::vec3{GetWorldMatrix(collidable.id) * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
-
-        if (glm::length(pos2 - pos1) < entity.model->mesh->boundingRadius + collidable.model->mesh->boundingRadius) {
-        // Collision! The bounding spheres overlap.
-          if (state.entities.silos.find(entity.id) != state.entities.silos.end()) {
-          // Mark silos as destroyed
-            state.entities.silos.at(entity.id).destroyed = true;
-          } else if (state.entities.missiles.find(entity.id) != state.entities.missiles.end()) {
-          // Remove missiles from the database
-            entity_destroyed = true;
-            state.entities.silos.at(state.entities.missiles.at(entity.id).owner).current_missile = "";
-          }
-
-          if (state.entities.silos.find(collidable.id) != state.entities.silos.end()) {
-          // Mark silos as destroyed
-            state.entities.silos.at(collidable.id).destroyed = true;
-          } else if (state.entities.missiles.find(collidable.id) != state.entities.missiles.end()) {
-          // Remove missiles from the database
-            collidable_destroyed = true;
-            state.entities.silos.at(state.entities.missiles.at(collidable.id).owner).current_missile = "";
-          }
-        }
-      }
-
-      if (collidable_destroyed) {
-        itr2.remove();
-      } else {
-        ++itr2;
-      }
-    }
-
-    if (entity_destroyed) {
-      itr1.remove();
-    } else {
-      ++itr1;
-    }
-  }
+  // Advance the clock. Orbiting bodies follow it as they're looked at.
+  state.entities.time += delta;
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "AssetRegistry.h"
 #include "Mesh.h"
 #include "GameState.h"
 #include "EntityDatabase.h"
@@ -21,7 +22,8 @@
 // A structure representing top-level information about the application.
 class App  {
 public:
-  void OnAcquireContext(GLFWwindow* window);
+  // Loads the app's assets through `registry`, and waits for every asset queued on it.
+  void OnAcquireContext(GLFWwindow* window, AssetRegistry& registry);
   void OnReleaseContext();
 
   void OnKeyEvent(int key, int action, int mods);
@@ -30,23 +32,31 @@ public:
   // Returns the simulation's clock speed in game seconds per real second.
   double GetTimeScaling() const;
 
+  // Returns how long the next time step should be: a whole number of `fine_step`s,
+  // at most `available` (unless that is less than one), and only one while
+  // anything is steering, homing, or close to firing or colliding.
+  double GetStepSize(double fine_step, double available);
+
 protected:
-  glm::mat4 GetViewMatrix(std::string const& id) const;
-  glm::mat4 GetWorldMatrix(std::string const& id) const;
+  // Not const: looking at an orbiting body positions it (see EntityDatabase::GetPosition).
+  glm::mat4 GetViewMatrix(std::string const& id);
+
+  // How long the simulation can step in one go before anything could interact.
+  double GetCoarseStepLimit();
 
 private:
   GLFWwindow* window = nullptr;  // The GLFW window for this app
 
 public:
-  Mesh debugMesh;  // A mesh meant for testing and debugging.
-  Mesh ruberMesh;
-  Mesh unumMesh;
-  Mesh duoMesh;
-  Mesh primusMesh;
-  Mesh secundusMesh;
-  Mesh siloMesh;
-  Mesh shipMesh;
-  Mesh missileMesh;
+  MeshHandle debugMesh;  // A mesh meant for testing and debugging.
+  MeshHandle ruberMesh;
+  MeshHandle unumMesh;
+  MeshHandle duoMesh;
+  MeshHandle primusMesh;
+  MeshHandle secundusMesh;
+  MeshHandle siloMesh;
+  MeshHandle shipMesh;
+  MeshHandle missileMesh;
 
   GameState state;
 };
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <memory>
+
+struct Mesh;
+struct Texture;
+
+// A shared reference to an asset held by an AssetRegistry.
+//
+// An asset stays resident for as long as any handle to it exists. Once the last
+// one goes, the registry may evict it to stay within its memory budget; until
+// then, asking the registry for the same asset again returns it without reloading.
+//
+// A handle is returned as soon as its asset is queued, and reads as null until
+// the asset's upload completes (see AssetLoader::Finish and Poll).
+template<typename T>
+class AssetHandle {
+private:
+  // Shared by every handle to the asset, and by the registry's entry for it.
+  // The inner pointer is filled in by the upload, and may be shared with other
+  // entries whose content turned out to be identical.
+  std::shared_ptr<std::shared_ptr<T>> ref;
+
+public:
+  AssetHandle() {}
+  explicit AssetHandle(std::shared_ptr<std::shared_ptr<T>> ref)
+    : ref{std::move(ref)}
+  {}
+
+  T const* get() const {
+    return this->ref ? this->ref->get() : nullptr;
+  }
+
+  T const& operator*() const {
+    return *get();
+  }
+
+  T const* operator->() const {
+    return get();
+  }
+
+  explicit operator bool() const {
+    return get() != nullptr;
+  }
+};
+
+typedef AssetHandle<Mesh> MeshHandle;
+typedef AssetHandle<Texture> TextureHandle;
@@ -0,0 +1,142 @@
+#include "AssetLoader.h"
+#include "util/profile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+
+// Seconds elapsed between two clock readings.
+template<typename TimePoint>
+static double SecondsBetween(TimePoint from, TimePoint to) {
+  return std::chrono::duration<double>(to - from).count();
+}
+
+AssetLoader::AssetLoader(unsigned worker_count) {
+  for (unsigned i = 0; i < std::max(worker_count, 1u); ++i) {
+    this->workers.emplace_back(&AssetLoader::RunWorker, this);
+  }
+}
+
+AssetLoader::~AssetLoader() {
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    this->stopping = true;
+  }
+  this->pending_ready.notify_all();
+
+  for (auto& worker : this->workers) {
+    worker.join();
+  }
+}
+
+unsigned AssetLoader::GetDefaultWorkerCount() {
+  // Leave a core for the GL thread, which is busy uploading meanwhile.
+  unsigned const cores = std::thread::hardware_concurrency();
+  return (cores > 1) ? cores - 1 : 1;
+}
+
+void AssetLoader::Load(std::string const& name, std::function<void()> read, std::function<void()> upload) {
+  std::unique_ptr<Asset> asset{new Asset{name, std::move(read), std::move(upload), 0.0, 0.0}};
+
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    if (this->assets.empty()) {
+      this->start = Clock::now();
+    }
+    this->pending.push_back(asset.get());
+  }
+  this->assets.push_back(std::move(asset));
+  this->pending_ready.notify_one();
+}
+
+void AssetLoader::Finish() {
+  while (this->uploaded < this->assets.size()) {
+    Asset* asset = nullptr;
+    {
+      std::unique_lock<std::mutex> lock{this->mutex};
+      this->completed_ready.wait(lock, [this]() { return !this->completed.empty(); });
+      asset = this->completed.front();
+      this->completed.pop_front();
+    }
+    Upload(asset);
+  }
+
+  if (!this->assets.empty()) {
+    Report();
+  }
+}
+
+void AssetLoader::Poll() {
+  while (true) {
+    Asset* asset = nullptr;
+    {
+      std::lock_guard<std::mutex> lock{this->mutex};
+      if (this->completed.empty()) {
+        break;
+      }
+      asset = this->completed.front();
+      this->completed.pop_front();
+    }
+    Upload(asset);
+  }
+
+  if (!this->assets.empty() && this->uploaded == this->assets.size()) {
+    Report();
+  }
+}
+
+void AssetLoader::Upload(Asset* const asset) {
+  Clock::time_point const upload_start = Clock::now();
+  asset->upload();
+  asset->uploadSeconds = SecondsBetween(upload_start, Clock::now());
+  this->uploaded += 1;
+}
+
+void AssetLoader::Report() {
+  double total_read = 0.0;
+  double total_upload = 0.0;
+  printf("Loaded %u assets on %u threads in %.1f ms:\n",
+    (unsigned)this->assets.size(),
+    (unsigned)this->workers.size(),
+    1000.0 * SecondsBetween(this->start, Clock::now())
+  );
+  for (auto const& asset : this->assets) {
+    printf("  %-28s read %7.2f ms, upload %6.2f ms\n", asset->name.c_str(), 1000.0 * asset->readSeconds, 1000.0 * asset->uploadSeconds);
+    total_read += asset->readSeconds;
+    total_upload += asset->uploadSeconds;
+  }
+  printf("  %-28s read %7.2f ms, upload %6.2f ms\n", "(sum)", 1000.0 * total_read, 1000.0 * total_upload);
+
+  this->assets.clear();
+  this->uploaded = 0;
+}
+
+void AssetLoader::RunWorker() {
+  nameProfileThread("asset loader");
+
+  while (true) {
+    Asset* asset = nullptr;
+    {
+      std::unique_lock<std::mutex> lock{this->mutex};
+      this->pending_ready.wait(lock, [this]() { return this->stopping || !this->pending.empty(); });
+      if (this->pending.empty()) {
+        return;  // Stopping, with nothing left to read
+      }
+      asset = this->pending.front();
+      this->pending.pop_front();
+    }
+
+    Clock::time_point const read_start = Clock::now();
+    {
+      PROFILE_ZONE("AssetLoader read");
+      asset->read();
+    }
+    asset->readSeconds = SecondsBetween(read_start, Clock::now());
+
+    {
+      std::lock_guard<std::mutex> lock{this->mutex};
+      this->completed.push_back(asset);
+    }
+    this->completed_ready.notify_one();
+  }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Loads assets in parallel at startup.
+//
+// Each asset is loaded in two steps. A `read` step reads and decodes the asset's
+// files into memory; it runs on a pool of worker threads, and must make no GL
+// calls. An `upload` step then hands the result to GL; it runs on the thread
+// that owns the GL context, inside Finish or Poll, once the asset's read completes.
+// GL setup on the main thread (compiling shaders, say) therefore overlaps with
+// the file reads, and uploads overlap with the reads still in flight.
+//
+// Once every queued asset is uploaded, Finish or Poll reports how long each spent
+// in each step.
+class AssetLoader {
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Asset {
+    std::string name;
+    std::function<void()> read;
+    std::function<void()> upload;
+
+    double readSeconds;
+    double uploadSeconds;
+  };
+
+  std::vector<std::thread> workers;
+
+  std::mutex mutex;
+  std::condition_variable pending_ready;  // Signalled when `pending` gains an asset, or on shutdown
+  std::condition_variable completed_ready;  // Signalled when `completed` gains an asset
+  std::deque<Asset*> pending;  // Queued for reading
+  std::deque<Asset*> completed;  // Read, and queued for uploading
+  bool stopping = false;
+
+  std::vector<std::unique_ptr<Asset>> assets;  // Every asset queued since the last report
+  size_t uploaded = 0;  // How many of `assets` have been uploaded
+  Clock::time_point start;  // When the first of `assets` was queued
+
+public:
+  // Starts `worker_count` worker threads; by default, one per spare CPU core.
+  explicit AssetLoader(unsigned worker_count = GetDefaultWorkerCount());
+  ~AssetLoader();
+
+  AssetLoader(AssetLoader const&) = delete;
+  AssetLoader& operator=(AssetLoader const&) = delete;
+
+  static unsigned GetDefaultWorkerCount();
+
+  // Queues an asset. `read` runs on a worker thread; `upload` runs later, on the
+  // thread that calls Finish or Poll. `name` identifies the asset in the timing report.
+  void Load(std::string const& name, std::function<void()> read, std::function<void()> upload);
+
+  // Uploads every queued asset as its read completes, and returns once all of them are loaded.
+  // Must be called on the thread that owns the GL context.
+  void Finish();
+
+  // Uploads the queued assets whose reads have completed, without waiting for the rest.
+  // Meant to be called once per frame, on the thread that owns the GL context.
+  void Poll();
+
+private:
+  void RunWorker();
+  void Upload(Asset* const asset);
+
+  // Prints how long each asset took, and forgets them. Every one must be uploaded.
+  void Report();
+};
@@ -0,0 +1,358 @@
+#include "AssetRegistry.h"
+#include "util/alloc.h"
+#include "util/arena.h"
+#include "util/profile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+// Resolves `.`, `..` and symbolic links, so that every path to a file gives the same key.
+// Paths which don't resolve (say, to a missing file) are used as given.
+static std::string CanonicalPath(char const* path) {
+  char* const resolved = realpath(path, nullptr);
+  if (!resolved) {
+    return path;
+  }
+
+  std::string const result{resolved};
+  free(resolved);
+  return result;
+}
+
+// Folds `size` bytes into a 64-bit FNV-1a hash.
+static uint64_t HashBytes(uint64_t hash, void const* data, size_t size) {
+  unsigned char const* const bytes = static_cast<unsigned char const*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+  }
+  return hash;
+}
+
+// Hashes everything that ends up on the GPU for a mesh.
+static uint64_t HashLoadedMesh(LoadedMesh const& loaded) {
+  uint64_t hash = 0xCBF29CE484222325ull;
+  std::vector<MeshLod> lods;
+  if (loaded.file) {
+    MeshFileHeader const& header = loaded.file->GetHeader();
+    hash = HashBytes(hash, loaded.file->GetVertices(), header.vertex_bytes);
+    hash = HashBytes(hash, loaded.file->GetIndices(), header.index_count * sizeof(GLuint));
+    hash = HashBytes(hash, header.position_offset, sizeof(header.position_offset));
+    hash = HashBytes(hash, header.position_scale, sizeof(header.position_scale));
+    hash = HashBytes(hash, &header.bounding_radius, sizeof(header.bounding_radius));
+    lods = loaded.file->GetLods();
+  } else {
+    MeshData const& data = loaded.data;
+    hash = HashBytes(hash, data.vertices.data(), data.vertices.size() * sizeof(PackedVertex));
+    hash = HashBytes(hash, data.indices.data(), data.indices.size() * sizeof(GLuint));
+    hash = HashBytes(hash, &data.positionOffset[0], sizeof(data.positionOffset));
+    hash = HashBytes(hash, &data.positionScale[0], sizeof(data.positionScale));
+    hash = HashBytes(hash, &data.boundingRadius, sizeof(data.boundingRadius));
+    lods = data.lods;
+  }
+  return HashBytes(hash, lods.data(), lods.size() * sizeof(MeshLod));
+}
+
+// The GPU memory a mesh's vertex and index buffers will take up.
+static size_t GetMeshGpuBytes(LoadedMesh const& loaded) {
+  if (loaded.file) {
+    MeshFileHeader const& header = loaded.file->GetHeader();
+    return header.vertex_bytes + header.index_count * sizeof(GLuint);
+  } else {
+    return loaded.data.vertices.size() * sizeof(PackedVertex) + loaded.data.indices.size() * sizeof(GLuint);
+  }
+}
+
+AssetRegistry::AssetRegistry(AssetLoader& loader, size_t budget_bytes)
+  : loader(loader), budgetBytes{budget_bytes}
+{}
+
+AssetRegistry::Entry* AssetRegistry::GetEntry(std::string const& key, Kind kind, bool* const created) {
+  auto itr = this->entries.find(key);
+  if (itr != this->entries.end()) {
+    *created = false;
+    return itr->second.get();
+  }
+
+  std::unique_ptr<Entry> entry{new Entry{}};
+  entry->key = key;
+  entry->kind = kind;
+  entry->lastUsed = this->generation;
+
+  *created = true;
+  return this->entries.insert(std::make_pair(key, std::move(entry))).first->second.get();
+}
+
+MeshHandle AssetRegistry::LoadMesh(char const* tri_path) {
+  typedef std::shared_ptr<Mesh> MeshRef;
+
+  bool created = false;
+  Entry* const entry = GetEntry(CanonicalPath(tri_path), Kind::MESH, &created);
+  if (!created) {
+    return MeshHandle{std::static_pointer_cast<MeshRef>(entry->handle)};
+  }
+
+  std::shared_ptr<MeshRef> const ref = std::make_shared<MeshRef>();
+  entry->name = tri_path;
+  entry->handle = ref;
+
+  // Shared between the two steps; freed (unmapping any .mesh file) once the last of them is done.
+  // The entry can't be evicted in the meantime, as it has no resource yet.
+  std::shared_ptr<LoadedMesh> loaded{new LoadedMesh{}};
+  std::string const path{tri_path};
+
+  this->loader.Load(
+    path,
+    [loaded, path, entry]() {
+      if (readMeshFromFile(path.c_str(), loaded.get())) {
+        entry->contentHash = HashLoadedMesh(*loaded);
+      }
+    },
+    [this, loaded, path, entry]() {
+      MeshRef& mesh = *std::static_pointer_cast<MeshRef>(entry->handle);
+
+      // Share the buffers of an identical mesh, if one is resident.
+      // (Unreadable meshes have no hash, and are never shared.)
+      if (entry->contentHash != 0) {
+        for (auto const& item : this->entries) {
+          Entry const& other = *item.second;
+          if (&other != entry && other.kind == Kind::MESH && other.resource && other.contentHash == entry->contentHash) {
+            mesh = std::static_pointer_cast<Mesh>(other.resource);
+            entry->resource = other.resource;
+            entry->cpuBytes = other.cpuBytes;
+            entry->gpuBytes = other.gpuBytes;
+            return;
+          }
+        }
+      }
+
+      mesh.reset(new Mesh{uploadMesh(path.c_str(), *loaded)});
+      entry->resource = mesh;
+      entry->cpuBytes = sizeof(Mesh) + mesh->lods.capacity() * sizeof(MeshLod);
+      entry->gpuBytes = GetMeshGpuBytes(*loaded);
+    }
+  );
+
+  return MeshHandle{ref};
+}
+
+TextureHandle AssetRegistry::LoadCubeMap(char const* const face_paths[6], int edge) {
+  typedef std::shared_ptr<Texture> TextureRef;
+
+  std::string key;
+  for (int face = 0; face < 6; ++face) {
+    key += (face > 0 ? "|" : "") + CanonicalPath(face_paths[face]);
+  }
+
+  bool created = false;
+  Entry* const entry = GetEntry(key, Kind::TEXTURE, &created);
+  if (!created) {
+    return TextureHandle{std::static_pointer_cast<TextureRef>(entry->handle)};
+  }
+
+  // Create the cube map now, and fill in each of its six square faces as they are read.
+  // Faces are compressed, with mip chains, where the driver allows.
+  bool const compressed = isTextureCompressionSupported();
+  TextureRef const texture = compressed
+    ? TextureRef{new Texture{createCompressedCubeMap(edge), GL_TEXTURE_CUBE_MAP, 6 * getCompressedTextureBytes(edge, edge)}}
+    : TextureRef{new Texture{createCubeMap(edge), GL_TEXTURE_CUBE_MAP, 6 * 3 * (size_t)edge * (size_t)edge}};
+  std::shared_ptr<TextureRef> const ref = std::make_shared<TextureRef>(texture);
+  entry->name = std::string{face_paths[0]} + " (cube map)";
+  entry->handle = ref;
+  entry->resource = texture;
+  entry->cpuBytes = sizeof(Texture);
+  entry->gpuBytes = texture->bytes;
+
+  // Each face is mapped and paged in on a worker, then streamed into the cube map a
+  // little each frame by Update, straight from the mapping.
+  if (!this->streamer) {
+    this->streamer.reset(new TextureStreamer{});
+  }
+  TextureStreamer* const streamer = this->streamer.get();
+
+  for (int face = 0; face < 6 && compressed; ++face) {
+    std::shared_ptr<LoadedTexture> loaded{new LoadedTexture{}};
+    std::string const path{face_paths[face]};
+    this->loader.Load(
+      path,
+      [loaded, path, edge]() {
+        if (readCompressedTexture(path.c_str(), edge, edge, loaded.get()) && loaded->file) {
+          for (int level = 0; level < getLoadedTextureLevelCount(*loaded); ++level) {
+            prefaultPages(getLoadedTextureLevel(*loaded, level), loaded->file->GetHeader().levels[level].bytes);
+          }
+        }
+      },
+      [streamer, loaded, face, texture, edge]() {
+        for (int level = 0; level < getLoadedTextureLevelCount(*loaded); ++level) {
+          int const level_edge = getTextureLevelSize(edge, level);
+          streamer->StreamImage(
+            texture,
+            GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level,
+            level_edge, level_edge,
+            TEXTURE_COMPRESSED_FORMAT,
+            getLoadedTextureLevel(*loaded, level),
+            loaded
+          );
+        }
+      }
+    );
+  }
+
+  for (int face = 0; face < 6 && !compressed; ++face) {
+    std::shared_ptr<MappedRawFile> file{new MappedRawFile{}};
+    std::string const path{face_paths[face]};
+    this->loader.Load(
+      path,
+      [file, path, edge]() {
+        if (file->Open(path.c_str(), edge, edge)) {
+          prefaultPages(file->GetData(), file->GetSize());
+        }
+      },
+      [streamer, file, face, texture, edge]() {
+        streamer->StreamImage(
+          texture,
+          GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0,
+          edge, edge,
+          GL_RGB,
+          file->GetData(),
+          file
+        );
+      }
+    );
+  }
+
+  return TextureHandle{ref};
+}
+
+void AssetRegistry::Finish() {
+  this->loader.Finish();
+  PrintReport();
+}
+
+bool AssetRegistry::IsReferenced(Entry const& entry) {
+  return entry.handle.use_count() > 1;
+}
+
+void AssetRegistry::Update() {
+  PROFILE_ZONE("AssetRegistry::Update");
+  ALLOC_SCOPE("AssetRegistry::Update");
+
+  // Assets asked for after Finish arrive here, a frame or so after their reads complete.
+  this->loader.Poll();
+
+  if (this->streamer) {
+    this->streamer->Update();
+  }
+
+  Collect();
+}
+
+void AssetRegistry::Collect() {
+  this->generation += 1;
+  for (auto const& item : this->entries) {
+    if (IsReferenced(*item.second)) {
+      item.second->lastUsed = this->generation;
+    }
+  }
+
+  size_t cpu_bytes = 0;
+  size_t gpu_bytes = 0;
+  SumBytes(&cpu_bytes, &gpu_bytes);
+  if (cpu_bytes + gpu_bytes <= this->budgetBytes) {
+    return;
+  }
+
+  // Assets still loading have no resource yet, and aren't candidates.
+  FrameVector<Entry*> candidates{FrameAllocator<Entry*>{getFrameArena()}};
+  for (auto const& item : this->entries) {
+    if (item.second->resource && !IsReferenced(*item.second)) {
+      candidates.push_back(item.second.get());
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(), [](Entry const* a, Entry const* b) {
+    return a->lastUsed < b->lastUsed;
+  });
+
+  for (Entry* const entry : candidates) {
+    if (cpu_bytes + gpu_bytes <= this->budgetBytes) {
+      break;
+    }
+
+    // An asset whose content another entry shares stays resident for that entry.
+    bool shared = false;
+    for (auto const& item : this->entries) {
+      shared = shared || (item.second.get() != entry && item.second->resource == entry->resource);
+    }
+
+    if (!shared) {
+      if (entry->kind == Kind::MESH) {
+        Mesh const& mesh = *static_cast<Mesh const*>(entry->resource.get());
+        for (auto const& listener : this->meshEvictionListeners) {
+          listener(mesh);
+        }
+      }
+
+      cpu_bytes -= entry->cpuBytes;
+      gpu_bytes -= entry->gpuBytes;
+      printf("Evicted %s (%.1f KB)\n", entry->name.c_str(), (entry->cpuBytes + entry->gpuBytes) / 1024.0);
+    }
+
+    this->entries.erase(entry->key);
+  }
+}
+
+void AssetRegistry::AddMeshEvictionListener(std::function<void(Mesh const&)> listener) {
+  this->meshEvictionListeners.push_back(std::move(listener));
+}
+
+void AssetRegistry::SumBytes(size_t* const cpu_bytes, size_t* const gpu_bytes) const {
+  // Runs every frame, so the list of resources seen lives in the frame arena.
+  FrameVector<void const*> counted{FrameAllocator<void const*>{getFrameArena()}};
+  counted.reserve(this->entries.size());
+  *cpu_bytes = 0;
+  *gpu_bytes = 0;
+  for (auto const& item : this->entries) {
+    Entry const& entry = *item.second;
+    if (entry.resource && std::find(counted.begin(), counted.end(), entry.resource.get()) == counted.end()) {
+      counted.push_back(entry.resource.get());
+      *cpu_bytes += entry.cpuBytes;
+      *gpu_bytes += entry.gpuBytes;
+    }
+  }
+}
+
+size_t AssetRegistry::GetCpuBytes() const {
+  size_t cpu_bytes = 0;
+  size_t gpu_bytes = 0;
+  SumBytes(&cpu_bytes, &gpu_bytes);
+  return cpu_bytes;
+}
+
+size_t AssetRegistry::GetGpuBytes() const {
+  size_t cpu_bytes = 0;
+  size_t gpu_bytes = 0;
+  SumBytes(&cpu_bytes, &gpu_bytes);
+  return gpu_bytes;
+}
+
+void AssetRegistry::PrintReport() const {
+  size_t cpu_bytes = 0;
+  size_t gpu_bytes = 0;
+  SumBytes(&cpu_bytes, &gpu_bytes);
+
+  printf("%u resident assets hold %.1f KB of CPU memory and %.1f KB of GPU memory (budget %.1f MB):\n",
+    (unsigned)this->entries.size(),
+    cpu_bytes / 1024.0,
+    gpu_bytes / 1024.0,
+    this->budgetBytes / (1024.0 * 1024.0)
+  );
+  for (auto const& item : this->entries) {
+    Entry const& entry = *item.second;
+    printf("  %-28s cpu %8.1f KB, gpu %8.1f KB, %u references\n",
+      entry.name.c_str(),
+      entry.cpuBytes / 1024.0,
+      entry.gpuBytes / 1024.0,
+      (unsigned)(entry.handle.use_count() - 1)
+    );
+  }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "AssetHandle.h"
+#include "AssetLoader.h"
+#include "Mesh.h"
+#include "Texture.h"
+#include "TextureStream.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Owns the app's meshes and textures, and loads each of them once.
+//
+// Assets are asked for by path, and are returned as shared handles (see AssetHandle.h),
+// loading through an AssetLoader. Paths are canonicalized, so two spellings of one
+// file share an entry. Meshes are also hashed as they're read; a mesh whose content
+// matches one already resident shares its GPU buffers instead of being uploaded again.
+//
+// The registry tracks the CPU and GPU memory of every asset. An asset which nothing
+// references any more stays resident, in case it's asked for again, until Collect
+// finds the registry over its budget; then such assets are evicted, least recently
+// used first. Referenced assets are never evicted, whatever the budget.
+class AssetRegistry {
+private:
+  enum class Kind {
+    MESH,
+    TEXTURE,
+  };
+
+  struct Entry {
+    std::string key;  // Canonical path of the asset's file(s)
+    std::string name;  // The path the asset was first asked for by, for reports
+    Kind kind = Kind::MESH;
+    std::shared_ptr<void> handle;  // The shared state of the asset's handles
+    std::shared_ptr<void> resource;  // The asset itself; null until uploaded
+    uint64_t contentHash = 0;  // Hash of a mesh's data, to spot duplicates by
+    size_t cpuBytes = 0;  // Host memory held by the asset
+    size_t gpuBytes = 0;  // GPU memory held by the asset
+    uint64_t lastUsed = 0;  // The last generation in which the asset was referenced
+  };
+
+  AssetLoader& loader;
+  size_t budgetBytes;  // Total CPU and GPU memory to evict unreferenced assets down to
+
+  std::unordered_map<std::string, std::unique_ptr<Entry>> entries;  // By key
+  uint64_t generation = 0;  // Counts calls to Collect
+
+  std::vector<std::function<void(Mesh const&)>> meshEvictionListeners;
+
+  std::unique_ptr<TextureStreamer> streamer;  // Created with the first texture
+
+public:
+  AssetRegistry(AssetLoader& loader, size_t budget_bytes);
+
+  AssetRegistry(AssetRegistry const&) = delete;
+  AssetRegistry& operator=(AssetRegistry const&) = delete;
+
+  // Returns the mesh of the given .TRI file, queueing it on the loader if it isn't
+  // resident or already on its way.
+  MeshHandle LoadMesh(char const* tri_path);
+
+  // Returns a cube map built from six .RAW faces of `edge` pixels square, in
+  // GL_TEXTURE_CUBE_MAP_POSITIVE_X order, queueing the faces if need be.
+  // The texture exists straight away; its faces fill in over the frames after
+  // they're loaded, as Update streams them in.
+  TextureHandle LoadCubeMap(char const* const face_paths[6], int edge);
+
+  // Uploads every queued asset, as AssetLoader::Finish, then reports what's resident.
+  void Finish();
+
+  // Uploads any assets whose reads have completed, streams the next part of any
+  // loaded textures into place, then collects. Never waits on a read.
+  // Meant to be called once per frame, on the thread that owns the GL context.
+  void Update();
+
+  // Evicts unreferenced assets until the registry is within budget, least recently
+  // used first. Meant to be called once per frame, on the thread that owns the GL context.
+  void Collect();
+
+  // Registers a function to call just before a mesh is destroyed by eviction, so
+  // that anything keeping data about it by address can let go.
+  void AddMeshEvictionListener(std::function<void(Mesh const&)> listener);
+
+  // Memory held by resident assets. Assets sharing their content are counted once.
+  size_t GetCpuBytes() const;
+  size_t GetGpuBytes() const;
+
+  void PrintReport() const;
+
+private:
+  // Returns the entry with the given key, and whether it was just created.
+  Entry* GetEntry(std::string const& key, Kind kind, bool* const created);
+
+  // Sums the memory of the distinct resident assets.
+  void SumBytes(size_t* const cpu_bytes, size_t* const gpu_bytes) const;
+
+  // Whether anything besides the registry holds a handle to the entry's asset.
+  static bool IsReferenced(Entry const& entry);
+};
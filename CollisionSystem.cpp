@@ -0,0 +1,87 @@
+#include "CollisionSystem.h"
+#include "util/alloc.h"
+#include "util/profile.h"
+
+void CollisionSystem::Update(GameState& state, double /*delta*/) {
+  PROFILE_ZONE("CollisionSystem::Update");
+  ALLOC_SCOPE("CollisionSystem::Update");
+
+  auto view = state.entities.Query<CollidableEntity>();
+  for (auto itr1 = view.begin(); itr1 != view.end();) {
+    auto entity = *itr1;
+    bool entity_destroyed = false;
+
+    // Entities whose meshes are still loading have no bounds to test yet
+    if (!entity.model->mesh) {
+      ++itr1;
+      continue;
+    }
+
+    // Don't test missiles which are not targeting for collision
+    if (state.entities.missiles.find(*entity.id) != state.entities.missiles.end()) {
+      if (state.entities.missiles.at(*entity.id).time_to_live > MissileComponent::MAX_LIFETIME - MissileComponent::IDLE_PERIOD) {
+        ++itr1;
+        continue;
+      }
+    }
+
+    for (auto itr2 = view.begin(); itr2 != view.end();) {
+      auto collidable = *itr2;
+      auto collidable_destroyed = false;
+
+      if (!collidable.model->mesh) {
+        ++itr2;
+        continue;
+      }
+
+      // Don't test missiles which are not targeting for collision
+      if (state.entities.missiles.find(*collidable.id) != state.entities.missiles.end()) {
+        if (state.entities.missiles.at(*collidable.id).time_to_live > MissileComponent::MAX_LIFETIME - MissileComponent::IDLE_PERIOD) {
+          ++itr2;
+          continue;
+        }
+      }
+
+      // Don't collide with ourself
+      if (*collidable.id != *entity.id) {
+        glm::vec3 pos1 = glm::vec3{state.entities.GetWorldMatrix(*entity.id) * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
+        glm::vec3 pos2 = glm::vec3{state.entities.GetWorldMatrix(*collidable.id) * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
+
+        float const radius1 = entity.model->mesh->boundingRadius + entity.model->collisionPadding;
+        float const radius2 = collidable.model->mesh->boundingRadius + collidable.model->collisionPadding;
+        if (glm::length(pos2 - pos1) < radius1 + radius2) {
+        // Collision! The bounding spheres overlap.
+          if (state.entities.silos.find(*entity.id) != state.entities.silos.end()) {
+          // Mark silos as destroyed
+            state.entities.silos.at(*entity.id).destroyed = true;
+          } else if (state.entities.missiles.find(*entity.id) != state.entities.missiles.end()) {
+          // Remove missiles from the database
+            entity_destroyed = true;
+            state.entities.silos.at(state.entities.missiles.at(*entity.id).owner).current_missile = "";
+          }
+
+          if (state.entities.silos.find(*collidable.id) != state.entities.silos.end()) {
+          // Mark silos as destroyed
+            state.entities.silos.at(*collidable.id).destroyed = true;
+          } else if (state.entities.missiles.find(*collidable.id) != state.entities.missiles.end()) {
+          // Remove missiles from the database
+            collidable_destroyed = true;
+            state.entities.silos.at(state.entities.missiles.at(*collidable.id).owner).current_missile = "";
+          }
+        }
+      }
+
+      if (collidable_destroyed) {
+        itr2.remove();
+      } else {
+        ++itr2;
+      }
+    }
+
+    if (entity_destroyed) {
+      itr1.remove();
+    } else {
+      ++itr1;
+    }
+  }
+}
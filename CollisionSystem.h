@@ -0,0 +1,39 @@
+#pragma once
+
+#include "GameState.h"
+
+#include <string>
+
+// Query result object for interfacing with the EntityDatabase
+struct CollidableEntity {
+  std::string const* id;  // The entity's key in `positions`
+  PositionComponent* position;
+  ModelComponent* model;
+};
+
+template<>
+struct EntityQuery<CollidableEntity> {
+  typedef CollidableEntity Entity;
+
+  static bool Query(EntityDatabase& entities, std::string const& id, CollidableEntity* const entity) {
+    auto posItr = entities.positions.find(id);
+    auto modelItr = entities.models.find(id);
+
+    if (posItr == entities.positions.end() || modelItr == entities.models.end()) {
+      return false;
+    }
+
+    entity->id = &posItr->first;
+    entity->position = &posItr->second;
+    entity->model = &modelItr->second;
+    return true;
+  }
+};
+
+// Tests every pair of entities with models for overlapping bounding spheres. Silos
+// which are hit are destroyed, and missiles which hit anything are removed. Missiles
+// still idling after launch are left out, so they don't hit the silo which fired them.
+class CollisionSystem {
+public:
+  void Update(GameState& state, double delta);
+};
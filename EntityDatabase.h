@@ -4,10 +4,13 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 #include <glm/gtx/rotate_vector.hpp>
+#include <cmath>
+#include <limits>
 #include <string>
 #include <unordered_map>
 #include <iostream>
 
+#include "AssetHandle.h"
 #include "Mesh.h"
 
 // The type of entity which a missile will target when in targeting mode.
@@ -16,15 +19,26 @@ enum targeting_mode {
   SHIP_TARGETING,
 };
 
+// A body in a circular orbit about its parent, spinning about its own axis.
+//
+// Orbits are closed-form: the body's position is a pure function of simulation
+// time (see evaluateOrbit), computed only when someone asks for it, and cached
+// in its PositionComponent until the time changes.
 struct OrbitComponent {
-  // Angular velocity relative to the parent.
+  // Translation relative to the parent at time zero.
+  glm::vec3 epoch_translation{0.0f};
+
+  // Angular velocity relative to the parent, about the parent's Y axis.
   double orbital_velocity = 0.0;
 
   // Angular velocity relative to the entity's center.
   glm::vec3 angular_velocity{0.0f, 0.0f, 0.0f};
 
-  OrbitComponent(double orbital_velocity, float yaw_velocity)
-    : orbital_velocity{orbital_velocity}, angular_velocity{0.0f, yaw_velocity, 0.0f}
+  // The simulation time the entity's position was last evaluated at; NaN if never.
+  double evaluated_time = std::numeric_limits<double>::quiet_NaN();
+
+  OrbitComponent(glm::vec3 epoch_translation, double orbital_velocity, float yaw_velocity)
+    : epoch_translation{epoch_translation}, orbital_velocity{orbital_velocity}, angular_velocity{0.0f, yaw_velocity, 0.0f}
   {}
 };
 
@@ -43,11 +57,89 @@ struct PositionComponent {
   {}
 };
 
+// Positions an orbiting body as of the given simulation time, unless it's there already.
+inline void evaluateOrbit(OrbitComponent& orbit, double time, PositionComponent* const position) {
+  if (orbit.evaluated_time == time) {
+    return;
+  }
+
+  // Reduce angles in double precision, so that they stay exact however long the game runs.
+  double const two_pi = 2.0 * M_PI;
+  float const orbit_angle = (float)std::fmod(orbit.orbital_velocity * time, two_pi);
+  position->translation = glm::rotate(orbit.epoch_translation, orbit_angle, glm::vec3{0.0f, 1.0f, 0.0f});
+
+  float const spin_velocity = glm::length(orbit.angular_velocity);
+  if (spin_velocity != 0) {
+    float const spin_angle = (float)std::fmod((double)spin_velocity * time, two_pi);
+    position->orientation = glm::angleAxis(spin_angle, orbit.angular_velocity / spin_velocity);
+  }
+
+  orbit.evaluated_time = time;
+}
+
 struct ModelComponent {
-  Mesh const* mesh = nullptr;
+  MeshHandle mesh;
+  int lod = 0;  // The level of detail of `mesh` drawn last frame
 
-  ModelComponent(Mesh const* mesh)
-    : mesh{mesh}
+  // Extra room around the mesh's bounding sphere when testing for collisions.
+  float collisionPadding = 0.0f;
+
+  ModelComponent(MeshHandle mesh, float collision_padding = 0.0f)
+    : mesh{mesh}, collisionPadding{collision_padding}
+  {}
+};
+
+// A source of gravity. Free bodies with mass (those neither orbiting, riding on
+// another entity, nor anchored) also fall under gravity; see GravitySystem.
+struct MassComponent {
+  float mass = 0.0f;  // In game units, where the gravitational constant is 1
+
+  // Attracts, but is never moved by gravity itself (the sun, which everything orbits).
+  bool anchored = false;
+
+  MassComponent(float mass, bool anchored = false)
+    : mass{mass}, anchored{anchored}
+  {}
+};
+
+// The motion a free body has picked up by falling under gravity, on top of whatever
+// moves it directly (thrust, say). Kept by GravitySystem.
+struct FallComponent {
+  // In world units per second.
+  glm::vec3 velocity{0.0f};
+
+  // The gravitational acceleration at the end of the last step.
+  glm::vec3 acceleration{0.0f};
+};
+
+// How often an entity is simulated; see ScheduleSystem.
+struct ScheduleComponent {
+  // A fixed tier to simulate the entity in, or -1 to choose one by distance.
+  int priority = -1;
+
+  // Kept by ScheduleSystem:
+  int tier = 0;  // This step's tier; 0 is simulated every step
+  double offset = 0.0;  // Staggers the entity's updates, as a fraction of its tier's period
+  double updated_time = std::numeric_limits<double>::quiet_NaN();  // Simulation time of its last update
+  bool due = true;  // Whether to update the entity this step
+  double elapsed = 0.0;  // Simulation time since the update before this step's, if due
+
+  ScheduleComponent(int priority = -1)
+    : priority{priority}
+  {}
+};
+
+struct LightComponent {
+  // Position of the light relative to the entity's origin, in the entity's frame.
+  glm::vec3 offset{0.0f, 0.0f, 0.0f};
+  // Color and brightness of the light
+  glm::vec3 color{1.0f, 1.0f, 1.0f};
+  float intensity = 1.0f;
+  // Distance beyond which the light has no effect
+  float radius = 100.0f;
+
+  LightComponent(glm::vec3 offset, glm::vec3 color, float intensity, float radius)
+    : offset{offset}, color{color}, intensity{intensity}, radius{radius}
   {}
 };
 
@@ -118,13 +210,17 @@ struct MissileComponent {
  * To query the database, implement a new entity type representing the "result row",
  * and implement a template specialization for EntityQuery on your new type, with
  * fields as depicted by the comments in the definitiomn of EntityQuery below.
+ *
+ * Queries run for every entity on every step, so result rows should only point
+ * into the tables (at the entity's key in `positions`, say) rather than copy
+ * anything out of them. A copied string would cost a heap allocation per entity.
  */
 struct EntityDatabase;
 
 template<typename T>
 struct EntityQuery {
   // typedef T Entity;
-  // static bool Query(EntityDatabase& /*entities*/, std::string /*id*/, Entity* const /*entity*/);
+  // static bool Query(EntityDatabase& /*entities*/, std::string const& /*id*/, Entity* const /*entity*/);
 };
 
 struct EntityDatabase {
@@ -132,9 +228,58 @@ struct EntityDatabase {
   std::unordered_map<std::string, PositionComponent> positions;
   std::unordered_map<std::string, OrbitComponent> orbits;
   std::unordered_map<std::string, ModelComponent> models;
+  std::unordered_map<std::string, LightComponent> lights;
   std::unordered_map<std::string, CameraComponent> cameras;
   std::unordered_map<std::string, SiloComponent> silos;
   std::unordered_map<std::string, MissileComponent> missiles;
+  std::unordered_map<std::string, MassComponent> masses;
+  std::unordered_map<std::string, FallComponent> falls;
+  std::unordered_map<std::string, ScheduleComponent> schedules;
+
+  // Simulation time, in seconds. Orbiting bodies are positioned as a function of it.
+  double time = 0.0;
+
+  // Returns an entity's position, first bringing it up to date with `time` if the entity orbits.
+  PositionComponent& GetPosition(std::string const& id) {
+    PositionComponent& position = positions.at(id);
+
+    auto orbitItr = orbits.find(id);
+    if (orbitItr != orbits.end()) {
+      evaluateOrbit(orbitItr->second, time, &position);
+    }
+
+    return position;
+  }
+
+  // Computes the model matrix from the given entity to the world. Parents contribute
+  // their translations, not their orientations.
+  glm::mat4 GetWorldMatrix(std::string const& id) {
+    PositionComponent const* current = &GetPosition(id);
+
+    glm::mat4 worldMatrix =
+        glm::translate(glm::mat4{1.0f}, current->translation)
+      * glm::mat4_cast(current->orientation);
+
+    while (positions.find(current->parent) != positions.end()) {
+      current = &GetPosition(current->parent);
+      worldMatrix = glm::translate(glm::mat4{1.0f}, current->translation) * worldMatrix;
+    }
+
+    return worldMatrix;
+  }
+
+  // Returns an entity's position in the world, summing its translation with its parents'.
+  glm::vec3 GetWorldPosition(std::string const& id) {
+    PositionComponent const* current = &GetPosition(id);
+    glm::vec3 position = current->translation;
+
+    while (positions.find(current->parent) != positions.end()) {
+      current = &GetPosition(current->parent);
+      position += current->translation;
+    }
+
+    return position;
+  }
 
   template<typename T>
   class Iterator {
@@ -144,45 +289,36 @@ struct EntityDatabase {
     EntityDatabase& entities;
     inner_iterator itr;
     inner_iterator const end;
+    value_type entity;  // The result row for `itr`, if it isn't `end`
 
-  public:
-    Iterator(EntityDatabase& entities, inner_iterator itr, inner_iterator end)
-      : entities(entities), itr{itr}, end{end}
-    {
-      // Make sure `itr` either points to a matching entity or to `end`
-      value_type entity;
-      while (this->itr != end) {
-        if (EntityQuery<T>::Query(entities, this->itr->first, &entity)) {
+    // Moves `itr` forward to the next matching entity (starting with its own), or to `end`.
+    void Seek() {
+      while (this->itr != this->end) {
+        if (EntityQuery<T>::Query(this->entities, this->itr->first, &this->entity)) {
           break;
         }
         ++this->itr;
       }
     }
 
+  public:
+    Iterator(EntityDatabase& entities, inner_iterator itr, inner_iterator end)
+      : entities(entities), itr{itr}, end{end}, entity{}
+    {
+      Seek();
+    }
+
     value_type operator*() {
-      value_type entity;
-      while (itr != end) {
-        if (!EntityQuery<T>::Query(entities, itr->first, &entity)) {
-          ++itr;
-        } else {
-          return entity;
-        }
+      if (itr == end) {
+        throw new std::exception{};
       }
 
-      throw new std::exception{};
+      return entity;
     }
 
     Iterator<T>& operator++() {
       ++itr;
-
-      value_type entity;
-      while (itr != end) {
-        if (EntityQuery<T>::Query(entities, itr->first, &entity)) {
-          break;
-        }
-        ++itr;
-      }
-
+      Seek();
       return *this;
     }
 
@@ -193,20 +329,16 @@ struct EntityDatabase {
     void remove() {
       entities.orbits.erase(itr->first);
       entities.models.erase(itr->first);
+      entities.lights.erase(itr->first);
       entities.cameras.erase(itr->first);
       entities.silos.erase(itr->first);
       entities.missiles.erase(itr->first);
+      entities.masses.erase(itr->first);
+      entities.falls.erase(itr->first);
+      entities.schedules.erase(itr->first);
 
       itr = entities.positions.erase(itr);
-
-      // Make sure `itr` either points to a matching entity or to `end`
-      value_type entity;
-      while (itr != end) {
-        if (EntityQuery<T>::Query(entities, itr->first, &entity)) {
-          break;
-        }
-        ++itr;
-      }
+      Seek();
     }
   };
 
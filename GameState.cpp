@@ -0,0 +1,4 @@
+#include "GameState.h"
+
+std::string const CAMERAS[5] = {"View: Front", "View: Top", "View: Unum", "View: Duo", "View: Ship"};
+float const THRUSTS[3] = {250.0f, 1250.0f, 5000.0f};
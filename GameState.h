@@ -28,7 +28,14 @@ struct GameState {
   bool is_lit_ruber = true;
   bool is_lit_headlight = true;
 
+  // Cull and submit entities on the GPU (requires GL 4.3)
+  bool gpu_driven = false;
+
+  // Overlay frame times and counters
+  bool show_hud = true;
+
 };
 
-extern std::string const CAMERAS[];
-extern float const THRUSTS[];
+// The selectable cameras, by entity id, and ship thrust factors (see GameState.cpp).
+extern std::string const CAMERAS[5];
+extern float const THRUSTS[3];
@@ -0,0 +1,320 @@
+#include "Gravity.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <thread>
+
+// Below this many bodies, threads cost more than they save.
+static size_t const PARALLEL_MIN_BODIES = 1024;
+
+// The pull of a mass at offset `d`, without the gravitational constant.
+static glm::vec3 Pull(glm::vec3 d, float mass, float softening_squared) {
+  float const r2 = glm::dot(d, d) + softening_squared;
+  return d * (mass / (r2 * std::sqrt(r2)));
+}
+
+// Calls a ParallelFor's work on one range. Workers take their job through a plain
+// function pointer, since a std::function would put the lambda's captures on the heap.
+template<typename Work>
+static void RunWork(void const* work, size_t begin, size_t end) {
+  (*static_cast<Work const*>(work))(begin, end);
+}
+
+// Runs `work` over [0, count) in contiguous ranges, one per thread, and returns
+// once every range is done.
+template<typename Work>
+void GravitySolver::ParallelFor(size_t count, unsigned thread_count, Work const& work) {
+  if (thread_count == 0) {
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  if (count < PARALLEL_MIN_BODIES || thread_count == 1) {
+    work(0, count);
+    return;
+  }
+
+  StartWorkers(thread_count - 1);
+
+  size_t const per_thread = (count + thread_count - 1) / thread_count;
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    this->job = &RunWork<Work>;
+    this->job_work = &work;
+    this->job_count = count;
+    this->job_range = per_thread;
+    this->job_remaining = (unsigned)this->workers.size();
+    this->job_generation += 1;
+  }
+  this->job_ready.notify_all();
+
+  // The calling thread takes the first range itself.
+  work(0, std::min(per_thread, count));
+
+  std::unique_lock<std::mutex> lock{this->mutex};
+  this->job_done.wait(lock, [this]() { return this->job_remaining == 0; });
+}
+
+GravitySolver::~GravitySolver() {
+  StopWorkers();
+}
+
+// Makes sure exactly `worker_count` workers are waiting for jobs, restarting
+// them if a different number was asked for last time.
+void GravitySolver::StartWorkers(unsigned worker_count) {
+  if (this->workers.size() == worker_count) {
+    return;
+  }
+  StopWorkers();
+
+  // No job is in flight, so each worker can safely start waiting for the next generation.
+  this->stopping = false;
+  for (unsigned i = 0; i < worker_count; ++i) {
+    this->workers.emplace_back(&GravitySolver::RunWorker, this, i, this->job_generation);
+  }
+}
+
+void GravitySolver::StopWorkers() {
+  {
+    std::lock_guard<std::mutex> lock{this->mutex};
+    this->stopping = true;
+  }
+  this->job_ready.notify_all();
+
+  for (auto& worker : this->workers) {
+    worker.join();
+  }
+  this->workers.clear();
+}
+
+// Worker `index` takes range `index + 1` of each job posted after `generation`.
+void GravitySolver::RunWorker(unsigned index, uint64_t generation) {
+  std::unique_lock<std::mutex> lock{this->mutex};
+  while (true) {
+    this->job_ready.wait(lock, [this, generation]() { return this->stopping || this->job_generation != generation; });
+    if (this->stopping) {
+      return;
+    }
+    generation = this->job_generation;
+
+    size_t const begin = std::min((index + 1) * this->job_range, this->job_count);
+    size_t const end = std::min(begin + this->job_range, this->job_count);
+    auto const job = this->job;
+    void const* const work = this->job_work;
+
+    lock.unlock();
+    if (begin < end) {
+      job(work, begin, end);
+    }
+    lock.lock();
+
+    this->job_remaining -= 1;
+    if (this->job_remaining == 0) {
+      this->job_done.notify_one();
+    }
+  }
+}
+
+glm::vec3 getExactAcceleration(std::vector<GravityBody> const& bodies, size_t body, GravitySettings const& settings) {
+  return getExactAcceleration(bodies, body, bodies[body].position, settings);
+}
+
+glm::vec3 getExactAcceleration(std::vector<GravityBody> const& bodies, size_t body, glm::vec3 position, GravitySettings const& settings) {
+  float const softening_squared = settings.softening * settings.softening;
+
+  glm::vec3 acceleration{0.0f};
+  for (size_t other = 0; other < bodies.size(); ++other) {
+    if (other != body) {
+      acceleration += Pull(bodies[other].position - position, bodies[other].mass, softening_squared);
+    }
+  }
+  return settings.constant * acceleration;
+}
+
+void GravitySolver::Solve(std::vector<GravityBody> const& bodies, GravitySettings const& settings, std::vector<glm::vec3>* const accelerations) {
+  accelerations->resize(bodies.size());
+  if (bodies.empty()) {
+    return;
+  }
+
+  if (settings.exact) {
+    ParallelFor(bodies.size(), settings.threadCount, [&](size_t begin, size_t end) {
+      for (size_t body = begin; body < end; ++body) {
+        (*accelerations)[body] = getExactAcceleration(bodies, body, settings);
+      }
+    });
+    return;
+  }
+
+  // Building is cheap next to walking, so it stays on this thread.
+  Build(bodies);
+
+  // Neighboring bodies walk much the same cells, so walk for them one after
+  // another, in tree order, where those cells are still in cache.
+  SortBodies();
+  ParallelFor(bodies.size(), settings.threadCount, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      size_t const body = (size_t)this->order[i];
+      (*accelerations)[body] = GetTreeAcceleration(bodies, body, bodies[body].position, settings);
+    }
+  });
+}
+
+glm::vec3 GravitySolver::GetAcceleration(std::vector<GravityBody> const& bodies, size_t body, glm::vec3 position, GravitySettings const& settings) const {
+  if (settings.exact || this->nodes.empty()) {
+    return getExactAcceleration(bodies, body, position, settings);
+  }
+  return GetTreeAcceleration(bodies, body, position, settings);
+}
+
+size_t GravitySolver::GetNodeCount() const {
+  return this->nodes.size();
+}
+
+void GravitySolver::Build(std::vector<GravityBody> const& bodies) {
+  // The root is the smallest cube around every body, grown a touch so none lies on its far faces.
+  glm::vec3 lower = bodies[0].position;
+  glm::vec3 upper = bodies[0].position;
+  for (GravityBody const& body : bodies) {
+    lower = glm::min(lower, body.position);
+    upper = glm::max(upper, body.position);
+  }
+  glm::vec3 const extent = upper - lower;
+  float const half_size = 0.5f * std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-3f)) * 1.001f;
+
+  this->nodes.clear();
+  this->nodes.reserve(2 * bodies.size() + 1);
+  this->nodes.push_back(Node{0.5f * (lower + upper), half_size, glm::vec3{0.0f}, 0.0f, -1, -1});
+  this->nextBody.assign(bodies.size(), -1);
+
+  for (size_t body = 0; body < bodies.size(); ++body) {
+    Insert(bodies, (int32_t)body);
+  }
+
+  // Sum up masses from the leaves. Children come after their parents, so a
+  // backwards pass sees every child before its parent.
+  for (size_t i = this->nodes.size(); i-- > 0;) {
+    Node& node = this->nodes[i];
+    glm::vec3 moment{0.0f};
+    float mass = 0.0f;
+    if (node.firstChild < 0) {
+      for (int32_t body = node.firstBody; body >= 0; body = this->nextBody[body]) {
+        moment += bodies[body].mass * bodies[body].position;
+        mass += bodies[body].mass;
+      }
+    } else {
+      for (int32_t child = node.firstChild; child < node.firstChild + 8; ++child) {
+        moment += this->nodes[child].mass * this->nodes[child].massCenter;
+        mass += this->nodes[child].mass;
+      }
+    }
+
+    node.mass = mass;
+    node.massCenter = (mass > 0.0f) ? moment / mass : node.center;
+  }
+}
+
+// The octant of a cell which the given point lies in, as an index of its children.
+static int GetOctant(glm::vec3 center, glm::vec3 point) {
+  return (point.x >= center.x ? 1 : 0) | (point.y >= center.y ? 2 : 0) | (point.z >= center.z ? 4 : 0);
+}
+
+void GravitySolver::Insert(std::vector<GravityBody> const& bodies, int32_t body) {
+  glm::vec3 const position = bodies[body].position;
+
+  // Indices rather than references, since splitting a cell grows `nodes`.
+  int32_t index = 0;
+  for (int depth = 0; ; ++depth) {
+    if (this->nodes[index].firstChild >= 0) {
+      index = this->nodes[index].firstChild + GetOctant(this->nodes[index].center, position);
+      continue;
+    }
+
+    // An empty leaf, or one which can't be split any further, takes the body.
+    int32_t const resident = this->nodes[index].firstBody;
+    if (resident < 0 || depth >= MAX_DEPTH) {
+      this->nextBody[body] = resident;
+      this->nodes[index].firstBody = body;
+      return;
+    }
+
+    // Otherwise, split the leaf, and move its one resident down into the right child.
+    glm::vec3 const center = this->nodes[index].center;
+    float const child_half_size = 0.5f * this->nodes[index].halfSize;
+    int32_t const first_child = (int32_t)this->nodes.size();
+    for (int octant = 0; octant < 8; ++octant) {
+      glm::vec3 const offset{
+        (octant & 1) ? child_half_size : -child_half_size,
+        (octant & 2) ? child_half_size : -child_half_size,
+        (octant & 4) ? child_half_size : -child_half_size,
+      };
+      this->nodes.push_back(Node{center + offset, child_half_size, glm::vec3{0.0f}, 0.0f, -1, -1});
+    }
+
+    this->nodes[index].firstChild = first_child;
+    this->nodes[index].firstBody = -1;
+    this->nodes[first_child + GetOctant(center, bodies[resident].position)].firstBody = resident;
+  }
+}
+
+void GravitySolver::SortBodies() {
+  this->order.clear();
+
+  // Each level of the walk leaves at most seven siblings waiting.
+  int32_t stack[8 * (MAX_DEPTH + 1)];
+  int stack_size = 0;
+  stack[stack_size++] = 0;
+
+  while (stack_size > 0) {
+    Node const& node = this->nodes[stack[--stack_size]];
+
+    if (node.firstChild < 0) {
+      for (int32_t body = node.firstBody; body >= 0; body = this->nextBody[body]) {
+        this->order.push_back(body);
+      }
+    } else {
+      for (int32_t child = node.firstChild + 7; child >= node.firstChild; --child) {
+        stack[stack_size++] = child;
+      }
+    }
+  }
+}
+
+glm::vec3 GravitySolver::GetTreeAcceleration(std::vector<GravityBody> const& bodies, size_t body, glm::vec3 position, GravitySettings const& settings) const {
+  float const softening_squared = settings.softening * settings.softening;
+  float const angle_squared = settings.openingAngle * settings.openingAngle;
+
+  // Each level of the walk leaves at most seven siblings waiting.
+  int32_t stack[8 * (MAX_DEPTH + 1)];
+  int stack_size = 0;
+  stack[stack_size++] = 0;
+
+  glm::vec3 acceleration{0.0f};
+  while (stack_size > 0) {
+    Node const& node = this->nodes[stack[--stack_size]];
+    if (node.mass == 0.0f) {
+      continue;
+    }
+
+    if (node.firstChild < 0) {
+      for (int32_t other = node.firstBody; other >= 0; other = this->nextBody[other]) {
+        if ((size_t)other != body) {
+          acceleration += Pull(bodies[other].position - position, bodies[other].mass, softening_squared);
+        }
+      }
+      continue;
+    }
+
+    // Far enough away (for its size) to stand in for everything inside it?
+    glm::vec3 const d = node.massCenter - position;
+    float const width = 2.0f * node.halfSize;
+    if (width * width < angle_squared * glm::dot(d, d)) {
+      acceleration += Pull(d, node.mass, softening_squared);
+    } else {
+      for (int32_t child = node.firstChild; child < node.firstChild + 8; ++child) {
+        stack[stack_size++] = child;
+      }
+    }
+  }
+
+  return settings.constant * acceleration;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A point mass, as seen by the gravity solver.
+struct GravityBody {
+  glm::vec3 position;
+  float mass;
+};
+
+struct GravitySettings {
+  float constant = 1.0f;  // The gravitational constant, in game units
+
+  // Added (squared) to every squared distance, so that close passes don't fling
+  // bodies to infinity.
+  float softening = 1.0f;
+
+  // Barnes-Hut opening angle: a cell is treated as one mass once its width is
+  // less than this fraction of its distance. Smaller is more accurate and slower;
+  // zero opens every cell.
+  float openingAngle = 0.5f;
+
+  // Sum every pair directly, in O(n^2), instead of using the tree. For validation.
+  bool exact = false;
+
+  // Threads to spread the bodies over; zero for one per CPU core. Small systems
+  // always run on the calling thread.
+  unsigned threadCount = 0;
+};
+
+// Computes the gravitational acceleration of every body due to all of the others.
+//
+// By default this builds a Barnes-Hut octree over the bodies, then walks it once
+// per body, treating distant cells as single masses at their centers of mass.
+// That's O(n log n) in all, against O(n^2) for summing every pair. The tree is
+// rebuilt on every call, since every body may have moved.
+//
+// Large systems are shared out over worker threads, which the solver starts on
+// first use and keeps, waiting between calls, until it is destroyed.
+class GravitySolver {
+private:
+  // The deepest a cell may be split. Bodies which still share a cell (because
+  // they coincide, say) are listed in it together.
+  static int const MAX_DEPTH = 32;
+
+  struct Node {
+    glm::vec3 center;  // Of the cell
+    float halfSize;  // Half the cell's width
+    glm::vec3 massCenter;
+    float mass;
+    int32_t firstChild;  // Index of the first of eight consecutive children; -1 for a leaf
+    int32_t firstBody;  // A leaf's bodies, linked through `nextBody`; -1 if empty
+  };
+
+  std::vector<Node> nodes;  // Parents always precede their children
+  std::vector<int32_t> nextBody;  // The next body in the same leaf, by body index; -1 at the end
+  std::vector<int32_t> order;  // Every body, leaf by leaf in depth-first order
+
+  // Worker threads, which each take one range of a job while the calling thread takes the first.
+  std::vector<std::thread> workers;
+
+  std::mutex mutex;
+  std::condition_variable job_ready;  // Signalled when a job is posted, or on shutdown
+  std::condition_variable job_done;  // Signalled when the last worker finishes its range
+  void (*job)(void const* work, size_t begin, size_t end) = nullptr;  // Runs `job_work` over a range
+  void const* job_work = nullptr;
+  size_t job_count = 0;  // The job covers [0, job_count)
+  size_t job_range = 0;  // In ranges of this many
+  uint64_t job_generation = 0;  // Bumped with every job posted
+  unsigned job_remaining = 0;  // Workers yet to finish the current job
+  bool stopping = false;
+
+public:
+  GravitySolver() = default;
+  ~GravitySolver();
+
+  GravitySolver(GravitySolver const&) = delete;
+  GravitySolver& operator=(GravitySolver const&) = delete;
+
+  // Writes the acceleration of each of `bodies` into `accelerations`.
+  void Solve(std::vector<GravityBody> const& bodies, GravitySettings const& settings, std::vector<glm::vec3>* const accelerations);
+
+  // The acceleration which `body` would feel at `position`, due to all of the other
+  // bodies as they stood at the last Solve (from its tree, unless `settings` asks
+  // for the exact sum). For stepping a body along without re-solving everything.
+  glm::vec3 GetAcceleration(std::vector<GravityBody> const& bodies, size_t body, glm::vec3 position, GravitySettings const& settings) const;
+
+  // The number of cells in the last tree built.
+  size_t GetNodeCount() const;
+
+private:
+  void Build(std::vector<GravityBody> const& bodies);
+  void Insert(std::vector<GravityBody> const& bodies, int32_t body);
+  void SortBodies();
+  glm::vec3 GetTreeAcceleration(std::vector<GravityBody> const& bodies, size_t body, glm::vec3 position, GravitySettings const& settings) const;
+
+  template<typename Work>
+  void ParallelFor(size_t count, unsigned thread_count, Work const& work);
+  void StartWorkers(unsigned worker_count);
+  void StopWorkers();
+  void RunWorker(unsigned index, uint64_t generation);
+};
+
+// The acceleration of one body due to all of the others, summed directly.
+glm::vec3 getExactAcceleration(std::vector<GravityBody> const& bodies, size_t body, GravitySettings const& settings);
+
+// The same, as though the body stood at `position` instead.
+glm::vec3 getExactAcceleration(std::vector<GravityBody> const& bodies, size_t body, glm::vec3 position, GravitySettings const& settings);
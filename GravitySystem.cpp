@@ -0,0 +1,114 @@
+#include "GravitySystem.h"
+#include "util/alloc.h"
+#include "util/profile.h"
+
+#include <cmath>
+
+// How finely falling bodies are stepped: a substep is at most
+// sqrt(2 * STEP_ACCURACY * softening / |acceleration|) long, the usual criterion
+// for softened N-body codes. Smaller is more accurate and slower.
+static double const STEP_ACCURACY = 0.025;
+
+// A body takes at most 2^MAX_SUBSTEP_LEVEL substeps per step.
+static int const MAX_SUBSTEP_LEVEL = 10;
+
+// Query result object for interfacing with the EntityDatabase
+struct MassiveEntity {
+  std::string const* id;  // The entity's key in `positions`
+  PositionComponent* position;
+  MassComponent* mass;
+};
+template<>
+struct EntityQuery<MassiveEntity> {
+  typedef MassiveEntity Entity;
+
+  static bool Query(EntityDatabase& entities, std::string const& id, MassiveEntity* const entity) {
+    auto posItr = entities.positions.find(id);
+    auto massItr = entities.masses.find(id);
+
+    if (posItr == entities.positions.end() || massItr == entities.masses.end()) {
+      return false;
+    }
+
+    entity->id = &posItr->first;
+    entity->position = &posItr->second;
+    entity->mass = &massItr->second;
+    return true;
+  }
+};
+
+// Whether gravity moves the given entity: it must be placed in the world directly,
+// and be neither anchored, orbiting, nor destroyed.
+static bool IsFree(EntityDatabase& entities, std::string const& id) {
+  auto siloItr = entities.silos.find(id);
+  return entities.positions.at(id).parent == "::world"
+      && !entities.masses.at(id).anchored
+      && entities.orbits.find(id) == entities.orbits.end()
+      && (siloItr == entities.silos.end() || !siloItr->second.destroyed);
+}
+
+// The number of equal substeps, a power of two, which a body with the given
+// acceleration should take over a step of `delta`.
+static int GetSubstepCount(double delta, float acceleration, float softening) {
+  if (acceleration <= 0.0f) {
+    return 1;
+  }
+
+  double const longest = std::sqrt(2.0 * STEP_ACCURACY * softening / acceleration);
+  int count = 1;
+  while (delta / count > longest && count < (1 << MAX_SUBSTEP_LEVEL)) {
+    count *= 2;
+  }
+  return count;
+}
+
+void GravitySystem::Update(GameState& state, double delta) {
+  PROFILE_ZONE("GravitySystem::Update");
+  ALLOC_SCOPE("GravitySystem::Update");
+
+  if (!state.gravity_enabled) {
+    // Switching gravity off stops any fall in its tracks.
+    state.entities.falls.clear();
+    return;
+  }
+
+  this->ids.clear();
+  this->bodies.clear();
+  for (auto entity : state.entities.Query<MassiveEntity>()) {
+    this->ids.push_back(entity.id);
+    this->bodies.push_back(GravityBody{state.entities.GetWorldPosition(*entity.id), entity.mass->mass});
+  }
+
+  this->solver.Solve(this->bodies, this->settings, &this->accelerations);
+
+  // Step each free body with velocity Verlet (kick, drift, kick), which keeps
+  // orbits from gaining or losing energy over time as Euler steps would. Each body
+  // takes as many substeps as its own acceleration calls for, through the field of
+  // the others as they stood at the start of the step.
+  for (size_t i = 0; i < this->ids.size(); ++i) {
+    std::string const& id = *this->ids[i];
+    if (!IsFree(state.entities, id)) {
+      state.entities.falls.erase(id);
+      continue;
+    }
+
+    FallComponent& fall = state.entities.falls[id];
+    glm::vec3 const start = this->bodies[i].position;
+    glm::vec3 position = start;
+    glm::vec3 velocity = fall.velocity;
+    glm::vec3 acceleration = this->accelerations[i];
+
+    int const substeps = GetSubstepCount(delta, glm::length(acceleration), this->settings.softening);
+    float const h = (float)(delta / substeps);
+    for (int substep = 0; substep < substeps; ++substep) {
+      velocity += acceleration * (0.5f * h);
+      position += velocity * h;
+      acceleration = this->solver.GetAcceleration(this->bodies, i, position, this->settings);
+      velocity += acceleration * (0.5f * h);
+    }
+
+    state.entities.positions.at(id).translation += position - start;
+    fall.velocity = velocity;
+    fall.acceleration = acceleration;
+  }
+}
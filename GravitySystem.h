@@ -0,0 +1,36 @@
+#pragma once
+
+#include "GameState.h"
+#include "Gravity.h"
+
+#include <string>
+#include <vector>
+
+// Pulls free bodies (the ship and missiles, say) towards every entity with mass,
+// while gravity is enabled.
+//
+// Every entity with a MassComponent attracts. Those which are free (neither orbiting
+// nor riding on another entity) also fall, gathering velocity in a FallComponent;
+// the rest follow their orbits or parents regardless. Accelerations come from a
+// GravitySolver, so the cost grows as O(n log n) in the number of bodies.
+//
+// Falling bodies are integrated with velocity Verlet, each in its own number of
+// substeps: one while it drifts through a weak field, more in a close pass. So a
+// step can be long without a close pass anywhere costing every body fine steps.
+class GravitySystem {
+private:
+  GravitySettings settings;
+  GravitySolver solver;
+
+  // Per-step scratch space
+  std::vector<std::string const*> ids;  // Keys in the entity database's `positions`
+  std::vector<GravityBody> bodies;
+  std::vector<glm::vec3> accelerations;
+
+public:
+  explicit GravitySystem(GravitySettings const& settings)
+    : settings{settings}
+  {}
+
+  void Update(GameState& state, double delta);
+};
@@ -0,0 +1,334 @@
+#include "Hud.h"
+#include "shaders.h"
+#include "util/debug.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <glm/gtc/type_ptr.hpp>
+
+// Printable ASCII, from ' ' to '~', in a 5x7 pixel font. Each glyph is five
+// columns, left to right, whose bits are its pixels from the top down.
+static int const FONT_FIRST = 32;
+static int const FONT_COUNT = 95;
+static GLubyte const FONT[FONT_COUNT][5] = {
+  {0x00, 0x00, 0x00, 0x00, 0x00},  // space
+  {0x00, 0x00, 0x5F, 0x00, 0x00},  // !
+  {0x00, 0x07, 0x00, 0x07, 0x00},  // "
+  {0x14, 0x7F, 0x14, 0x7F, 0x14},  // #
+  {0x24, 0x2A, 0x7F, 0x2A, 0x12},  // $
+  {0x23, 0x13, 0x08, 0x64, 0x62},  // %
+  {0x36, 0x49, 0x55, 0x22, 0x50},  // &
+  {0x00, 0x05, 0x03, 0x00, 0x00},  // quote
+  {0x00, 0x1C, 0x22, 0x41, 0x00},  // (
+  {0x00, 0x41, 0x22, 0x1C, 0x00},  // )
+  {0x14, 0x08, 0x3E, 0x08, 0x14},  // *
+  {0x08, 0x08, 0x3E, 0x08, 0x08},  // +
+  {0x00, 0x50, 0x30, 0x00, 0x00},  // ,
+  {0x08, 0x08, 0x08, 0x08, 0x08},  // -
+  {0x00, 0x60, 0x60, 0x00, 0x00},  // .
+  {0x20, 0x10, 0x08, 0x04, 0x02},  // /
+  {0x3E, 0x51, 0x49, 0x45, 0x3E},  // 0
+  {0x00, 0x42, 0x7F, 0x40, 0x00},  // 1
+  {0x42, 0x61, 0x51, 0x49, 0x46},  // 2
+  {0x21, 0x41, 0x45, 0x4B, 0x31},  // 3
+  {0x18, 0x14, 0x12, 0x7F, 0x10},  // 4
+  {0x27, 0x45, 0x45, 0x45, 0x39},  // 5
+  {0x3C, 0x4A, 0x49, 0x49, 0x30},  // 6
+  {0x01, 0x71, 0x09, 0x05, 0x03},  // 7
+  {0x36, 0x49, 0x49, 0x49, 0x36},  // 8
+  {0x06, 0x49, 0x49, 0x29, 0x1E},  // 9
+  {0x00, 0x36, 0x36, 0x00, 0x00},  // :
+  {0x00, 0x56, 0x36, 0x00, 0x00},  // ;
+  {0x08, 0x14, 0x22, 0x41, 0x00},  // <
+  {0x14, 0x14, 0x14, 0x14, 0x14},  // =
+  {0x00, 0x41, 0x22, 0x14, 0x08},  // >
+  {0x02, 0x01, 0x51, 0x09, 0x06},  // ?
+  {0x32, 0x49, 0x79, 0x41, 0x3E},  // @
+  {0x7E, 0x11, 0x11, 0x11, 0x7E},  // A
+  {0x7F, 0x49, 0x49, 0x49, 0x36},  // B
+  {0x3E, 0x41, 0x41, 0x41, 0x22},  // C
+  {0x7F, 0x41, 0x41, 0x22, 0x1C},  // D
+  {0x7F, 0x49, 0x49, 0x49, 0x41},  // E
+  {0x7F, 0x09, 0x09, 0x09, 0x01},  // F
+  {0x3E, 0x41, 0x49, 0x49, 0x7A},  // G
+  {0x7F, 0x08, 0x08, 0x08, 0x7F},  // H
+  {0x00, 0x41, 0x7F, 0x41, 0x00},  // I
+  {0x20, 0x40, 0x41, 0x3F, 0x01},  // J
+  {0x7F, 0x08, 0x14, 0x22, 0x41},  // K
+  {0x7F, 0x40, 0x40, 0x40, 0x40},  // L
+  {0x7F, 0x02, 0x0C, 0x02, 0x7F},  // M
+  {0x7F, 0x04, 0x08, 0x10, 0x7F},  // N
+  {0x3E, 0x41, 0x41, 0x41, 0x3E},  // O
+  {0x7F, 0x09, 0x09, 0x09, 0x06},  // P
+  {0x3E, 0x41, 0x51, 0x21, 0x5E},  // Q
+  {0x7F, 0x09, 0x19, 0x29, 0x46},  // R
+  {0x46, 0x49, 0x49, 0x49, 0x31},  // S
+  {0x01, 0x01, 0x7F, 0x01, 0x01},  // T
+  {0x3F, 0x40, 0x40, 0x40, 0x3F},  // U
+  {0x1F, 0x20, 0x40, 0x20, 0x1F},  // V
+  {0x3F, 0x40, 0x38, 0x40, 0x3F},  // W
+  {0x63, 0x14, 0x08, 0x14, 0x63},  // X
+  {0x07, 0x08, 0x70, 0x08, 0x07},  // Y
+  {0x61, 0x51, 0x49, 0x45, 0x43},  // Z
+  {0x00, 0x7F, 0x41, 0x41, 0x00},  // [
+  {0x02, 0x04, 0x08, 0x10, 0x20},  // backslash
+  {0x00, 0x41, 0x41, 0x7F, 0x00},  // ]
+  {0x04, 0x02, 0x01, 0x02, 0x04},  // ^
+  {0x40, 0x40, 0x40, 0x40, 0x40},  // _
+  {0x00, 0x01, 0x02, 0x04, 0x00},  // `
+  {0x20, 0x54, 0x54, 0x54, 0x78},  // a
+  {0x7F, 0x48, 0x44, 0x44, 0x38},  // b
+  {0x38, 0x44, 0x44, 0x44, 0x20},  // c
+  {0x38, 0x44, 0x44, 0x48, 0x7F},  // d
+  {0x38, 0x54, 0x54, 0x54, 0x18},  // e
+  {0x08, 0x7E, 0x09, 0x01, 0x02},  // f
+  {0x0C, 0x52, 0x52, 0x52, 0x3E},  // g
+  {0x7F, 0x08, 0x04, 0x04, 0x78},  // h
+  {0x00, 0x44, 0x7D, 0x40, 0x00},  // i
+  {0x20, 0x40, 0x44, 0x3D, 0x00},  // j
+  {0x7F, 0x10, 0x28, 0x44, 0x00},  // k
+  {0x00, 0x41, 0x7F, 0x40, 0x00},  // l
+  {0x7C, 0x04, 0x18, 0x04, 0x78},  // m
+  {0x7C, 0x08, 0x04, 0x04, 0x78},  // n
+  {0x38, 0x44, 0x44, 0x44, 0x38},  // o
+  {0x7C, 0x14, 0x14, 0x14, 0x08},  // p
+  {0x08, 0x14, 0x14, 0x18, 0x7C},  // q
+  {0x7C, 0x08, 0x04, 0x04, 0x08},  // r
+  {0x48, 0x54, 0x54, 0x54, 0x20},  // s
+  {0x04, 0x3F, 0x44, 0x40, 0x20},  // t
+  {0x3C, 0x40, 0x40, 0x20, 0x7C},  // u
+  {0x1C, 0x20, 0x40, 0x20, 0x1C},  // v
+  {0x3C, 0x40, 0x30, 0x40, 0x3C},  // w
+  {0x44, 0x28, 0x10, 0x28, 0x44},  // x
+  {0x0C, 0x50, 0x50, 0x50, 0x3C},  // y
+  {0x44, 0x64, 0x54, 0x4C, 0x44},  // z
+  {0x00, 0x08, 0x36, 0x41, 0x00},  // {
+  {0x00, 0x00, 0x7F, 0x00, 0x00},  // |
+  {0x00, 0x41, 0x36, 0x08, 0x00},  // }
+  {0x08, 0x04, 0x08, 0x10, 0x08},  // ~
+};
+
+// The atlas is a grid of CELL_WIDTH by CELL_HEIGHT cells, one per glyph, with a
+// blank column and row after each glyph for spacing. The cell after the last
+// glyph is solid, for drawing boxes.
+static int const CELL_WIDTH = 6;
+static int const CELL_HEIGHT = 8;
+static int const ATLAS_COLUMNS = 16;
+static int const ATLAS_ROWS = 6;
+static GLuint const SOLID_CELL = FONT_COUNT;
+
+// Text is drawn at this many pixels per font pixel.
+static float const TEXT_SCALE = 2.0f;
+static float const MARGIN = 8.0f;  // Around the panel's contents, in pixels
+static float const LINE_SPACING = 2.0f;  // Between lines of text, in pixels
+
+// The frame time graph's bars, and the frame time of a full-height bar.
+static float const BAR_WIDTH = 2.0f;
+static float const GRAPH_HEIGHT = 64.0f;
+static float const GRAPH_SECONDS = 1.0f / 20.0f;
+
+// Vertex attributes of shaders/hud-vertex.glsl
+static GLuint const RECT_ATTRIBUTE = 0;
+static GLuint const COLOR_ATTRIBUTE = 1;
+static GLuint const GLYPH_ATTRIBUTE = 2;
+
+static HudQuad MakeQuad(glm::vec2 position, glm::vec2 size, GLuint glyph, GLubyte r, GLubyte g, GLubyte b, GLubyte a) {
+  HudQuad quad;
+  quad.position = position;
+  quad.size = size;
+  quad.color[0] = r;
+  quad.color[1] = g;
+  quad.color[2] = b;
+  quad.color[3] = a;
+  quad.glyph = glyph;
+  return quad;
+}
+
+// The atlas cell of a character; unprintable ones are drawn as '?'.
+static GLuint GetGlyph(char c) {
+  int const code = (unsigned char)c;
+  if (code < FONT_FIRST || code >= FONT_FIRST + FONT_COUNT) {
+    return '?' - FONT_FIRST;
+  }
+  return (GLuint)(code - FONT_FIRST);
+}
+
+Hud::Hud() {
+  // The panel, a glyph per character, the graph's bars and its two lines.
+  this->text.reserve(MAX_TEXT);
+  this->quads.reserve(1 + MAX_TEXT + GRAPH_FRAMES + 2);
+
+  this->program = create_program_from_files("shaders/hud-vertex.glsl", "shaders/hud-fragment.glsl");
+  if (this->program == GL_NONE) {
+    // TODO: Throw an exception instead so the environment is cleaned up properly.
+    exit(1);
+  }
+
+  // Rasterize the font into the atlas.
+  int const atlas_width = ATLAS_COLUMNS * CELL_WIDTH;
+  int const atlas_height = ATLAS_ROWS * CELL_HEIGHT;
+  std::vector<GLubyte> pixels(atlas_width * atlas_height, 0);
+  for (int glyph = 0; glyph <= FONT_COUNT; ++glyph) {
+    int const left = (glyph % ATLAS_COLUMNS) * CELL_WIDTH;
+    int const top = (glyph / ATLAS_COLUMNS) * CELL_HEIGHT;
+    for (int y = 0; y < CELL_HEIGHT; ++y) {
+      for (int x = 0; x < CELL_WIDTH; ++x) {
+        bool const set = (glyph == (int)SOLID_CELL)
+            || (x < 5 && y < 7 && ((FONT[glyph][x] >> y) & 1));
+        pixels[(top + y) * atlas_width + left + x] = set ? 255 : 0;
+      }
+    }
+  }
+
+  GL_DEBUG_SITE("HUD");
+  glGenTextures(1, &this->atlas);
+  glBindTexture(GL_TEXTURE_2D, this->atlas);
+  labelGlObject(GL_TEXTURE, this->atlas, "HUD glyph atlas");
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlas_width, atlas_height, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  glBindTexture(GL_TEXTURE_2D, GL_NONE);
+
+  glGenVertexArrays(1, &this->vao);
+  glGenBuffers(1, &this->quad_buffer);
+  glBindVertexArray(this->vao);
+  glBindBuffer(GL_ARRAY_BUFFER, this->quad_buffer);
+  labelGlObject(GL_VERTEX_ARRAY, this->vao, "HUD");
+  labelGlObject(GL_BUFFER, this->quad_buffer, "HUD quads");
+
+  // Each instance is one quad; its corners come from gl_VertexID.
+  glVertexAttribPointer(RECT_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(HudQuad), (GLvoid*)offsetof(HudQuad, position));
+  glVertexAttribDivisor(RECT_ATTRIBUTE, 1);
+  glEnableVertexAttribArray(RECT_ATTRIBUTE);
+  glVertexAttribPointer(COLOR_ATTRIBUTE, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HudQuad), (GLvoid*)offsetof(HudQuad, color));
+  glVertexAttribDivisor(COLOR_ATTRIBUTE, 1);
+  glEnableVertexAttribArray(COLOR_ATTRIBUTE);
+  glVertexAttribIPointer(GLYPH_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(HudQuad), (GLvoid*)offsetof(HudQuad, glyph));
+  glVertexAttribDivisor(GLYPH_ATTRIBUTE, 1);
+  glEnableVertexAttribArray(GLYPH_ATTRIBUTE);
+
+  glBindVertexArray(GL_NONE);
+  glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
+}
+
+Hud::~Hud() {
+  glDeleteProgram(this->program);
+  glDeleteVertexArrays(1, &this->vao);
+  glDeleteBuffers(1, &this->quad_buffer);
+  glDeleteTextures(1, &this->atlas);
+}
+
+void Hud::SetText(char const* text) {
+  if (text != this->text) {
+    this->text = text;
+    this->textChanged = true;
+  }
+}
+
+void Hud::AddFrameTime(double seconds) {
+  this->frameTimes[this->nextFrame] = (float)seconds;
+  this->nextFrame = (this->nextFrame + 1) % GRAPH_FRAMES;
+}
+
+void Hud::LayOutText() {
+  float const advance = CELL_WIDTH * TEXT_SCALE;
+  float const line_height = CELL_HEIGHT * TEXT_SCALE + LINE_SPACING;
+  glm::vec2 const glyph_size{advance, CELL_HEIGHT * TEXT_SCALE};
+
+  // The panel goes first, so that everything else is drawn over it.
+  this->quads.clear();
+  this->quads.push_back(HudQuad{});
+
+  glm::vec2 pen{MARGIN, MARGIN};
+  float width = 0.0f;
+  for (char c : this->text) {
+    if (c == '\n') {
+      pen = glm::vec2{MARGIN, pen.y + line_height};
+    } else {
+      if (c != ' ') {
+        this->quads.push_back(MakeQuad(pen, glyph_size, GetGlyph(c), 255, 255, 255, 255));
+      }
+      pen.x += advance;
+      width = std::max(width, pen.x - MARGIN);
+    }
+  }
+
+  this->textSize = glm::vec2{width, this->text.empty() ? 0.0f : pen.y + line_height - MARGIN};
+  float const panel_width = std::max(this->textSize.x, GRAPH_FRAMES * BAR_WIDTH) + 2.0f * MARGIN;
+  float const panel_height = this->textSize.y + GRAPH_HEIGHT + 2.0f * MARGIN;
+  this->quads[0] = MakeQuad(glm::vec2{0.0f}, glm::vec2{panel_width, panel_height}, SOLID_CELL, 0, 0, 0, 160);
+  this->textQuadCount = this->quads.size();
+}
+
+void Hud::Draw(glm::vec2 viewportSize) {
+  GL_DEBUG_SITE("HUD");
+  glBindBuffer(GL_ARRAY_BUFFER, this->quad_buffer);
+
+  bool const relayout = this->textChanged || this->bufferQuads == 0;
+  if (relayout) {
+    LayOutText();
+    this->textChanged = false;
+  }
+  this->quads.resize(this->textQuadCount);
+
+  // The graph: a bar per frame, oldest at the left, colored by whether the frame
+  // made 60 Hz, 30 Hz or neither, under lines marking those frame times.
+  float const bottom = MARGIN + this->textSize.y + GRAPH_HEIGHT;
+  for (int i = 0; i < GRAPH_FRAMES; ++i) {
+    float const seconds = this->frameTimes[(this->nextFrame + i) % GRAPH_FRAMES];
+    float const height = std::min(seconds / GRAPH_SECONDS, 1.0f) * GRAPH_HEIGHT;
+    glm::vec2 const position{MARGIN + i * BAR_WIDTH, bottom - height};
+    if (seconds <= 1.0f / 60.0f) {
+      this->quads.push_back(MakeQuad(position, glm::vec2{BAR_WIDTH, height}, SOLID_CELL, 80, 220, 80, 255));
+    } else if (seconds <= 1.0f / 30.0f) {
+      this->quads.push_back(MakeQuad(position, glm::vec2{BAR_WIDTH, height}, SOLID_CELL, 230, 200, 60, 255));
+    } else {
+      this->quads.push_back(MakeQuad(position, glm::vec2{BAR_WIDTH, height}, SOLID_CELL, 230, 70, 60, 255));
+    }
+  }
+  for (float hertz : {60.0f, 30.0f}) {
+    float const y = bottom - (1.0f / hertz) / GRAPH_SECONDS * GRAPH_HEIGHT;
+    this->quads.push_back(MakeQuad(glm::vec2{MARGIN, y}, glm::vec2{GRAPH_FRAMES * BAR_WIDTH, 1.0f}, SOLID_CELL, 255, 255, 255, 96));
+  }
+
+  // Upload the text only when it has changed, and the graph every frame.
+  if (this->quads.size() > this->bufferQuads) {
+    this->bufferQuads = this->quads.size() + 64;
+    glBufferData(GL_ARRAY_BUFFER, sizeof(HudQuad) * this->bufferQuads, nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(HudQuad) * this->quads.size(), this->quads.data());
+  } else if (relayout) {
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(HudQuad) * this->quads.size(), this->quads.data());
+  } else {
+    size_t const graph_quads = this->quads.size() - this->textQuadCount;
+    glBufferSubData(GL_ARRAY_BUFFER, sizeof(HudQuad) * this->textQuadCount, sizeof(HudQuad) * graph_quads, this->quads.data() + this->textQuadCount);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
+
+  glUseProgram(this->program);
+  glm::vec2 const pixelSize{2.0f / viewportSize.x, 2.0f / viewportSize.y};
+  glUniform2fv(glGetUniformLocation(this->program, "u_pixelSize"), 1, glm::value_ptr(pixelSize));
+  glm::vec2 const cellSize{1.0f / ATLAS_COLUMNS, 1.0f / ATLAS_ROWS};
+  glUniform2fv(glGetUniformLocation(this->program, "u_cellSize"), 1, glm::value_ptr(cellSize));
+  glUniform1i(glGetUniformLocation(this->program, "u_atlas"), 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, this->atlas);
+
+  glDisable(GL_DEPTH_TEST);
+  glDepthMask(GL_FALSE);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  glBindVertexArray(this->vao);
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)this->quads.size());
+  glBindVertexArray(GL_NONE);
+
+  glDisable(GL_BLEND);
+  glDepthMask(GL_TRUE);
+  glEnable(GL_DEPTH_TEST);
+  glBindTexture(GL_TEXTURE_2D, GL_NONE);
+}
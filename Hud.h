@@ -0,0 +1,66 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/vec2.hpp>
+#include <string>
+#include <vector>
+
+// A mirror of the per-instance attributes of shaders/hud-vertex.glsl.
+struct HudQuad {
+  glm::vec2 position;  // Top-left corner, in pixels from the top left of the viewport
+  glm::vec2 size;  // In pixels
+  GLubyte color[4];
+  GLuint glyph;  // Cell of the glyph atlas
+};
+
+// An on-screen performance overlay: a few lines of text over a graph of recent
+// frame times.
+//
+// Text comes from a built-in 5x7 pixel font, rasterized once into a small glyph
+// atlas. Every character, graph bar and the panel behind them is an instanced quad
+// sampling that atlas, so the whole overlay is one draw call. The text's quads are
+// only laid out and uploaded again when the text changes; the graph's are updated
+// every frame.
+class Hud {
+private:
+  static int const GRAPH_FRAMES = 120;  // Frames shown in the graph, one bar each
+
+  GLuint program = GL_NONE;
+  GLuint vao = GL_NONE;
+  GLuint quad_buffer = GL_NONE;  // HudQuad per quad: the text's, then the graph's
+  GLuint atlas = GL_NONE;
+  size_t bufferQuads = 0;  // Capacity of quad_buffer
+
+  std::string text;  // As last laid out
+  bool textChanged = false;
+  std::vector<HudQuad> quads;  // Scratch list of this frame's quads
+  size_t textQuadCount = 0;  // Quads at the start of quad_buffer which lay out `text`
+  glm::vec2 textSize{0.0f};  // In pixels
+
+  float frameTimes[GRAPH_FRAMES] = {};  // In seconds, oldest first from nextFrame
+  int nextFrame = 0;
+
+public:
+  // Room kept for the text, including its terminator, so that SetText never
+  // allocates for text which fits.
+  static int const MAX_TEXT = 512;
+
+  Hud();
+  ~Hud();
+
+  Hud(Hud const&) = delete;
+  Hud& operator=(Hud const&) = delete;
+
+  // Sets the text to show, one line per '\n'. Costs nothing if it hasn't changed,
+  // and allocates nothing unless it's longer than MAX_TEXT.
+  void SetText(char const* text);
+
+  // Adds a frame to the graph.
+  void AddFrameTime(double seconds);
+
+  // Draws the overlay over everything else.
+  void Draw(glm::vec2 viewportSize);
+
+private:
+  void LayOutText();
+};
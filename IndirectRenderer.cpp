@@ -0,0 +1,223 @@
+#include "IndirectRenderer.h"
+#include "shaders.h"
+#include "util/debug.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_access.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <cstdlib>
+
+// Shader storage bindings, matching shaders/cull.glsl and shaders/indirect-vertex.glsl
+static GLuint const INSTANCE_BINDING = 0;
+static GLuint const COMMAND_BINDING = 1;
+static GLuint const VISIBLE_BINDING = 2;
+
+// Vertex attribute fed from the visible-instance list
+static GLuint const INSTANCE_ATTRIBUTE = 3;
+
+// Matches local_size_x in shaders/cull.glsl
+static GLuint const CULL_GROUP_SIZE = 64;
+
+// Each DrawElementsIndirectCommand is five uints: count, instanceCount, firstIndex, baseVertex, baseInstance.
+static int const COMMAND_WORDS = 5;
+
+bool IndirectRenderer::IsSupported() {
+  return GLEW_VERSION_4_3 != 0;
+}
+
+IndirectRenderer::IndirectRenderer() {
+  this->cull_program = create_compute_program_from_file("shaders/cull.glsl");
+  if (this->cull_program == GL_NONE) {
+    // TODO: Throw an exception instead so the environment is cleaned up properly.
+    exit(1);
+  }
+
+  glGenVertexArrays(1, &this->vao);
+  glGenBuffers(1, &this->vertex_buffer);
+  glGenBuffers(1, &this->index_buffer);
+  glGenBuffers(1, &this->instance_buffer);
+  glGenBuffers(1, &this->command_buffer);
+  glGenBuffers(1, &this->visible_buffer);
+
+  // The visible list supplies each instance's index into the instance buffer.
+  glBindVertexArray(this->vao);
+  glBindBuffer(GL_ARRAY_BUFFER, this->visible_buffer);
+  glVertexAttribIPointer(INSTANCE_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), (GLvoid*)0);
+  glVertexAttribDivisor(INSTANCE_ATTRIBUTE, 1);
+  glEnableVertexAttribArray(INSTANCE_ATTRIBUTE);
+  glBindVertexArray(GL_NONE);
+
+  labelGlObject(GL_VERTEX_ARRAY, this->vao, "indirect meshes");
+  labelGlObject(GL_BUFFER, this->instance_buffer, "indirect instances");
+  labelGlObject(GL_BUFFER, this->command_buffer, "indirect commands");
+  labelGlObject(GL_BUFFER, this->visible_buffer, "indirect visible instances");
+}
+
+IndirectRenderer::~IndirectRenderer() {
+  glDeleteProgram(this->cull_program);
+  glDeleteVertexArrays(1, &this->vao);
+  glDeleteBuffers(1, &this->vertex_buffer);
+  glDeleteBuffers(1, &this->index_buffer);
+  glDeleteBuffers(1, &this->instance_buffer);
+  glDeleteBuffers(1, &this->command_buffer);
+  glDeleteBuffers(1, &this->visible_buffer);
+}
+
+// Grows `shared` to hold the contents of `source` after its current `shared_bytes`,
+// by allocating a larger buffer and copying both into it. Returns the size of `source`.
+static GLsizeiptr AppendBuffer(GLuint* const shared, GLsizeiptr shared_bytes, GLuint source, char const* label) {
+  GLint source_bytes = 0;
+  glBindBuffer(GL_COPY_READ_BUFFER, source);
+  glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &source_bytes);
+
+  GLuint grown = GL_NONE;
+  glGenBuffers(1, &grown);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+  glBufferData(GL_COPY_WRITE_BUFFER, shared_bytes + source_bytes, nullptr, GL_STATIC_DRAW);
+  if (shared_bytes > 0) {
+    glBindBuffer(GL_COPY_READ_BUFFER, *shared);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, shared_bytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, source);
+  }
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, shared_bytes, source_bytes);
+  glBindBuffer(GL_COPY_READ_BUFFER, GL_NONE);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, GL_NONE);
+
+  glDeleteBuffers(1, shared);
+  *shared = grown;
+  labelGlObject(GL_BUFFER, *shared, label);
+
+  return source_bytes;
+}
+
+GLuint IndirectRenderer::GetMeshSlot(Mesh const& mesh, int lod) {
+  auto itr = this->mesh_slots.find(&mesh);
+  if (itr != this->mesh_slots.end()) {
+    return itr->second + (GLuint)lod;
+  }
+
+  GL_DEBUG_SITE("indirect mesh upload");
+
+  // Copy the mesh's vertices and indices into the shared buffers.
+  GLuint const base_vertex = (GLuint)(this->vertex_bytes / MESH_VERTEX_STRIDE);
+  GLuint const base_index = (GLuint)(this->index_bytes / sizeof(GLuint));
+  this->vertex_bytes += AppendBuffer(&this->vertex_buffer, this->vertex_bytes, mesh.vbo, "indirect vertices");
+  this->index_bytes += AppendBuffer(&this->index_buffer, this->index_bytes, mesh.ibo, "indirect indices");
+
+  // Re-point the VAO at the new buffers.
+  glBindVertexArray(this->vao);
+  glBindBuffer(GL_ARRAY_BUFFER, this->vertex_buffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->index_buffer);
+  configureMeshVertexAttributes();
+  glBindVertexArray(GL_NONE);
+  glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
+
+  GLuint const slot = (GLuint)this->mesh_ranges.size();
+  for (MeshLod const& range : mesh.lods) {
+    this->mesh_ranges.push_back(MeshRange{base_index + (GLuint)range.first, (GLuint)range.count, base_vertex});
+  }
+  this->mesh_slots.insert(std::make_pair(&mesh, slot));
+
+  return slot + (GLuint)lod;
+}
+
+void IndirectRenderer::ForgetMesh(Mesh const& mesh) {
+  this->mesh_slots.erase(&mesh);
+}
+
+void IndirectRenderer::Draw(GLuint program, std::vector<IndirectInstance> const& instances, glm::mat4 const& viewProjectionMatrix) {
+  if (instances.empty() || this->mesh_ranges.empty()) {
+    return;
+  }
+
+  GL_DEBUG_SITE("indirect cull");
+
+  // Reserve a range of the visible list for each mesh, big enough for all of its instances.
+  this->mesh_instance_counts.assign(this->mesh_ranges.size(), 0);
+  for (auto const& instance : instances) {
+    this->mesh_instance_counts[instance.mesh] += 1;
+  }
+
+  // Start every command with no instances; the cull shader counts them up.
+  this->commands.resize(COMMAND_WORDS * this->mesh_ranges.size());
+  GLuint base_instance = 0;
+  for (size_t slot = 0; slot < this->mesh_ranges.size(); ++slot) {
+    this->commands[COMMAND_WORDS*slot + 0] = this->mesh_ranges[slot].count;
+    this->commands[COMMAND_WORDS*slot + 1] = 0;
+    this->commands[COMMAND_WORDS*slot + 2] = this->mesh_ranges[slot].first;
+    this->commands[COMMAND_WORDS*slot + 3] = this->mesh_ranges[slot].base_vertex;
+    this->commands[COMMAND_WORDS*slot + 4] = base_instance;
+    base_instance += this->mesh_instance_counts[slot];
+  }
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->instance_buffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(IndirectInstance)*instances.size(), instances.data(), GL_STREAM_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->command_buffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint)*this->commands.size(), this->commands.data(), GL_STREAM_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->visible_buffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint)*instances.size(), nullptr, GL_STREAM_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, GL_NONE);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, this->instance_buffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, this->command_buffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BINDING, this->visible_buffer);
+
+  glm::vec4 planes[6];
+  getFrustumPlanes(viewProjectionMatrix, planes);
+
+  // Cull on the GPU.
+  glUseProgram(this->cull_program);
+  glUniform4fv(glGetUniformLocation(this->cull_program, "u_frustumPlanes"), 6, glm::value_ptr(planes[0]));
+  glUniform1ui(glGetUniformLocation(this->cull_program, "u_instanceCount"), (GLuint)instances.size());
+  glDispatchCompute((GLuint)((instances.size() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), 1, 1);
+
+  // Make the culling results visible to indirect draws and vertex fetch.
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+  // Draw everything at once.
+  GL_DEBUG_SITE("indirect draw");
+  glUseProgram(program);
+  glBindVertexArray(this->vao);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->command_buffer);
+  glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (GLvoid*)0, (GLsizei)this->mesh_ranges.size(), 0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, GL_NONE);
+  glBindVertexArray(GL_NONE);
+}
+
+// Copies the whole of a buffer into `words`.
+static void ReadBuffer(GLuint buffer, std::vector<GLuint>* const words) {
+  GLint bytes = 0;
+  glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+  glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &bytes);
+  words->resize(bytes / sizeof(GLuint));
+  if (!words->empty()) {
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, bytes, words->data());
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, GL_NONE);
+}
+
+void IndirectRenderer::ReadBack(std::vector<GLuint>* const commands, std::vector<GLuint>* const visible) {
+  // The cull shader's writes must land before buffer reads see them.
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  ReadBuffer(this->command_buffer, commands);
+  ReadBuffer(this->visible_buffer, visible);
+}
+
+void getFrustumPlanes(glm::mat4 const& viewProjectionMatrix, glm::vec4 planes[6]) {
+  for (int axis = 0; axis < 3; ++axis) {
+    planes[2*axis + 0] = glm::row(viewProjectionMatrix, 3) + glm::row(viewProjectionMatrix, axis);
+    planes[2*axis + 1] = glm::row(viewProjectionMatrix, 3) - glm::row(viewProjectionMatrix, axis);
+  }
+  for (int i = 0; i < 6; ++i) {
+    planes[i] /= glm::length(glm::vec3{planes[i]});
+  }
+}
+
+bool isSphereInFrustum(glm::vec4 const planes[6], glm::vec4 sphere) {
+  for (int i = 0; i < 6; ++i) {
+    if (glm::dot(glm::vec3{planes[i]}, glm::vec3{sphere}) + planes[i].w < -sphere.w) {
+      return false;  // Entirely outside this plane
+    }
+  }
+  return true;
+}
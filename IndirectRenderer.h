@@ -0,0 +1,98 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <unordered_map>
+#include <vector>
+
+#include "Mesh.h"
+
+// A mirror of the `Instance` struct in shaders/cull.glsl and shaders/indirect-vertex.glsl,
+// laid out per std430.
+struct IndirectInstance {
+  glm::mat4 worldMatrix;
+  glm::mat4 normalMatrix;  // Only the upper 3x3 is used
+  glm::vec4 emissivity;
+  glm::vec4 sphere;  // World-space bounding sphere: center, radius
+  GLuint mesh;  // Mesh LOD slot, as returned by IndirectRenderer::GetMeshSlot
+  GLuint padding[3];
+};
+
+// GPU-driven rendering for GL 4.3+.
+//
+// Every mesh drawn through this path is copied into one shared vertex buffer and
+// one shared index buffer.
+// Each frame, a compute shader culls all instances' bounding spheres against the
+// view frustum and appends the survivors to per-mesh ranges of a visible-instance
+// list, bumping the instance counts of per-mesh indirect draw commands. Each level
+// of detail of a mesh counts as a mesh of its own here. Everything
+// is then drawn with a single glMultiDrawElementsIndirect, with no per-object
+// decisions made on the CPU.
+//
+// The visible list feeds vertex attribute 3 with a divisor of 1, so each drawn
+// instance reads its own index (offset by the command's baseInstance) and fetches
+// the rest of its data from the instance buffer.
+class IndirectRenderer {
+private:
+  GLuint cull_program = GL_NONE;
+
+  GLuint vao = GL_NONE;
+  GLuint vertex_buffer = GL_NONE;  // Shared vertex data of every registered mesh
+  GLuint index_buffer = GL_NONE;  // Shared index data of every registered mesh
+  GLuint instance_buffer = GL_NONE;  // IndirectInstance per instance (SSBO)
+  GLuint command_buffer = GL_NONE;  // DrawElementsIndirectCommand per mesh LOD
+  GLuint visible_buffer = GL_NONE;  // Indices of visible instances, grouped by mesh LOD
+
+  // Where each level of detail of each registered mesh lives within the shared buffers.
+  // The LODs of a mesh occupy consecutive slots, starting from the one in `mesh_slots`.
+  struct MeshRange {
+    GLuint first;  // First index within the shared index buffer
+    GLuint count;  // Number of indices
+    GLuint base_vertex;  // Offset of the mesh's vertices within the shared vertex buffer
+  };
+  std::unordered_map<Mesh const*, GLuint> mesh_slots;
+  std::vector<MeshRange> mesh_ranges;
+  GLsizeiptr vertex_bytes = 0;
+  GLsizeiptr index_bytes = 0;
+
+  // Per-frame scratch space
+  std::vector<GLuint> mesh_instance_counts;
+  std::vector<GLuint> commands;
+
+public:
+  // Whether the driver supports this path (compute shaders, SSBOs, multi-draw indirect).
+  static bool IsSupported();
+
+  IndirectRenderer();
+  ~IndirectRenderer();
+
+  IndirectRenderer(IndirectRenderer const&) = delete;
+  IndirectRenderer& operator=(IndirectRenderer const&) = delete;
+
+  // Returns the slot of the given level of detail of a mesh, copying the mesh
+  // into the shared buffers the first time it is seen.
+  GLuint GetMeshSlot(Mesh const& mesh, int lod);
+
+  // Stops recognizing a mesh which is about to be destroyed. Its copy stays in the
+  // shared buffers, unused; they are never compacted.
+  void ForgetMesh(Mesh const& mesh);
+
+  // Culls the given instances, then draws the survivors with `program`, whose
+  // non-instance uniforms must already be set. The program must read instances
+  // from SSBO binding 0, as shaders/indirect-vertex.glsl does.
+  void Draw(GLuint program, std::vector<IndirectInstance> const& instances, glm::mat4 const& viewProjectionMatrix);
+
+  // Reads back what the last Draw's culling wrote: its draw commands (five uints
+  // per mesh LOD slot, as DrawElementsIndirectCommand) and its visible-instance
+  // list. Waits for the GPU, so it is only for tests.
+  void ReadBack(std::vector<GLuint>* const commands, std::vector<GLuint>* const visible);
+};
+
+// Extracts the planes of a view frustum (Gribb/Hartmann), with normals pointing
+// inwards, normalized so that each plane equation gives a signed distance.
+void getFrustumPlanes(glm::mat4 const& viewProjectionMatrix, glm::vec4 planes[6]);
+
+// Whether a bounding sphere (center, radius) lies at least partly inside a frustum.
+// The same test shaders/cull.glsl makes on the GPU.
+bool isSphereInFrustum(glm::vec4 const planes[6], glm::vec4 sphere);
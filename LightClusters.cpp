@@ -0,0 +1,157 @@
+#include "LightClusters.h"
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+
+void LightClusters::Configure(glm::mat4 const& projection) {
+  this->projection = projection;
+
+  // Recover the clip planes from the perspective matrix.
+  // The far plane is ill-conditioned in single precision, so work in double.
+  double const a = projection[2][2];
+  double const b = projection[3][2];
+  this->near_plane = (float)(b / (a - 1.0));
+  this->far_plane = (float)(b / (a + 1.0));
+
+  // A point at NDC (x, y) and view depth d sits at (x*d/P00, y*d/P11, -d).
+  this->cluster_bounds.resize(CLUSTER_COUNT);
+  for (int slice = 0; slice < SLICES; ++slice) {
+    float const depths[2] = {GetSliceDepth(slice), GetSliceDepth(slice + 1)};
+
+    for (int y = 0; y < TILES_Y; ++y) {
+      float const ndc_y[2] = {-1.0f + 2.0f*y/TILES_Y, -1.0f + 2.0f*(y+1)/TILES_Y};
+
+      for (int x = 0; x < TILES_X; ++x) {
+        float const ndc_x[2] = {-1.0f + 2.0f*x/TILES_X, -1.0f + 2.0f*(x+1)/TILES_X};
+
+        Bounds bounds{glm::vec3{INFINITY}, glm::vec3{-INFINITY}};
+        for (float depth : depths) {
+          for (float nx : ndc_x) {
+            for (float ny : ndc_y) {
+              glm::vec3 const corner{nx*depth/projection[0][0], ny*depth/projection[1][1], -depth};
+              bounds.min = glm::min(bounds.min, corner);
+              bounds.max = glm::max(bounds.max, corner);
+            }
+          }
+        }
+
+        this->cluster_bounds[GetClusterIndex(x, y, slice)] = bounds;
+      }
+    }
+  }
+}
+
+float LightClusters::GetSliceScale() const {
+  return SLICES / std::log(this->far_plane / this->near_plane);
+}
+
+// Maps a positive view depth onto its depth slice.
+int LightClusters::GetSlice(float depth) const {
+  if (depth <= this->near_plane) {
+    return 0;
+  }
+
+  int const slice = (int)std::floor(std::log(depth / this->near_plane) * GetSliceScale());
+  return std::min(std::max(slice, 0), SLICES - 1);
+}
+
+// The view depth at which the given slice begins.
+float LightClusters::GetSliceDepth(int slice) const {
+  return this->near_plane * std::pow(this->far_plane / this->near_plane, (float)slice / SLICES);
+}
+
+void LightClusters::Build(glm::mat4 const& view, std::vector<ClusterLight> const& world_lights) {
+  this->lights.clear();
+  this->pair_clusters.clear();
+  this->pair_lights.clear();
+
+  size_t const light_count = std::min(world_lights.size(), (size_t)MAX_LIGHTS);
+  for (size_t i = 0; i < light_count; ++i) {
+    ClusterLight const& light = world_lights[i];
+    glm::vec3 const center{view * glm::vec4{light.position, 1.0f}};
+    float const radius = light.radius;
+
+    // Skip lights entirely in front of the near plane or beyond the far plane.
+    float const min_depth = -center.z - radius;
+    float const max_depth = -center.z + radius;
+    if (max_depth <= this->near_plane || min_depth >= this->far_plane) {
+      continue;
+    }
+
+    // Find the screen-space tiles covered by the light's bounding box.
+    // If the box crosses the near plane, its projection is unbounded.
+    int tile_min_x = 0, tile_max_x = TILES_X - 1;
+    int tile_min_y = 0, tile_max_y = TILES_Y - 1;
+    if (min_depth > this->near_plane) {
+      glm::vec2 ndc_min{INFINITY};
+      glm::vec2 ndc_max{-INFINITY};
+      for (int corner = 0; corner < 8; ++corner) {
+        glm::vec3 const offset{
+          (corner & 1) ? radius : -radius,
+          (corner & 2) ? radius : -radius,
+          (corner & 4) ? radius : -radius,
+        };
+        glm::vec4 const clip = this->projection * glm::vec4{center + offset, 1.0f};
+        glm::vec2 const ndc = glm::vec2{clip.x, clip.y} / clip.w;
+        ndc_min = glm::min(ndc_min, ndc);
+        ndc_max = glm::max(ndc_max, ndc);
+      }
+
+      if (ndc_max.x < -1.0f || ndc_min.x > 1.0f || ndc_max.y < -1.0f || ndc_min.y > 1.0f) {
+        continue;  // Off-screen
+      }
+
+      tile_min_x = std::max(0, (int)std::floor((ndc_min.x + 1.0f) * 0.5f * TILES_X));
+      tile_max_x = std::min(TILES_X - 1, (int)std::floor((ndc_max.x + 1.0f) * 0.5f * TILES_X));
+      tile_min_y = std::max(0, (int)std::floor((ndc_min.y + 1.0f) * 0.5f * TILES_Y));
+      tile_max_y = std::min(TILES_Y - 1, (int)std::floor((ndc_max.y + 1.0f) * 0.5f * TILES_Y));
+    }
+
+    uint32_t const light_index = (uint32_t)(this->lights.size() / 2);
+    this->lights.push_back(glm::vec4{light.position, radius});
+    this->lights.push_back(glm::vec4{light.color * light.intensity, 0.0f});
+
+    int const slice_min = GetSlice(min_depth);
+    int const slice_max = GetSlice(max_depth);
+
+    for (int slice = slice_min; slice <= slice_max; ++slice) {
+      for (int y = tile_min_y; y <= tile_max_y; ++y) {
+        for (int x = tile_min_x; x <= tile_max_x; ++x) {
+          int const cluster = GetClusterIndex(x, y, slice);
+          Bounds const& bounds = this->cluster_bounds[cluster];
+
+          // Sphere-box overlap test
+          glm::vec3 const closest = glm::clamp(center, bounds.min, bounds.max);
+          glm::vec3 const delta = closest - center;
+          if (glm::dot(delta, delta) > radius*radius) {
+            continue;
+          }
+
+          this->pair_clusters.push_back((uint32_t)cluster);
+          this->pair_lights.push_back(light_index);
+        }
+      }
+    }
+  }
+
+  // Counting sort the (cluster, light) pairs by cluster into compact lists.
+  this->grid.assign(2*CLUSTER_COUNT, 0);
+  for (uint32_t cluster : this->pair_clusters) {
+    this->grid[2*cluster + 1] += 1;
+  }
+
+  uint32_t offset = 0;
+  for (int cluster = 0; cluster < CLUSTER_COUNT; ++cluster) {
+    this->grid[2*cluster] = offset;
+    offset += this->grid[2*cluster + 1];
+    this->grid[2*cluster + 1] = 0;
+  }
+
+  this->indices.resize(this->pair_clusters.size());
+  for (size_t i = 0; i < this->pair_clusters.size(); ++i) {
+    uint32_t const cluster = this->pair_clusters[i];
+    this->indices[this->grid[2*cluster] + this->grid[2*cluster + 1]] = this->pair_lights[i];
+    this->grid[2*cluster + 1] += 1;
+  }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include <cstdint>
+#include <vector>
+
+// A dynamic point light with a finite range, in world space.
+struct ClusterLight {
+  glm::vec3 position;
+  float radius;  // Distance beyond which the light contributes nothing
+
+  glm::vec3 color;
+  float intensity;
+};
+
+// Bins point lights into a grid of view-space clusters for clustered forward shading.
+//
+// The view frustum is split into TILES_X by TILES_Y screen-space tiles, and into
+// SLICES depth slices spaced exponentially between the near and far planes. Each
+// frame, Build() records which lights overlap each cluster, so the fragment shader
+// only loops over the handful of lights that can affect its own cluster.
+//
+// The results are laid out ready for upload into buffer textures:
+//   grid     - two uints per cluster: an offset into `indices`, and a count.
+//   indices  - one uint per (cluster, light) pair: an index into `lights`.
+//   lights   - two vec4s per light: (world position, radius) and (color * intensity, 0).
+class LightClusters {
+public:
+  static int const TILES_X = 16;
+  static int const TILES_Y = 9;
+  static int const SLICES = 24;
+  static int const CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+
+  // Lights beyond this count are ignored.
+  static int const MAX_LIGHTS = 1024;
+
+private:
+  // The bounds of each cluster in view space, indexed like `grid`.
+  struct Bounds {
+    glm::vec3 min;
+    glm::vec3 max;
+  };
+  std::vector<Bounds> cluster_bounds;
+
+  glm::mat4 projection{1.0f};
+  float near_plane = 1.0f;
+  float far_plane = 2.0f;
+
+  // (cluster, light) pairs found during binning, before sorting by cluster.
+  std::vector<uint32_t> pair_clusters;
+  std::vector<uint32_t> pair_lights;
+
+public:
+  std::vector<uint32_t> grid;
+  std::vector<uint32_t> indices;
+  std::vector<glm::vec4> lights;
+
+  // Precomputes cluster bounds for a symmetric perspective projection.
+  void Configure(glm::mat4 const& projection);
+
+  // Bins the given lights for a camera with the given view matrix.
+  void Build(glm::mat4 const& view, std::vector<ClusterLight> const& world_lights);
+
+  float GetNearPlane() const { return this->near_plane; }
+  float GetFarPlane() const { return this->far_plane; }
+
+  // The factor mapping log(depth / near) to a slice index.
+  float GetSliceScale() const;
+
+  static int GetClusterIndex(int x, int y, int slice) {
+    return (slice * TILES_Y + y) * TILES_X + x;
+  }
+
+private:
+  int GetSlice(float depth) const;
+  float GetSliceDepth(int slice) const;
+};
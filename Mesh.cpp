@@ -1,45 +1,71 @@
 #include "Mesh.h"
+#include "MeshFile.h"
+#include "util/debug.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <cstdio>
-#include <glm/glm.hpp>
-#include <glm/vec3.hpp>
-#include <iostream>
+#include <glm/gtc/matrix_transform.hpp>
+#include <string>
+
+// The on-screen radius (in pixels) below which the full-detail mesh gives way to LOD 1.
+// Each further level takes over at half the radius of the one before it.
+static float const LOD_FULL_DETAIL_PIXELS = 160.0f;
+
+// How far past a switching point (in levels) a mesh must go before its LOD changes,
+// so that meshes hovering near a threshold don't flicker between levels.
+static float const LOD_HYSTERESIS = 0.25f;
+
+// Creates a mesh from packed vertex data, and indices into it.
+static Mesh createMesh(
+  char const* label,
+  GLenum primitiveType,
+  void const* vertices,
+  GLsizeiptr vertexBytes,
+  GLuint const* indices,
+  GLsizei indexCount,
+  std::vector<MeshLod> lods,
+  float boundingRadius,
+  glm::vec3 positionOffset,
+  glm::vec3 positionScale
+) {
+  Mesh mesh;
 
-static bool readTriFile(char const* tri_path, std::vector<GLfloat>* const tri_vector, float* const radius);
-static bool readTriLine(FILE* f, std::vector<GLfloat>* const tri_vector, float* const radius);
+  // Create GPU memory handles
+  // These allow you to allocate and store things in GPU memory.
+  // Initially, there is no memory associated with them.
+  glGenBuffers(1, &mesh.vbo);
+  glGenBuffers(1, &mesh.ibo);
 
-Mesh loadMeshFromFile(char const* tri_path) {
-  Mesh mesh;
+  // Create a vertex array object (VAO).
+  // This captures information about which VBOs to look at for which vertex attributes,
+  // and where within each VBO each attribute can be found.
+  // Binding a VAO makes all of this information immediately active in the GL state machine,
+  // making rendering much simpler.
+  glGenVertexArrays(1, &mesh.vao);
 
   // Make the model's GL state active
+  GL_DEBUG_SITE(label);
   glBindVertexArray(mesh.vao);
   glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
-
-  // get our file and parse it into our vector of GLfloats
-  std::vector<GLfloat> tri_vector;
-  float radius = 0.0f;
-  readTriFile(tri_path, &tri_vector, &radius);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);  // Captured by the VAO
+  labelGlObject(GL_VERTEX_ARRAY, mesh.vao, label);
+  labelGlObject(GL_BUFFER, mesh.vbo, label);
+  labelGlObject(GL_BUFFER, mesh.ibo, label);
 
   // Upload the model to GPU memory
-  glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat)*tri_vector.size(), tri_vector.data(), GL_STATIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices, GL_STATIC_DRAW);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint)*indexCount, indices, GL_STATIC_DRAW);
 
-  mesh.primitiveType = GL_TRIANGLES;
-  mesh.primitiveCount = (GLsizei)(tri_vector.size()/7);
-  mesh.boundingRadius = radius;
+  mesh.primitiveType = primitiveType;
+  mesh.lods = std::move(lods);
+  mesh.primitiveCount = mesh.lods.empty() ? indexCount : mesh.lods[0].count;
+  mesh.boundingRadius = boundingRadius;
+  mesh.positionOffset = positionOffset;
+  mesh.positionScale = positionScale;
 
-  // std::cout << tri_path << " - " << radius << std::endl;
-
-  // Set attribute slot 0 to read the first 3 floats out of every set of 10 floats in the model.
-  // In other words, slot 0 refers to the position data.
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 10*sizeof(GLfloat), (GLvoid*)(0*sizeof(GLfloat)));
-  glEnableVertexAttribArray(0);
-
-  // Slot 1 refers to the normal data.
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 10*sizeof(GLfloat), (GLvoid*)(3*sizeof(GLfloat)));
-  glEnableVertexAttribArray(1);
-
-  // Slot 2 refers to the color data.
-  glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 10*sizeof(GLfloat), (GLvoid*)(6*sizeof(GLfloat)));
-  glEnableVertexAttribArray(2);
+  // Describe the layout of the vertex data to the VAO.
+  configureMeshVertexAttributes();
 
   // As a precaution, unbind the vertex array so that GL operations don't accidentally operate on it.
   // The state and vertex information still exists - we can just bind model.vao to make it active again.
@@ -48,99 +74,95 @@ Mesh loadMeshFromFile(char const* tri_path) {
   return mesh;
 }
 
-// load a .TRI file into a vector of GLFloats using the provided file path and vector reference
-// returns true if successful, false otherwise
-static bool readTriFile(char const* tri_path, std::vector<GLfloat>* const tri_vector, float* const radius) {
-  FILE* f = fopen(tri_path, "r");
-  if (!f) {
-    fprintf(stderr, "Unable to open file '%s'.\n", tri_path);
-    return false;
+Mesh uploadMesh(char const* label, MeshData const& data) {
+  return createMesh(
+    label,
+    data.primitiveType,
+    data.vertices.data(),
+    sizeof(PackedVertex)*data.vertices.size(),
+    data.indices.data(),
+    (GLsizei)data.indices.size(),
+    data.lods,
+    data.boundingRadius,
+    data.positionOffset,
+    data.positionScale
+  );
+}
+
+Mesh uploadMesh(char const* label, LoadedMesh const& loaded) {
+  if (!loaded.file) {
+    return uploadMesh(label, loaded.data);
   }
 
-  while (!feof(f)) {
-    // parse current line into our array
-    bool success = readTriLine(f, tri_vector, radius);
-    if (!success) {
-      break;
+  // The converted binary mesh is handed to GL straight from the page cache.
+  MeshFileHeader const& header = loaded.file->GetHeader();
+  return createMesh(
+    label,
+    header.primitive_type,
+    loaded.file->GetVertices(),
+    header.vertex_bytes,
+    loaded.file->GetIndices(),
+    (GLsizei)header.index_count,
+    loaded.file->GetLods(),
+    header.bounding_radius,
+    glm::vec3{header.position_offset[0], header.position_offset[1], header.position_offset[2]},
+    glm::vec3{header.position_scale[0], header.position_scale[1], header.position_scale[2]}
+  );
+}
+
+bool readMeshFromFile(char const* tri_path, LoadedMesh* const loaded) {
+  // Prefer the converted binary mesh, which needs no parsing.
+  std::string const mesh_path = getMeshFilePath(tri_path);
+  if (isMeshFileCurrent(mesh_path.c_str(), tri_path)) {
+    std::unique_ptr<MappedMeshFile> file{new MappedMeshFile{}};
+    if (file->Open(mesh_path.c_str())) {
+      loaded->file = std::move(file);
+      return true;
     }
   }
 
-  fclose(f);
-  return true;
+  // Otherwise, parse the source model.
+  loaded->file.reset();
+  return loadTriMeshData(tri_path, &loaded->data);
 }
 
-// Parses a line from a .TRI file and pushes vertex position and color data into vector
-// takes file pointer and reference to vector of GLfloats
-static bool readTriLine(FILE* f, std::vector<GLfloat>* const tri_vector, float* const radius) {
-  // our vertex position data
-  float p1x, p1y, p1z;
-  float p2x, p2y, p2z;
-  float p3x, p3y, p3z;
-
-  // our vertex color data
-  unsigned int rgb;
-
-  // parse the line of elements into local vars
-  fscanf(f, "%f %f %f %f %f %f %f %f %f 0x%x",
-      &p1x, &p1y, &p1z,
-      &p2x, &p2y, &p2z,
-      &p3x, &p3y, &p3z,
-      &rgb
-  );
+Mesh loadMeshFromFile(char const* tri_path) {
+  LoadedMesh loaded;
+  readMeshFromFile(tri_path, &loaded);
+  return uploadMesh(tri_path, loaded);
+}
 
-  // check for file read errors
-  if (feof(f) || ferror(f)) {
-    return false; // malformed line, oops!
+int selectMeshLod(Mesh const& mesh, int current, float pixel_radius) {
+  int const coarsest = std::max((int)mesh.lods.size() - 1, 0);
+
+  // The ideal level, as a continuous value: level n takes over at LOD_FULL_DETAIL_PIXELS / 2^(n-1).
+  float const level = (pixel_radius > 0.0f)
+    ? std::log2(LOD_FULL_DETAIL_PIXELS / pixel_radius) + 1.0f
+    : (float)coarsest;
+
+  // Only leave the current level once we're well past its bounds.
+  if (level >= current + 1 + LOD_HYSTERESIS || level <= current - LOD_HYSTERESIS) {
+    current = (int)std::floor(level);
   }
 
-  // bit shifting with masking to separate out RGB color data
-  glm::vec4 const color{
-      (float)((rgb >> 16) & 0xFF) / 0xFF,  // Red
-      (float)((rgb >>  8) & 0xFF) / 0xFF,  // Green
-      (float)((rgb >>  0) & 0xFF) / 0xFF,  // Blue
-      1.0f,                                // Alpha
-  };
-
-  glm::vec3 const p1{p1x, p1y, p1z};
-  glm::vec3 const p2{p2x, p2y, p2z};
-  glm::vec3 const p3{p3x, p3y, p3z};
-  glm::vec3 const normal = glm::normalize(glm::cross(p2 - p1, p3 - p1));
-
-  // push our data into the vector of GLfloats
-  tri_vector->push_back(p1.x);
-  tri_vector->push_back(p1.y);
-  tri_vector->push_back(p1.z);
-  tri_vector->push_back(normal.x);
-  tri_vector->push_back(normal.y);
-  tri_vector->push_back(normal.z);
-  tri_vector->push_back(color.r);
-  tri_vector->push_back(color.g);
-  tri_vector->push_back(color.b);
-  tri_vector->push_back(color.a);
-
-  tri_vector->push_back(p2.x);
-  tri_vector->push_back(p2.y);
-  tri_vector->push_back(p2.z);
-  tri_vector->push_back(normal.x);
-  tri_vector->push_back(normal.y);
-  tri_vector->push_back(normal.z);
-  tri_vector->push_back(color.r);
-  tri_vector->push_back(color.g);
-  tri_vector->push_back(color.b);
-  tri_vector->push_back(color.a);
-
-  tri_vector->push_back(p3.x);
-  tri_vector->push_back(p3.y);
-  tri_vector->push_back(p3.z);
-  tri_vector->push_back(normal.x);
-  tri_vector->push_back(normal.y);
-  tri_vector->push_back(normal.z);
-  tri_vector->push_back(color.r);
-  tri_vector->push_back(color.g);
-  tri_vector->push_back(color.b);
-  tri_vector->push_back(color.a);
-
-  *radius = fmax(fmax(glm::length(p1), glm::length(p2)), fmax(glm::length(p3), *radius));
-
-  return true;
+  return std::min(std::max(current, 0), coarsest);
+}
+
+glm::mat4 Mesh::GetPositionMatrix() const {
+  return glm::scale(glm::translate(glm::mat4{1.0f}, this->positionOffset), this->positionScale);
+}
+
+void configureMeshVertexAttributes() {
+  // Slot 0 refers to the position data: four shorts, normalized onto [-1, 1].
+  // The fourth is padding, so the shader should only use xyz.
+  glVertexAttribPointer(0, 4, GL_SHORT, GL_TRUE, MESH_VERTEX_STRIDE, (GLvoid*)offsetof(PackedVertex, position));
+  glEnableVertexAttribArray(0);
+
+  // Slot 1 refers to the normal data: 10 bits each of x, y and z, normalized onto [-1, 1].
+  glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, MESH_VERTEX_STRIDE, (GLvoid*)offsetof(PackedVertex, normal));
+  glEnableVertexAttribArray(1);
+
+  // Slot 2 refers to the color data: four bytes, normalized onto [0, 1].
+  glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, MESH_VERTEX_STRIDE, (GLvoid*)offsetof(PackedVertex, color));
+  glEnableVertexAttribArray(2);
 }
@@ -1,33 +1,37 @@
 #pragma once
 
 #include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <memory>
 #include <vector>
 
+#include "MeshData.h"
+#include "MeshFile.h"
+
 struct Mesh {
   GLuint vbo = GL_NONE;  // References vertex attribute information loaded onto the GPU
+  GLuint ibo = GL_NONE;  // References the indices of each primitive's vertices within `vbo`
   GLuint vao = GL_NONE;  // Describes the format and intent of the vertex attribute information
   GLenum primitiveType = GL_TRIANGLES;  // Describe the mapping between vertices and primitives
-  GLsizei primitiveCount = 0;  // The number of primitives in the mesh
+  GLsizei primitiveCount = 0;  // The number of indices in the full-detail mesh
+
+  // Levels of detail, from full detail (lods[0]) to coarsest, as ranges of `ibo`.
+  std::vector<MeshLod> lods;
 
   float boundingRadius = 1;  // The radius of a sphere bounding the mesh
 
-  Mesh() {
-    // Create a GPU memory handle
-    // This allows you to allocate and store things in GPU memory.
-    // Initially, there is no memory associated with this handle.
-    glGenBuffers(1, &this->vbo);
-
-    // Create a vertex array object (VAO).
-    // This captures information about which VBOs to look at for which vertex attributes,
-    // and where within each VBO each attribute can be found.
-    // Binding a VAO makes all of this information immediately active in the GL state machine,
-    // making rendering much simpler.
-    glGenVertexArrays(1, &this->vao);
-  }
+  // Vertex positions are packed into [-1, 1] across the mesh's bounding box,
+  // and decode to positionOffset + positionScale * (packed position).
+  glm::vec3 positionOffset{0.0f};
+  glm::vec3 positionScale{1.0f};
+
+  // A mesh with no GL objects, until uploadMesh creates them. Until then it makes
+  // no GL calls at all, so a bare mesh (just a bounding radius, say) needs no GL
+  // context; the benchmarks use these.
+  Mesh() {}
 
   ~Mesh() {
-    glDeleteVertexArrays(1, &this->vao);
-    glDeleteBuffers(1, &this->vbo);
+    ReleaseGlObjects();
   }
 
   /* Disable copy semantics for this type. */
@@ -39,34 +43,88 @@ struct Mesh {
     this->vbo = other.vbo;
     other.vbo = GL_NONE;
 
+    this->ibo = other.ibo;
+    other.ibo = GL_NONE;
+
     this->vao = other.vao;
     other.vao = GL_NONE;
 
     this->primitiveType = other.primitiveType;
     this->primitiveCount = other.primitiveCount;
+    this->lods = std::move(other.lods);
     this->boundingRadius = other.boundingRadius;
+    this->positionOffset = other.positionOffset;
+    this->positionScale = other.positionScale;
   }
   Mesh& operator=(Mesh&& other) {
     if (this == &other) {
       return *this;
     }
 
-    glDeleteBuffers(1, &this->vbo);
+    ReleaseGlObjects();
+
     this->vbo = other.vbo;
     other.vbo = GL_NONE;
 
-    glDeleteVertexArrays(1, &this->vao);
+    this->ibo = other.ibo;
+    other.ibo = GL_NONE;
+
     this->vao = other.vao;
     other.vao = GL_NONE;
 
     this->primitiveType = other.primitiveType;
     this->primitiveCount = other.primitiveCount;
+    this->lods = std::move(other.lods);
     this->boundingRadius = other.boundingRadius;
+    this->positionOffset = other.positionOffset;
+    this->positionScale = other.positionScale;
 
     return *this;
   }
+
+  // The transform from packed vertex positions to model space.
+  glm::mat4 GetPositionMatrix() const;
+
+private:
+  void ReleaseGlObjects() {
+    if (this->vao != GL_NONE) {
+      glDeleteVertexArrays(1, &this->vao);
+    }
+    if (this->vbo != GL_NONE) {
+      glDeleteBuffers(1, &this->vbo);
+    }
+    if (this->ibo != GL_NONE) {
+      glDeleteBuffers(1, &this->ibo);
+    }
+  }
 };
 
 
+// A mesh read from the filesystem, but not yet uploaded to the GPU:
+// either a mapped .mesh conversion, or data parsed from the source model.
+struct LoadedMesh {
+  std::unique_ptr<MappedMeshFile> file;  // Null if the source model was parsed instead
+  MeshData data;
+};
+
 // Loads .TRI mesh file from the filesystem.
+// If a current .mesh conversion of the file sits next to it, that is loaded instead.
 Mesh loadMeshFromFile(char const* tri_path);
+
+// The first half of loadMeshFromFile: reads the mesh into memory.
+// Makes no GL calls, so it may run on any thread.
+bool readMeshFromFile(char const* tri_path, LoadedMesh* const loaded);
+
+// Uploads mesh data to the GPU. `label` names the mesh in GL debug output.
+Mesh uploadMesh(char const* label, MeshData const& data);
+Mesh uploadMesh(char const* label, LoadedMesh const& loaded);
+
+// Picks the level of detail to draw for a mesh whose bounding sphere covers
+// `pixel_radius` pixels on screen, given the level drawn last frame.
+int selectMeshLod(Mesh const& mesh, int current, float pixel_radius);
+
+// Points vertex attributes 0 (position), 1 (normal) and 2 (color) of the bound VAO
+// at the bound GL_ARRAY_BUFFER, which must hold PackedVertex data. Every attribute
+// arrives in the shader as a normalized vec4; positions still need the mesh's
+// position matrix applied.
+void configureMeshVertexAttributes();
@@ -0,0 +1,333 @@
+#include "MeshAc3d.h"
+#include "MeshData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// The parts of a SURF's flags that we understand.
+static unsigned const SURF_TYPE_MASK = 0x0F;
+static unsigned const SURF_TYPE_POLYGON = 0x00;  // Other types are open or closed lines
+static unsigned const SURF_SHADED = 0x10;  // Smooth rather than flat shaded
+static unsigned const SURF_TWO_SIDED = 0x20;
+
+// AC3D's crease angle for objects which don't specify one.
+static float const DEFAULT_CREASE_DEGREES = 61.0f;
+
+struct AcSurface {
+  unsigned flags;
+  int material;
+  std::vector<int> refs;  // Indices of the object's vertices, counter-clockwise
+};
+
+struct AcObject {
+  glm::vec3 loc{0.0f};
+  glm::mat3 rot{1.0f};
+  float crease = DEFAULT_CREASE_DEGREES;
+  std::vector<glm::vec3> vertices;
+  std::vector<AcSurface> surfaces;
+};
+
+static bool ReadObject(FILE* f, glm::mat4 const& parentMatrix, std::vector<glm::vec4> const& materials, std::vector<GLfloat>* const soup, float* const crease_degrees);
+static void EmitObject(AcObject const& object, glm::mat4 const& worldMatrix, std::vector<glm::vec4> const& materials, std::vector<GLfloat>* const soup);
+
+// Skips the rest of the current line.
+static void SkipLine(FILE* f) {
+  int c;
+  do {
+    c = fgetc(f);
+  } while (c != '\n' && c != EOF);
+}
+
+bool readAc3dFile(char const* ac_path, std::vector<GLfloat>* const soup, float* const crease_degrees) {
+  FILE* f = fopen(ac_path, "r");
+  if (!f) {
+    fprintf(stderr, "Unable to open file '%s'.\n", ac_path);
+    return false;
+  }
+
+  // The header is "AC3D" followed by a format revision letter.
+  char token[64];
+  if (fscanf(f, "%63s", token) != 1 || strncmp(token, "AC3D", 4) != 0) {
+    fprintf(stderr, "'%s' is not an AC3D file.\n", ac_path);
+    fclose(f);
+    return false;
+  }
+
+  soup->clear();
+  float max_crease = 0.0f;
+  std::vector<glm::vec4> materials;
+  bool ok = true;
+  while (ok && fscanf(f, "%63s", token) == 1) {
+    if (strcmp(token, "MATERIAL") == 0) {
+      // MATERIAL "name" rgb r g b  amb r g b  emis r g b  spec r g b  shi n  trans t
+      char line[512] = {};
+      if (!fgets(line, sizeof(line), f)) {
+        ok = false;
+        break;
+      }
+
+      glm::vec4 color{1.0f};
+      char const* const rgb = strstr(line, " rgb ");
+      char const* const trans = strstr(line, " trans ");
+      if (rgb) {
+        sscanf(rgb, " rgb %f %f %f", &color.r, &color.g, &color.b);
+      }
+      if (trans) {
+        float transparency = 0.0f;
+        sscanf(trans, " trans %f", &transparency);
+        color.a = 1.0f - transparency;
+      }
+      materials.push_back(color);
+    } else if (strcmp(token, "OBJECT") == 0) {
+      SkipLine(f);  // The object type ("world", "poly", "group", ...) doesn't matter to us
+      ok = ReadObject(f, glm::mat4{1.0f}, materials, soup, &max_crease);
+    } else {
+      SkipLine(f);
+    }
+  }
+
+  if (!ok) {
+    fprintf(stderr, "'%s' is malformed.\n", ac_path);
+  }
+  if (crease_degrees) {
+    *crease_degrees = max_crease;
+  }
+
+  fclose(f);
+  return ok;
+}
+
+// Reads an object (after its OBJECT line) and, recursively, its children.
+static bool ReadObject(FILE* f, glm::mat4 const& parentMatrix, std::vector<glm::vec4> const& materials, std::vector<GLfloat>* const soup, float* const crease_degrees) {
+  AcObject object;
+
+  char token[64];
+  char line[512];
+  while (fscanf(f, "%63s", token) == 1) {
+    if (strcmp(token, "loc") == 0) {
+      if (fscanf(f, "%f %f %f", &object.loc.x, &object.loc.y, &object.loc.z) != 3) {
+        return false;
+      }
+    } else if (strcmp(token, "rot") == 0) {
+      // Stored row by row; glm matrices are indexed by column.
+      glm::mat3 rows;
+      for (int row = 0; row < 3; ++row) {
+        if (fscanf(f, "%f %f %f", &rows[row].x, &rows[row].y, &rows[row].z) != 3) {
+          return false;
+        }
+      }
+      object.rot = glm::transpose(rows);
+    } else if (strcmp(token, "crease") == 0) {
+      if (fscanf(f, "%f", &object.crease) != 1) {
+        return false;
+      }
+    } else if (strcmp(token, "data") == 0) {
+      // "data <length>", then that many characters of arbitrary data on the following line(s).
+      int length = 0;
+      if (fscanf(f, "%d", &length) != 1) {
+        return false;
+      }
+      SkipLine(f);
+      for (int i = 0; i < length; ++i) {
+        fgetc(f);
+      }
+    } else if (strcmp(token, "numvert") == 0) {
+      int count = 0;
+      if (fscanf(f, "%d", &count) != 1 || count < 0) {
+        return false;
+      }
+      SkipLine(f);
+
+      object.vertices.resize(count);
+      for (glm::vec3& vertex : object.vertices) {
+        if (!fgets(line, sizeof(line), f) || sscanf(line, "%f %f %f", &vertex.x, &vertex.y, &vertex.z) != 3) {
+          return false;
+        }
+      }
+    } else if (strcmp(token, "numsurf") == 0) {
+      int count = 0;
+      if (fscanf(f, "%d", &count) != 1 || count < 0) {
+        return false;
+      }
+
+      object.surfaces.resize(count);
+      for (AcSurface& surface : object.surfaces) {
+        surface.flags = 0;
+        surface.material = 0;
+
+        // SURF <flags>, then an optional "mat <index>", then "refs <count>" and a line per reference.
+        if (fscanf(f, "%63s %x", token, &surface.flags) != 2 || strcmp(token, "SURF") != 0) {
+          return false;
+        }
+        while (fscanf(f, "%63s", token) == 1 && strcmp(token, "refs") != 0) {
+          if (strcmp(token, "mat") == 0) {
+            if (fscanf(f, "%d", &surface.material) != 1) {
+              return false;
+            }
+          } else {
+            SkipLine(f);
+          }
+        }
+
+        int refs = 0;
+        if (fscanf(f, "%d", &refs) != 1 || refs < 0) {
+          return false;
+        }
+        SkipLine(f);
+
+        surface.refs.resize(refs);
+        for (int& ref : surface.refs) {
+          // "<index> <u> <v>"; texture coordinates are ignored.
+          if (!fgets(line, sizeof(line), f) || sscanf(line, "%d", &ref) != 1) {
+            return false;
+          }
+          if (ref < 0 || (size_t)ref >= object.vertices.size()) {
+            return false;
+          }
+        }
+      }
+    } else if (strcmp(token, "kids") == 0) {
+      // The last line of an object's own data.
+      int kids = 0;
+      if (fscanf(f, "%d", &kids) != 1) {
+        return false;
+      }
+
+      glm::mat4 const worldMatrix = parentMatrix * glm::translate(glm::mat4{1.0f}, object.loc) * glm::mat4{object.rot};
+      EmitObject(object, worldMatrix, materials, soup);
+      if (!object.surfaces.empty()) {
+        *crease_degrees = std::max(*crease_degrees, object.crease);
+      }
+
+      for (int i = 0; i < kids; ++i) {
+        if (fscanf(f, "%63s", token) != 1 || strcmp(token, "OBJECT") != 0) {
+          return false;
+        }
+        SkipLine(f);
+        if (!ReadObject(f, worldMatrix, materials, soup, crease_degrees)) {
+          return false;
+        }
+      }
+      return true;
+    } else {
+      // name, texture, texrep, url, and anything newer than this reader
+      SkipLine(f);
+    }
+  }
+
+  return false;  // The file ended before the object's "kids" line
+}
+
+// Triangulates an object's polygons into the soup, with smooth normals where asked for.
+static void EmitObject(AcObject const& object, glm::mat4 const& worldMatrix, std::vector<glm::vec4> const& materials, std::vector<GLfloat>* const soup) {
+  size_t const vertex_count = object.vertices.size();
+
+  std::vector<glm::vec3> positions(vertex_count);
+  for (size_t i = 0; i < vertex_count; ++i) {
+    positions[i] = glm::vec3{worldMatrix * glm::vec4{object.vertices[i], 1.0f}};
+  }
+
+  // Vertices are often repeated, so smooth by position rather than by vertex index.
+  std::vector<size_t> order(vertex_count);
+  for (size_t i = 0; i < vertex_count; ++i) {
+    order[i] = i;
+  }
+  auto const lexicographic = [&positions](size_t a, size_t b) {
+    glm::vec3 const& p = positions[a];
+    glm::vec3 const& q = positions[b];
+    return (p.x != q.x) ? p.x < q.x : (p.y != q.y) ? p.y < q.y : p.z < q.z;
+  };
+  std::sort(order.begin(), order.end(), lexicographic);
+
+  std::vector<size_t> position_ids(vertex_count);
+  size_t position_count = 0;
+  for (size_t i = 0; i < vertex_count; ++i) {
+    if (i > 0 && positions[order[i]] != positions[order[i - 1]]) {
+      position_count += 1;
+    }
+    position_ids[order[i]] = position_count;
+  }
+  position_count += 1;
+
+  // Newell's method gives each polygon's normal, scaled by twice its area.
+  std::vector<glm::vec3> face_normals(object.surfaces.size(), glm::vec3{0.0f});
+  std::vector<std::vector<size_t>> faces_at(position_count);
+  for (size_t s = 0; s < object.surfaces.size(); ++s) {
+    AcSurface const& surface = object.surfaces[s];
+    if ((surface.flags & SURF_TYPE_MASK) != SURF_TYPE_POLYGON || surface.refs.size() < 3) {
+      continue;
+    }
+
+    glm::vec3 normal{0.0f};
+    for (size_t i = 0; i < surface.refs.size(); ++i) {
+      glm::vec3 const& a = positions[surface.refs[i]];
+      glm::vec3 const& b = positions[surface.refs[(i + 1) % surface.refs.size()]];
+      normal += glm::vec3{(a.y - b.y) * (a.z + b.z), (a.z - b.z) * (a.x + b.x), (a.x - b.x) * (a.y + b.y)};
+    }
+    face_normals[s] = normal;
+
+    if (surface.flags & SURF_SHADED) {
+      for (int ref : surface.refs) {
+        faces_at[position_ids[ref]].push_back(s);
+      }
+    }
+  }
+
+  float const crease_cosine = std::cos(glm::radians(object.crease));
+  std::vector<glm::vec3> corner_normals;
+  for (size_t s = 0; s < object.surfaces.size(); ++s) {
+    AcSurface const& surface = object.surfaces[s];
+    float const area = glm::length(face_normals[s]);
+    if ((surface.flags & SURF_TYPE_MASK) != SURF_TYPE_POLYGON || surface.refs.size() < 3 || area == 0.0f) {
+      continue;  // Lines and degenerate polygons draw nothing
+    }
+    glm::vec3 const face_normal = face_normals[s] / area;
+
+    // Average, weighted by area, the normals of the smooth faces around each corner
+    // that meet this face at less than the crease angle.
+    corner_normals.assign(surface.refs.size(), face_normal);
+    if (surface.flags & SURF_SHADED) {
+      for (size_t i = 0; i < surface.refs.size(); ++i) {
+        glm::vec3 sum{0.0f};
+        for (size_t other : faces_at[position_ids[surface.refs[i]]]) {
+          float const other_area = glm::length(face_normals[other]);
+          if (other_area > 0.0f && glm::dot(face_normal, face_normals[other] / other_area) >= crease_cosine) {
+            sum += face_normals[other];
+          }
+        }
+        corner_normals[i] = glm::normalize(sum);  // Includes this face, so never zero
+      }
+    }
+
+    glm::vec4 const color = (surface.material >= 0 && (size_t)surface.material < materials.size())
+      ? materials[surface.material]
+      : glm::vec4{1.0f};
+
+    // Fan out from the first corner; AC3D polygons are convex.
+    int const sides = (surface.flags & SURF_TWO_SIDED) ? 2 : 1;
+    for (int side = 0; side < sides; ++side) {
+      float const facing = (side == 0) ? 1.0f : -1.0f;
+      for (size_t i = 1; i + 1 < surface.refs.size(); ++i) {
+        size_t corners[3] = {0, i, i + 1};
+        if (side == 1) {
+          std::swap(corners[1], corners[2]);
+        }
+
+        for (size_t corner : corners) {
+          glm::vec3 const& position = positions[surface.refs[corner]];
+          glm::vec3 const normal = facing * corner_normals[corner];
+          GLfloat const vertex[MESH_SOURCE_VERTEX_FLOATS] = {
+            position.x, position.y, position.z,
+            normal.x, normal.y, normal.z,
+            color.r, color.g, color.b, color.a,
+          };
+          soup->insert(soup->end(), vertex, vertex + MESH_SOURCE_VERTEX_FLOATS);
+        }
+      }
+    }
+  }
+}
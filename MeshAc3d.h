@@ -0,0 +1,23 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <vector>
+
+// Reads an AC3D (.ac) model into a triangle soup in the working vertex layout
+// (see MESH_SOURCE_VERTEX_FLOATS), ready for buildMeshData.
+//
+// Unlike the .TRI route, the soup keeps the model's smooth shading: surfaces
+// flagged as smooth get per-vertex normals averaged over the faces that meet at
+// each position, except across edges sharper than the object's crease angle.
+// Since neighbouring faces then share identical vertices, welding folds the soup
+// back down to roughly the model's own vertex count.
+//
+// Every object in the hierarchy is placed by its `loc` and `rot`, and smoothed on
+// its own. Each surface is colored by its material; two-sided surfaces also get
+// a back face, since the renderer culls back faces. Lines are skipped.
+//
+// Optionally reports the largest crease angle of any object, in degrees, for
+// smoothing the model's coarser levels of detail to match.
+//
+// Returns false (and reports the problem) if the file can't be read.
+bool readAc3dFile(char const* ac_path, std::vector<GLfloat>* const soup, float* const crease_degrees = nullptr);
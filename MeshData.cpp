@@ -0,0 +1,186 @@
+#include "MeshData.h"
+#include "MeshOptimize.h"
+#include "MeshSimplify.h"
+#include "MeshTri.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <glm/vec3.hpp>
+
+// Meshes with no more triangles than this are not simplified any further.
+static size_t const LOD_MIN_TRIANGLES = 32;
+
+bool loadTriMeshData(char const* tri_path, MeshData* const data, MeshReport* const report) {
+  // get our file and parse it into our vector of GLfloats
+  std::vector<GLfloat> tri_vector;
+  if (!readTriFile(tri_path, &tri_vector)) {
+    return false;
+  }
+
+  buildMeshData(tri_vector, data, report);
+  return true;
+}
+
+void buildMeshData(std::vector<GLfloat> const& soup, MeshData* const data, MeshReport* const report, float crease_degrees) {
+  size_t const vertex_floats = MESH_SOURCE_VERTEX_FLOATS;
+
+  data->primitiveType = GL_TRIANGLES;
+  data->vertices.clear();
+  data->indices.clear();
+  data->lods.clear();
+  if (report) {
+    report->lods.clear();
+  }
+
+  // Find the sphere bounding the mesh.
+  data->boundingRadius = 0.0f;
+  for (size_t i = 0; i + vertex_floats <= soup.size(); i += vertex_floats) {
+    data->boundingRadius = std::max(data->boundingRadius, glm::length(glm::vec3{soup[i], soup[i+1], soup[i+2]}));
+  }
+
+  // Simplify the model into a chain of coarser levels of detail, each with about
+  // half the triangles of the last, and index each level into the shared vertex list.
+  std::vector<GLfloat> vertices;
+  std::vector<GLfloat> level{soup};
+  std::vector<GLfloat> level_vertices;
+  std::vector<GLuint> level_indices;
+  while (true) {
+    // Share identical vertices, then order the triangles and vertices for the GPU's caches.
+    weldVertices(level, &level_vertices, &level_indices);
+    float const welded_acmr = computeAcmr(level_indices.data(), level_indices.size());
+    optimizeVertexCache(level_indices.data(), level_indices.size(), level_vertices.size() / vertex_floats);
+    optimizeVertexFetch(&level_vertices, level_indices.data(), level_indices.size());
+
+    if (report) {
+      report->lods.push_back(MeshLodReport{
+        level_indices.size() / 3,
+        level.size() / vertex_floats,
+        level_vertices.size() / vertex_floats,
+        welded_acmr,
+        computeAcmr(level_indices.data(), level_indices.size()),
+      });
+    }
+
+    GLuint const base_vertex = (GLuint)(vertices.size() / vertex_floats);
+    data->lods.push_back(MeshLod{(GLint)data->indices.size(), (GLsizei)level_indices.size()});
+    vertices.insert(vertices.end(), level_vertices.begin(), level_vertices.end());
+    for (GLuint index : level_indices) {
+      data->indices.push_back(base_vertex + index);
+    }
+
+    size_t const triangles = level.size() / (3*vertex_floats);
+    if (data->lods.size() >= (size_t)MESH_MAX_LODS || triangles <= LOD_MIN_TRIANGLES) {
+      break;
+    }
+
+    // Stop once the simplifier can't make meaningful progress.
+    std::vector<GLfloat> simpler = simplifyMesh(level, triangles / 2, crease_degrees);
+    if (simpler.empty() || 4*simpler.size() > 3*level.size()) {
+      break;
+    }
+    level.swap(simpler);
+  }
+
+  // Find the box bounding every level of detail, which the packed positions span.
+  data->boundsMin = glm::vec3{0.0f};
+  data->boundsMax = glm::vec3{0.0f};
+  for (size_t i = 0; i + vertex_floats <= vertices.size(); i += vertex_floats) {
+    glm::vec3 const position{vertices[i], vertices[i+1], vertices[i+2]};
+    data->boundsMin = (i == 0) ? position : glm::min(data->boundsMin, position);
+    data->boundsMax = (i == 0) ? position : glm::max(data->boundsMax, position);
+  }
+  data->positionOffset = 0.5f * (data->boundsMin + data->boundsMax);
+  data->positionScale = glm::max(0.5f * (data->boundsMax - data->boundsMin), glm::vec3{1e-6f});
+
+  // Pack the vertices for the GPU.
+  data->vertices.resize(vertices.size() / vertex_floats);
+  for (size_t i = 0; i < data->vertices.size(); ++i) {
+    data->vertices[i] = packVertex(&vertices[i * vertex_floats], data->positionOffset, data->positionScale);
+  }
+
+  if (report) {
+    report->sourceVertexBytes = sizeof(GLfloat) * vertices.size();
+    report->packedVertexBytes = sizeof(PackedVertex) * data->vertices.size();
+
+    // Measure how far packing moved each attribute.
+    report->maxPositionError = 0.0f;
+    report->maxNormalError = 0.0f;
+    report->maxColorError = 0.0f;
+    for (size_t i = 0; i < data->vertices.size(); ++i) {
+      GLfloat const* const before = &vertices[i * vertex_floats];
+      GLfloat after[MESH_SOURCE_VERTEX_FLOATS];
+      unpackVertex(data->vertices[i], data->positionOffset, data->positionScale, after);
+
+      glm::vec3 const position_before{before[0], before[1], before[2]};
+      glm::vec3 const position_after{after[0], after[1], after[2]};
+      report->maxPositionError = std::max(report->maxPositionError, glm::length(position_after - position_before));
+
+      glm::vec3 const normal_before{before[3], before[4], before[5]};
+      glm::vec3 const normal_after{after[3], after[4], after[5]};
+      float const cosine = glm::dot(glm::normalize(normal_before), glm::normalize(normal_after));
+      float const angle = std::acos(std::min(std::max(cosine, -1.0f), 1.0f)) * 180.0f / 3.14159265f;
+      report->maxNormalError = std::max(report->maxNormalError, angle);
+
+      for (int channel = 6; channel < 10; ++channel) {
+        report->maxColorError = std::max(report->maxColorError, std::fabs(after[channel] - before[channel]));
+      }
+    }
+  }
+}
+
+// Quantizes a value in [-1, 1] onto a signed integer of the given number of bits.
+static int QuantizeSnorm(float value, int bits) {
+  float const max = (float)((1 << (bits - 1)) - 1);
+  return (int)std::floor(std::min(std::max(value, -1.0f), 1.0f) * max + 0.5f);
+}
+
+// Expands a signed integer of the given number of bits back onto [-1, 1].
+static float ExpandSnorm(int value, int bits) {
+  float const max = (float)((1 << (bits - 1)) - 1);
+  return std::max(value / max, -1.0f);
+}
+
+PackedVertex packVertex(GLfloat const* vertex, glm::vec3 const& positionOffset, glm::vec3 const& positionScale) {
+  PackedVertex packed;
+
+  for (int axis = 0; axis < 3; ++axis) {
+    packed.position[axis] = (GLshort)QuantizeSnorm((vertex[axis] - positionOffset[axis]) / positionScale[axis], 16);
+  }
+  packed.position[3] = 0;
+
+  // 10 bits each of x, y and z, from the least significant bit up.
+  glm::vec3 normal{vertex[3], vertex[4], vertex[5]};
+  if (glm::length(normal) > 0.0f) {
+    normal = glm::normalize(normal);
+  }
+  packed.normal =
+      ((GLuint)QuantizeSnorm(normal.x, 10) & 0x3FF)
+    | ((GLuint)QuantizeSnorm(normal.y, 10) & 0x3FF) << 10
+    | ((GLuint)QuantizeSnorm(normal.z, 10) & 0x3FF) << 20;
+
+  for (int channel = 0; channel < 4; ++channel) {
+    float const value = std::min(std::max(vertex[6 + channel], 0.0f), 1.0f);
+    packed.color[channel] = (GLubyte)std::floor(value * 255.0f + 0.5f);
+  }
+
+  return packed;
+}
+
+void unpackVertex(PackedVertex const& vertex, glm::vec3 const& positionOffset, glm::vec3 const& positionScale, GLfloat* const out) {
+  for (int axis = 0; axis < 3; ++axis) {
+    out[axis] = positionOffset[axis] + positionScale[axis] * ExpandSnorm(vertex.position[axis], 16);
+  }
+
+  for (int axis = 0; axis < 3; ++axis) {
+    // Sign-extend each 10-bit field.
+    int field = (int)((vertex.normal >> (10 * axis)) & 0x3FF);
+    if (field & 0x200) {
+      field -= 0x400;
+    }
+    out[3 + axis] = ExpandSnorm(field, 10);
+  }
+
+  for (int channel = 0; channel < 4; ++channel) {
+    out[6 + channel] = vertex.color[channel] / 255.0f;
+  }
+}
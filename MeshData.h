@@ -0,0 +1,90 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/vec3.hpp>
+#include <vector>
+
+// Meshes are built, simplified, and optimized with vertices in a working layout
+// of 10 floats: a vec3 position, a vec3 normal, and a vec4 color.
+static size_t const MESH_SOURCE_VERTEX_FLOATS = 10;
+
+// A vertex as stored in a mesh's vertex buffer. Every attribute is normalized by
+// the GPU as it is fetched.
+//   position - xyz as shorts spanning the mesh's bounding box (w is padding)
+//   normal   - xyz as a GL_INT_2_10_10_10_REV (w is unused)
+//   color    - RGBA as unsigned bytes
+struct PackedVertex {
+  GLshort position[4];
+  GLuint normal;
+  GLubyte color[4];
+};
+
+// The size of one vertex in a mesh's vertex buffer.
+static GLsizei const MESH_VERTEX_STRIDE = sizeof(PackedVertex);
+
+// The most levels of detail generated for a mesh, including the original.
+static int const MESH_MAX_LODS = 5;
+
+// A range of a mesh's index buffer holding one level of detail.
+struct MeshLod {
+  GLint first;  // The first index of the range
+  GLsizei count;  // The number of indices in the range
+};
+
+// Statistics about one level of detail, as built by buildMeshData.
+struct MeshLodReport {
+  size_t triangles;
+  size_t soupVertices;  // Vertices before welding (three per triangle)
+  size_t vertices;  // Vertices after welding
+  float weldedAcmr;  // Vertex cache miss ratio after welding, in the original triangle order
+  float optimizedAcmr;  // Vertex cache miss ratio after reordering triangles
+};
+
+// Statistics about a mesh, as built by buildMeshData.
+struct MeshReport {
+  std::vector<MeshLodReport> lods;
+
+  size_t sourceVertexBytes;  // Size of the vertices in the working layout
+  size_t packedVertexBytes;  // Size of the vertices as packed for the GPU
+
+  // The largest differences between the working and packed vertices, as the GPU decodes them
+  float maxPositionError;  // In model units
+  float maxNormalError;  // In degrees
+  float maxColorError;  // In units of a full color channel
+};
+
+// The CPU-side contents of a mesh: interleaved vertices in the mesh layout and
+// indices into them for every level of detail, along with the metadata needed
+// to draw them.
+struct MeshData {
+  GLenum primitiveType = GL_TRIANGLES;
+  std::vector<PackedVertex> vertices;
+  std::vector<GLuint> indices;
+  std::vector<MeshLod> lods;  // Index ranges of each level of detail, from full detail down
+
+  float boundingRadius = 0.0f;  // The radius of a sphere about the origin bounding the mesh
+  glm::vec3 boundsMin{0.0f};  // The box bounding every level of detail of the mesh
+  glm::vec3 boundsMax{0.0f};
+
+  // Packed positions decode to positionOffset + positionScale * (normalized position).
+  glm::vec3 positionOffset{0.0f};
+  glm::vec3 positionScale{1.0f};
+};
+
+// Parses a .TRI file from the filesystem, then builds it as by buildMeshData.
+// Returns false if the file couldn't be read.
+bool loadTriMeshData(char const* tri_path, MeshData* const data, MeshReport* const report = nullptr);
+
+// Builds a mesh from a triangle soup in the working vertex layout: generates its
+// levels of detail, welds identical vertices, orders each level for the vertex
+// caches, and packs the vertices. Optionally reports statistics about the result.
+// Coarser levels are flat shaded, unless `crease_degrees` is positive; then they
+// are smooth shaded up to that crease angle (see simplifyMesh).
+void buildMeshData(std::vector<GLfloat> const& soup, MeshData* const data, MeshReport* const report = nullptr, float crease_degrees = 0.0f);
+
+// Packs a vertex in the working layout, mapping its position from the given
+// offset and scale onto [-1, 1].
+PackedVertex packVertex(GLfloat const* vertex, glm::vec3 const& positionOffset, glm::vec3 const& positionScale);
+
+// Unpacks a vertex into the working layout, as the GPU would decode it.
+void unpackVertex(PackedVertex const& vertex, glm::vec3 const& positionOffset, glm::vec3 const& positionScale, GLfloat* const out);
@@ -0,0 +1,213 @@
+#include "MeshFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Vertex and index data start on a boundary of this many bytes.
+static uint32_t const DATA_ALIGNMENT = 16;
+
+static uint32_t Align(uint32_t offset) {
+  return (offset + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+}
+
+bool writeMeshFile(char const* mesh_path, MeshData const& data) {
+  if (data.lods.size() > (size_t)MESH_MAX_LODS) {
+    fprintf(stderr, "'%s': too many levels of detail (%u).\n", mesh_path, (unsigned)data.lods.size());
+    return false;
+  }
+
+  MeshFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MESH_FILE_MAGIC, sizeof(header.magic));
+  header.version = MESH_FILE_VERSION;
+  header.primitive_type = data.primitiveType;
+
+  header.vertex_stride = MESH_VERTEX_STRIDE;
+  header.vertex_count = (uint32_t)data.vertices.size();
+  header.vertex_bytes = header.vertex_count * MESH_VERTEX_STRIDE;
+  header.vertex_offset = Align(sizeof(header));
+
+  header.index_count = (uint32_t)data.indices.size();
+  header.index_offset = Align(header.vertex_offset + header.vertex_bytes);
+
+  header.lod_count = (uint32_t)data.lods.size();
+  for (size_t i = 0; i < data.lods.size(); ++i) {
+    header.lods[i] = MeshFileLod{(uint32_t)data.lods[i].first, (uint32_t)data.lods[i].count};
+  }
+
+  header.bounding_radius = data.boundingRadius;
+  for (int axis = 0; axis < 3; ++axis) {
+    header.bounds_min[axis] = data.boundsMin[axis];
+    header.bounds_max[axis] = data.boundsMax[axis];
+    header.position_offset[axis] = data.positionOffset[axis];
+    header.position_scale[axis] = data.positionScale[axis];
+  }
+
+  // Write to a temporary file first, so that no reader ever maps a partial file.
+  std::string const temp_path = std::string{mesh_path} + ".tmp";
+  FILE* f = fopen(temp_path.c_str(), "wb");
+  if (!f) {
+    fprintf(stderr, "Unable to open file '%s'.\n", temp_path.c_str());
+    return false;
+  }
+
+  static char const padding[DATA_ALIGNMENT] = {};
+  size_t const vertex_padding = header.vertex_offset - sizeof(header);
+  size_t const index_padding = header.index_offset - (header.vertex_offset + header.vertex_bytes);
+  size_t const index_bytes = sizeof(GLuint) * header.index_count;
+  bool const written =
+       fwrite(&header, sizeof(header), 1, f) == 1
+    && fwrite(padding, 1, vertex_padding, f) == vertex_padding
+    && fwrite(data.vertices.data(), 1, header.vertex_bytes, f) == header.vertex_bytes
+    && fwrite(padding, 1, index_padding, f) == index_padding
+    && fwrite(data.indices.data(), 1, index_bytes, f) == index_bytes;
+
+  if (fclose(f) != 0 || !written) {
+    fprintf(stderr, "Unable to write file '%s'.\n", temp_path.c_str());
+    remove(temp_path.c_str());
+    return false;
+  }
+
+  if (rename(temp_path.c_str(), mesh_path) != 0) {
+    fprintf(stderr, "Unable to replace file '%s'.\n", mesh_path);
+    remove(temp_path.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+MappedMeshFile::~MappedMeshFile() {
+  Close();
+}
+
+void MappedMeshFile::Close() {
+  if (this->mapping) {
+    munmap(this->mapping, this->size);
+  }
+  this->mapping = nullptr;
+  this->size = 0;
+}
+
+bool MappedMeshFile::Open(char const* mesh_path) {
+  Close();
+
+  int const fd = open(mesh_path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Unable to open file '%s'.\n", mesh_path);
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(MeshFileHeader)) {
+    fprintf(stderr, "'%s' is not a mesh file.\n", mesh_path);
+    close(fd);
+    return false;
+  }
+
+  // The mapping keeps the file alive after the descriptor is closed.
+  void* const mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "Unable to map file '%s'.\n", mesh_path);
+    return false;
+  }
+  this->mapping = mapping;
+  this->size = (size_t)info.st_size;
+
+  // Make sure the header describes data that actually fits in the file.
+  MeshFileHeader const& header = GetHeader();
+  char const* problem = nullptr;
+  if (memcmp(header.magic, MESH_FILE_MAGIC, sizeof(header.magic)) != 0) {
+    problem = "is not a mesh file";
+  } else if (header.version != MESH_FILE_VERSION) {
+    problem = "has an unsupported version";
+  } else if (header.vertex_stride != (uint32_t)MESH_VERTEX_STRIDE) {
+    problem = "has an unsupported vertex layout";
+  } else if (header.vertex_bytes != header.vertex_count * header.vertex_stride
+          || header.vertex_offset < sizeof(MeshFileHeader)
+          || (uint64_t)header.vertex_offset + header.vertex_bytes > this->size
+          || header.index_offset % sizeof(GLuint) != 0
+          || header.index_offset < (uint64_t)header.vertex_offset + header.vertex_bytes
+          || header.index_offset + (uint64_t)sizeof(GLuint) * header.index_count > this->size) {
+    problem = "is truncated";
+  } else if (header.lod_count < 1 || header.lod_count > (uint32_t)MESH_MAX_LODS) {
+    problem = "has a bad level of detail count";
+  } else {
+    // Every index must land on a vertex.
+    GLuint const* const indices = GetIndices();
+    for (uint32_t i = 0; i < header.index_count && !problem; ++i) {
+      if (indices[i] >= header.vertex_count) {
+        problem = "has an out-of-range index";
+      }
+    }
+
+    for (uint32_t i = 0; i < header.lod_count; ++i) {
+      if ((uint64_t)header.lods[i].first + header.lods[i].count > header.index_count) {
+        problem = "has a bad level of detail range";
+      }
+    }
+  }
+
+  if (problem) {
+    fprintf(stderr, "'%s' %s.\n", mesh_path, problem);
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+MeshFileHeader const& MappedMeshFile::GetHeader() const {
+  return *static_cast<MeshFileHeader const*>(this->mapping);
+}
+
+void const* MappedMeshFile::GetVertices() const {
+  return static_cast<char const*>(this->mapping) + GetHeader().vertex_offset;
+}
+
+GLuint const* MappedMeshFile::GetIndices() const {
+  return reinterpret_cast<GLuint const*>(static_cast<char const*>(this->mapping) + GetHeader().index_offset);
+}
+
+std::vector<MeshLod> MappedMeshFile::GetLods() const {
+  MeshFileHeader const& header = GetHeader();
+
+  std::vector<MeshLod> lods;
+  for (uint32_t i = 0; i < header.lod_count; ++i) {
+    lods.push_back(MeshLod{(GLint)header.lods[i].first, (GLsizei)header.lods[i].count});
+  }
+  return lods;
+}
+
+std::string getMeshFilePath(char const* source_path) {
+  std::string path{source_path};
+
+  // Swap the extension (if any) for ".mesh".
+  size_t const dot = path.find_last_of('.');
+  size_t const slash = path.find_last_of('/');
+  if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+    path.erase(dot);
+  }
+
+  return path + ".mesh";
+}
+
+bool isMeshFileCurrent(char const* mesh_path, char const* source_path) {
+  struct stat mesh_info;
+  if (stat(mesh_path, &mesh_info) != 0) {
+    return false;
+  }
+
+  // Without the source, the converted file is all we have.
+  struct stat source_info;
+  if (stat(source_path, &source_info) != 0) {
+    return true;
+  }
+
+  return mesh_info.st_mtime >= source_info.st_mtime;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "MeshData.h"
+
+#include <cstdint>
+#include <string>
+
+// A .mesh file holds a converted model, ready to hand straight to glBufferData.
+//
+// The file is a MeshFileHeader followed (at `vertex_offset`) by the interleaved
+// vertex data of every level of detail, exactly as it is laid out on the GPU,
+// then (at `index_offset`) by the 32-bit indices of every level of detail.
+// Values are stored in the byte order of the machine which converted the file;
+// a file from a machine of the other byte order fails the version check.
+//
+// Files are opened with a shared read-only mmap, so every running instance
+// reads the same pages of the page cache, and nothing is parsed or copied.
+static char const MESH_FILE_MAGIC[8] = {'C', '4', '6', '5', 'M', 'S', 'H', '\0'};
+static uint32_t const MESH_FILE_VERSION = 3;
+
+struct MeshFileLod {
+  uint32_t first;  // The first index of the level of detail
+  uint32_t count;  // The number of indices in the level of detail
+};
+
+struct MeshFileHeader {
+  char magic[8];  // MESH_FILE_MAGIC
+  uint32_t version;  // MESH_FILE_VERSION
+  uint32_t primitive_type;  // The GL primitive type of the mesh
+
+  uint32_t vertex_stride;  // Bytes per vertex; must equal MESH_VERTEX_STRIDE
+  uint32_t vertex_count;  // Vertices across all levels of detail
+  uint32_t vertex_offset;  // Byte offset of the vertex data from the start of the file
+  uint32_t vertex_bytes;  // Size of the vertex data
+
+  uint32_t index_count;  // Indices across all levels of detail
+  uint32_t index_offset;  // Byte offset of the index data from the start of the file
+
+  uint32_t lod_count;
+  MeshFileLod lods[MESH_MAX_LODS];
+
+  float bounding_radius;  // The radius of a sphere about the origin bounding the mesh
+  float bounds_min[3];  // The box bounding the mesh
+  float bounds_max[3];
+
+  float position_offset[3];  // Packed positions decode to offset + scale * (normalized position)
+  float position_scale[3];
+};
+
+// Writes mesh data to a .mesh file, replacing it atomically.
+// Returns false if the file couldn't be written.
+bool writeMeshFile(char const* mesh_path, MeshData const& data);
+
+// A read-only view of a memory-mapped .mesh file.
+class MappedMeshFile {
+private:
+  void* mapping = nullptr;
+  size_t size = 0;
+
+public:
+  MappedMeshFile() {}
+  ~MappedMeshFile();
+
+  MappedMeshFile(MappedMeshFile const&) = delete;
+  MappedMeshFile& operator=(MappedMeshFile const&) = delete;
+
+  // Maps the given file, and checks that it is a well-formed .mesh file.
+  // Returns false (and reports the problem) if it isn't.
+  bool Open(char const* mesh_path);
+
+  MeshFileHeader const& GetHeader() const;
+  void const* GetVertices() const;
+  GLuint const* GetIndices() const;
+  std::vector<MeshLod> GetLods() const;
+
+private:
+  void Close();
+};
+
+// The path of the .mesh conversion of a model: "models/ship.tri" -> "models/ship.mesh".
+std::string getMeshFilePath(char const* source_path);
+
+// Whether the .mesh file exists and is no older than the model it was converted from.
+bool isMeshFileCurrent(char const* mesh_path, char const* source_path);
@@ -0,0 +1,240 @@
+#include "MeshOptimize.h"
+#include "MeshData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Floats per vertex in the working layout
+static size_t const VERTEX_FLOATS = MESH_SOURCE_VERTEX_FLOATS;
+
+// Parameters of Forsyth's scoring function
+static int const FORSYTH_CACHE_SIZE = 32;
+static float const FORSYTH_CACHE_DECAY_POWER = 1.5f;
+static float const FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static float const FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+static float const FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+static uint32_t HashVertex(GLfloat const* vertex) {
+  // FNV-1a over the vertex's bytes
+  unsigned char const* bytes = reinterpret_cast<unsigned char const*>(vertex);
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < VERTEX_FLOATS * sizeof(GLfloat); ++i) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+void weldVertices(std::vector<GLfloat> const& soup, std::vector<GLfloat>* const vertices, std::vector<GLuint>* const indices) {
+  size_t const soup_count = soup.size() / VERTEX_FLOATS;
+
+  vertices->clear();
+  indices->clear();
+  indices->reserve(soup_count);
+
+  // Open-addressed hash table of unique vertex indices, kept at most half full.
+  size_t table_size = 1;
+  while (table_size < 2*soup_count) {
+    table_size *= 2;
+  }
+  GLuint const EMPTY = ~(GLuint)0;
+  std::vector<GLuint> table(table_size, EMPTY);
+
+  for (size_t i = 0; i < soup_count; ++i) {
+    GLfloat const* vertex = &soup[i * VERTEX_FLOATS];
+
+    size_t slot = HashVertex(vertex) & (table_size - 1);
+    while (table[slot] != EMPTY && memcmp(&(*vertices)[table[slot] * VERTEX_FLOATS], vertex, VERTEX_FLOATS * sizeof(GLfloat)) != 0) {
+      slot = (slot + 1) & (table_size - 1);
+    }
+
+    if (table[slot] == EMPTY) {
+      table[slot] = (GLuint)(vertices->size() / VERTEX_FLOATS);
+      vertices->insert(vertices->end(), vertex, vertex + VERTEX_FLOATS);
+    }
+    indices->push_back(table[slot]);
+  }
+}
+
+// How much a vertex is worth emitting now, given its cache position (-1 if not
+// cached) and the number of triangles still waiting to use it.
+static float ScoreVertex(int cache_position, int remaining_triangles) {
+  if (remaining_triangles == 0) {
+    return -1.0f;  // Nothing left to draw with it
+  }
+
+  float score = 0.0f;
+  if (cache_position < 0) {
+    // Not in the cache
+  } else if (cache_position < 3) {
+    // Used by the last triangle. Reusing it right away is good, but not as good
+    // as it looks, since the triangle would be drawn in the same direction.
+    score = FORSYTH_LAST_TRIANGLE_SCORE;
+  } else {
+    float const scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+    score = std::pow(1.0f - (cache_position - 3) * scale, FORSYTH_CACHE_DECAY_POWER);
+  }
+
+  // Favor vertices with few triangles left, to finish them off and stop them coming back later.
+  score += FORSYTH_VALENCE_BOOST_SCALE * std::pow((float)remaining_triangles, -FORSYTH_VALENCE_BOOST_POWER);
+  return score;
+}
+
+void optimizeVertexCache(GLuint* const indices, size_t index_count, size_t vertex_count) {
+  size_t const triangle_count = index_count / 3;
+  if (triangle_count == 0) {
+    return;
+  }
+
+  // Each vertex's list of triangles that still need it, packed into one array.
+  std::vector<int> remaining(vertex_count, 0);
+  for (size_t i = 0; i < 3*triangle_count; ++i) {
+    remaining[indices[i]] += 1;
+  }
+
+  std::vector<size_t> adjacency_offsets(vertex_count + 1, 0);
+  for (size_t v = 0; v < vertex_count; ++v) {
+    adjacency_offsets[v + 1] = adjacency_offsets[v] + remaining[v];
+  }
+  std::vector<GLuint> adjacency(adjacency_offsets[vertex_count]);
+  {
+    std::vector<size_t> fill{adjacency_offsets.begin(), adjacency_offsets.end() - 1};
+    for (size_t t = 0; t < triangle_count; ++t) {
+      for (int corner = 0; corner < 3; ++corner) {
+        adjacency[fill[indices[3*t + corner]]++] = (GLuint)t;
+      }
+    }
+  }
+
+  std::vector<int> cache_positions(vertex_count, -1);
+  std::vector<float> vertex_scores(vertex_count);
+  for (size_t v = 0; v < vertex_count; ++v) {
+    vertex_scores[v] = ScoreVertex(-1, remaining[v]);
+  }
+
+  std::vector<float> triangle_scores(triangle_count);
+  std::vector<bool> emitted(triangle_count, false);
+  for (size_t t = 0; t < triangle_count; ++t) {
+    triangle_scores[t] = vertex_scores[indices[3*t]] + vertex_scores[indices[3*t + 1]] + vertex_scores[indices[3*t + 2]];
+  }
+
+  std::vector<GLuint> output;
+  output.reserve(3*triangle_count);
+
+  // The cache holds up to three extra entries while a triangle is being added.
+  std::vector<GLuint> cache, next_cache;
+  cache.reserve(FORSYTH_CACHE_SIZE + 3);
+  next_cache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+  size_t scan_cursor = 0;  // Every triangle before this has been emitted
+  long best = -1;
+  while (output.size() < 3*triangle_count) {
+    // If nothing in the cache leads anywhere, fall back to the best remaining triangle.
+    if (best < 0) {
+      while (emitted[scan_cursor]) {
+        ++scan_cursor;
+      }
+      best = (long)scan_cursor;
+      for (size_t t = scan_cursor; t < triangle_count; ++t) {
+        if (!emitted[t] && triangle_scores[t] > triangle_scores[best]) {
+          best = (long)t;
+        }
+      }
+    }
+
+    // Emit the triangle.
+    GLuint const* const triangle = &indices[3*best];
+    output.insert(output.end(), triangle, triangle + 3);
+    emitted[best] = true;
+
+    // Retire it from its vertices' lists.
+    for (int corner = 0; corner < 3; ++corner) {
+      GLuint const v = triangle[corner];
+      GLuint* const begin = &adjacency[adjacency_offsets[v]];
+      GLuint* const end = begin + remaining[v];
+      *std::find(begin, end, (GLuint)best) = *(end - 1);
+      remaining[v] -= 1;
+    }
+
+    // Move its vertices to the front of the cache.
+    next_cache.assign(triangle, triangle + 3);
+    for (GLuint v : cache) {
+      if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+        next_cache.push_back(v);
+      }
+    }
+    cache.swap(next_cache);
+
+    // Rescore the cached vertices, and every triangle still waiting on them.
+    for (size_t i = 0; i < cache.size(); ++i) {
+      GLuint const v = cache[i];
+      int const position = (i < (size_t)FORSYTH_CACHE_SIZE) ? (int)i : -1;
+      cache_positions[v] = position;
+
+      float const score = ScoreVertex(position, remaining[v]);
+      float const delta = score - vertex_scores[v];
+      vertex_scores[v] = score;
+      for (int j = 0; j < remaining[v]; ++j) {
+        triangle_scores[adjacency[adjacency_offsets[v] + j]] += delta;
+      }
+    }
+    if (cache.size() > (size_t)FORSYTH_CACHE_SIZE) {
+      cache.resize(FORSYTH_CACHE_SIZE);
+    }
+
+    // The next triangle is the best one touching the cache.
+    best = -1;
+    for (GLuint v : cache) {
+      for (int j = 0; j < remaining[v]; ++j) {
+        GLuint const t = adjacency[adjacency_offsets[v] + j];
+        if (best < 0 || triangle_scores[t] > triangle_scores[best]) {
+          best = (long)t;
+        }
+      }
+    }
+  }
+
+  std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeVertexFetch(std::vector<GLfloat>* const vertices, GLuint* const indices, size_t index_count) {
+  size_t const vertex_count = vertices->size() / VERTEX_FLOATS;
+  GLuint const UNUSED = ~(GLuint)0;
+  std::vector<GLuint> remap(vertex_count, UNUSED);
+
+  std::vector<GLfloat> reordered;
+  reordered.reserve(vertices->size());
+  for (size_t i = 0; i < index_count; ++i) {
+    GLuint& index = indices[i];
+    if (remap[index] == UNUSED) {
+      remap[index] = (GLuint)(reordered.size() / VERTEX_FLOATS);
+      GLfloat const* vertex = &(*vertices)[index * VERTEX_FLOATS];
+      reordered.insert(reordered.end(), vertex, vertex + VERTEX_FLOATS);
+    }
+    index = remap[index];
+  }
+
+  vertices->swap(reordered);
+}
+
+float computeAcmr(GLuint const* const indices, size_t index_count) {
+  if (index_count < 3) {
+    return 0.0f;
+  }
+
+  GLuint const max_index = *std::max_element(indices, indices + index_count);
+
+  // A vertex is cached if it missed within the last MESH_ACMR_CACHE_SIZE misses.
+  std::vector<size_t> miss_times(max_index + 1, 0);
+  size_t misses = 0;
+  for (size_t i = 0; i < index_count; ++i) {
+    size_t& time = miss_times[indices[i]];
+    if (time == 0 || misses - time >= MESH_ACMR_CACHE_SIZE) {
+      misses += 1;
+      time = misses;
+    }
+  }
+
+  return (float)misses / (index_count / 3);
+}
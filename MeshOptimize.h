@@ -0,0 +1,25 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+// The size of the FIFO vertex cache simulated when measuring ACMR.
+static size_t const MESH_ACMR_CACHE_SIZE = 16;
+
+// Merges bit-identical vertices of a triangle soup in the working vertex layout
+// (see MESH_SOURCE_VERTEX_FLOATS), producing unique vertices and an index list.
+void weldVertices(std::vector<GLfloat> const& soup, std::vector<GLfloat>* const vertices, std::vector<GLuint>* const indices);
+
+// Reorders triangles for post-transform vertex cache locality, after Tom Forsyth's
+// "Linear-Speed Vertex Cache Optimisation". Indices must be below `vertex_count`.
+void optimizeVertexCache(GLuint* const indices, size_t index_count, size_t vertex_count);
+
+// Reorders vertices into the order in which the indices first use them, so that
+// vertex fetch walks memory forwards. Unused vertices are dropped.
+void optimizeVertexFetch(std::vector<GLfloat>* const vertices, GLuint* const indices, size_t index_count);
+
+// The average cache miss ratio: vertex shader invocations per triangle when drawn
+// through a FIFO post-transform cache of MESH_ACMR_CACHE_SIZE entries. Lower is better;
+// unindexed triangles always score 3.
+float computeAcmr(GLuint const* const indices, size_t index_count);
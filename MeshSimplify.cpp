@@ -0,0 +1,398 @@
+#include "MeshSimplify.h"
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <queue>
+#include <unordered_map>
+
+// Floats per vertex: position (3), normal (3), color (4)
+static size_t const VERTEX_FLOATS = 10;
+
+// Weight of the planes holding open borders in place, relative to surface planes.
+static double const BOUNDARY_WEIGHT = 1000.0;
+
+// Collapses which would turn a triangle's normal by more than this (as a cosine) are rejected.
+static float const MIN_NORMAL_COSINE = 0.2f;
+
+// A symmetric 4x4 error quadric. Evaluating it at a point gives the sum of
+// squared distances from that point to the planes it was built from.
+struct Quadric {
+  double a2 = 0, ab = 0, ac = 0, ad = 0;
+  double b2 = 0, bc = 0, bd = 0;
+  double c2 = 0, cd = 0;
+  double d2 = 0;
+
+  Quadric() {}
+
+  // The quadric of the plane ax + by + cz + d = 0, for a unit normal (a, b, c).
+  Quadric(glm::vec3 const& normal, double d, double weight) {
+    double const a = normal.x, b = normal.y, c = normal.z;
+    this->a2 = weight*a*a; this->ab = weight*a*b; this->ac = weight*a*c; this->ad = weight*a*d;
+    this->b2 = weight*b*b; this->bc = weight*b*c; this->bd = weight*b*d;
+    this->c2 = weight*c*c; this->cd = weight*c*d;
+    this->d2 = weight*d*d;
+  }
+
+  Quadric& operator+=(Quadric const& o) {
+    this->a2 += o.a2; this->ab += o.ab; this->ac += o.ac; this->ad += o.ad;
+    this->b2 += o.b2; this->bc += o.bc; this->bd += o.bd;
+    this->c2 += o.c2; this->cd += o.cd;
+    this->d2 += o.d2;
+    return *this;
+  }
+
+  double Evaluate(glm::vec3 const& p) const {
+    double const x = p.x, y = p.y, z = p.z;
+    return a2*x*x + 2*ab*x*y + 2*ac*x*z + 2*ad*x
+         + b2*y*y + 2*bc*y*z + 2*bd*y
+         + c2*z*z + 2*cd*z
+         + d2;
+  }
+
+  // Finds the point of least error, if the quadric is well-conditioned.
+  bool Minimize(glm::vec3* const p) const {
+    // Solve the 3x3 system by Cramer's rule.
+    double const det =
+        a2*(b2*c2 - bc*bc)
+      - ab*(ab*c2 - bc*ac)
+      + ac*(ab*bc - b2*ac);
+    double const scale = a2 + b2 + c2;
+    if (std::fabs(det) <= 1e-9 * scale*scale*scale) {
+      return false;
+    }
+
+    double const x = -(ad*(b2*c2 - bc*bc) - ab*(bd*c2 - bc*cd) + ac*(bd*bc - b2*cd)) / det;
+    double const y = -(a2*(bd*c2 - cd*bc) - ad*(ab*c2 - bc*ac) + ac*(ab*cd - bd*ac)) / det;
+    double const z = -(a2*(b2*cd - bc*bd) - ab*(ab*cd - bd*ac) + ad*(ab*bc - b2*ac)) / det;
+    *p = glm::vec3{(float)x, (float)y, (float)z};
+    return true;
+  }
+};
+
+struct SimplifyVertex {
+  glm::vec3 position;
+  Quadric quadric;
+  std::vector<uint32_t> faces;  // Faces using this vertex; may include removed ones
+  uint32_t version = 0;  // Bumped whenever the vertex moves, to invalidate stale candidates
+  bool removed = false;
+};
+
+struct SimplifyFace {
+  uint32_t v[3];
+  glm::vec4 color;
+  bool removed = false;
+};
+
+// A candidate edge collapse, merging v1 into v0 at `target`.
+struct Collapse {
+  double cost;
+  uint32_t v0, v1;
+  uint32_t version0, version1;
+  glm::vec3 target;
+
+  bool operator>(Collapse const& o) const {
+    return this->cost > o.cost;
+  }
+};
+
+static uint64_t EdgeKey(uint32_t a, uint32_t b) {
+  return (a < b) ? ((uint64_t)a << 32 | b) : ((uint64_t)b << 32 | a);
+}
+
+static glm::vec3 FaceNormal(glm::vec3 const& p0, glm::vec3 const& p1, glm::vec3 const& p2) {
+  return glm::cross(p1 - p0, p2 - p0);
+}
+
+// Welds coincident positions, snapping them to a grid of the given cell size.
+static void WeldVertices(
+  std::vector<float> const& vertices,
+  float cell,
+  std::vector<SimplifyVertex>* const welded,
+  std::vector<SimplifyFace>* const faces
+) {
+  struct CellHash {
+    size_t operator()(glm::ivec3 const& c) const {
+      return (size_t)c.x * 73856093u ^ (size_t)c.y * 19349663u ^ (size_t)c.z * 83492791u;
+    }
+  };
+  struct CellEqual {
+    bool operator()(glm::ivec3 const& a, glm::ivec3 const& b) const {
+      return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+  };
+  std::unordered_map<glm::ivec3, uint32_t, CellHash, CellEqual> cells;
+
+  size_t const vertex_count = vertices.size() / VERTEX_FLOATS;
+  for (size_t first = 0; first + 3 <= vertex_count; first += 3) {
+    SimplifyFace face;
+    for (int corner = 0; corner < 3; ++corner) {
+      float const* vertex = &vertices[(first + corner) * VERTEX_FLOATS];
+      glm::vec3 const position{vertex[0], vertex[1], vertex[2]};
+      glm::ivec3 const key{
+        (int)std::floor(position.x / cell + 0.5f),
+        (int)std::floor(position.y / cell + 0.5f),
+        (int)std::floor(position.z / cell + 0.5f),
+      };
+
+      auto itr = cells.find(key);
+      if (itr == cells.end()) {
+        itr = cells.insert(std::make_pair(key, (uint32_t)welded->size())).first;
+        welded->push_back(SimplifyVertex{});
+        welded->back().position = position;
+      }
+      face.v[corner] = itr->second;
+    }
+    face.color = glm::vec4{vertices[first*VERTEX_FLOATS + 6], vertices[first*VERTEX_FLOATS + 7], vertices[first*VERTEX_FLOATS + 8], vertices[first*VERTEX_FLOATS + 9]};
+
+    // Skip triangles which welding has collapsed.
+    if (face.v[0] == face.v[1] || face.v[1] == face.v[2] || face.v[2] == face.v[0]) {
+      continue;
+    }
+
+    for (int corner = 0; corner < 3; ++corner) {
+      (*welded)[face.v[corner]].faces.push_back((uint32_t)faces->size());
+    }
+    faces->push_back(face);
+  }
+}
+
+// Builds the cheapest collapse of the edge (v0, v1).
+static Collapse PlanCollapse(std::vector<SimplifyVertex> const& vertices, uint32_t v0, uint32_t v1) {
+  Quadric quadric = vertices[v0].quadric;
+  quadric += vertices[v1].quadric;
+
+  glm::vec3 const p0 = vertices[v0].position;
+  glm::vec3 const p1 = vertices[v1].position;
+
+  // Prefer the optimal point, but only if it stays near the edge; fall back to
+  // the best of the endpoints and midpoint.
+  glm::vec3 target;
+  double cost;
+  if (quadric.Minimize(&target) && glm::length(target - 0.5f*(p0 + p1)) <= glm::length(p1 - p0)) {
+    cost = quadric.Evaluate(target);
+  } else {
+    glm::vec3 const options[3] = {p0, p1, 0.5f*(p0 + p1)};
+    target = options[0];
+    cost = quadric.Evaluate(options[0]);
+    for (int i = 1; i < 3; ++i) {
+      double const option_cost = quadric.Evaluate(options[i]);
+      if (option_cost < cost) {
+        cost = option_cost;
+        target = options[i];
+      }
+    }
+  }
+
+  return Collapse{std::max(cost, 0.0), v0, v1, vertices[v0].version, vertices[v1].version, target};
+}
+
+// Whether moving `moved` to `target` would fold any of its faces over.
+static bool FoldsOver(
+  std::vector<SimplifyVertex> const& vertices,
+  std::vector<SimplifyFace> const& faces,
+  uint32_t moved, uint32_t other, glm::vec3 const& target
+) {
+  for (uint32_t f : vertices[moved].faces) {
+    SimplifyFace const& face = faces[f];
+    if (face.removed) {
+      continue;
+    }
+
+    // Faces on the collapsing edge disappear, so they can't fold.
+    if (face.v[0] == other || face.v[1] == other || face.v[2] == other) {
+      continue;
+    }
+
+    glm::vec3 before[3], after[3];
+    for (int corner = 0; corner < 3; ++corner) {
+      before[corner] = vertices[face.v[corner]].position;
+      after[corner] = (face.v[corner] == moved) ? target : before[corner];
+    }
+
+    glm::vec3 const n0 = FaceNormal(before[0], before[1], before[2]);
+    glm::vec3 const n1 = FaceNormal(after[0], after[1], after[2]);
+    float const lengths = glm::length(n0) * glm::length(n1);
+    if (lengths <= 0.0f || glm::dot(n0, n1) < MIN_NORMAL_COSINE * lengths) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+std::vector<float> simplifyMesh(std::vector<float> const& soup, size_t target_triangles, float crease_degrees) {
+  // Size the welding grid relative to the mesh.
+  float extent = 0.0f;
+  for (size_t i = 0; i + VERTEX_FLOATS <= soup.size(); i += VERTEX_FLOATS) {
+    extent = std::max(extent, std::max(std::fabs(soup[i]), std::max(std::fabs(soup[i+1]), std::fabs(soup[i+2]))));
+  }
+  float const cell = std::max(extent * 1e-5f, 1e-6f);
+
+  std::vector<SimplifyVertex> vertices;
+  std::vector<SimplifyFace> faces;
+  WeldVertices(soup, cell, &vertices, &faces);
+
+  // Accumulate each face's plane, weighted by area, into its vertices' quadrics.
+  std::unordered_map<uint64_t, int> edge_faces;
+  for (SimplifyFace const& face : faces) {
+    glm::vec3 const p0 = vertices[face.v[0]].position;
+    glm::vec3 const n = FaceNormal(p0, vertices[face.v[1]].position, vertices[face.v[2]].position);
+    float const area2 = glm::length(n);
+    if (area2 <= 0.0f) {
+      continue;
+    }
+
+    glm::vec3 const unit = n / area2;
+    Quadric const plane{unit, -glm::dot(unit, p0), 0.5 * area2};
+    for (int corner = 0; corner < 3; ++corner) {
+      vertices[face.v[corner]].quadric += plane;
+      edge_faces[EdgeKey(face.v[corner], face.v[(corner + 1) % 3])] += 1;
+    }
+  }
+
+  // Hold open borders in place with planes perpendicular to their faces.
+  for (SimplifyFace const& face : faces) {
+    for (int corner = 0; corner < 3; ++corner) {
+      uint32_t const a = face.v[corner], b = face.v[(corner + 1) % 3];
+      if (edge_faces[EdgeKey(a, b)] != 1) {
+        continue;
+      }
+
+      glm::vec3 const pa = vertices[a].position;
+      glm::vec3 const pb = vertices[b].position;
+      glm::vec3 const n = FaceNormal(pa, pb, vertices[face.v[(corner + 2) % 3]].position);
+      glm::vec3 const border = glm::cross(pb - pa, n);
+      float const length = glm::length(border);
+      if (length <= 0.0f) {
+        continue;
+      }
+
+      glm::vec3 const unit = border / length;
+      float const edge_length = glm::length(pb - pa);
+      Quadric const plane{unit, -glm::dot(unit, pa), BOUNDARY_WEIGHT * edge_length * edge_length};
+      vertices[a].quadric += plane;
+      vertices[b].quadric += plane;
+    }
+  }
+
+  // Queue every edge, cheapest first.
+  std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+  for (auto const& edge : edge_faces) {
+    queue.push(PlanCollapse(vertices, (uint32_t)(edge.first >> 32), (uint32_t)(edge.first & 0xFFFFFFFFu)));
+  }
+
+  size_t live_faces = faces.size();
+  std::vector<uint32_t> neighbors;
+  while (live_faces > target_triangles && !queue.empty()) {
+    Collapse const collapse = queue.top();
+    queue.pop();
+
+    SimplifyVertex& v0 = vertices[collapse.v0];
+    SimplifyVertex& v1 = vertices[collapse.v1];
+    if (v0.removed || v1.removed || v0.version != collapse.version0 || v1.version != collapse.version1) {
+      continue;  // Stale
+    }
+
+    if (FoldsOver(vertices, faces, collapse.v0, collapse.v1, collapse.target)
+     || FoldsOver(vertices, faces, collapse.v1, collapse.v0, collapse.target)) {
+      continue;
+    }
+
+    // Merge v1 into v0.
+    v0.position = collapse.target;
+    v0.quadric += v1.quadric;
+    v0.version += 1;
+    v1.removed = true;
+
+    for (uint32_t f : v1.faces) {
+      SimplifyFace& face = faces[f];
+      if (face.removed) {
+        continue;
+      }
+
+      if (face.v[0] == collapse.v0 || face.v[1] == collapse.v0 || face.v[2] == collapse.v0) {
+        face.removed = true;
+        live_faces -= 1;
+      } else {
+        for (uint32_t& v : face.v) {
+          if (v == collapse.v1) {
+            v = collapse.v0;
+          }
+        }
+        v0.faces.push_back(f);
+      }
+    }
+    v1.faces.clear();
+
+    // Drop removed faces, and re-plan the collapses of every edge around v0.
+    neighbors.clear();
+    size_t kept = 0;
+    for (uint32_t f : v0.faces) {
+      if (faces[f].removed) {
+        continue;
+      }
+      v0.faces[kept++] = f;
+      for (uint32_t v : faces[f].v) {
+        if (v != collapse.v0 && std::find(neighbors.begin(), neighbors.end(), v) == neighbors.end()) {
+          neighbors.push_back(v);
+        }
+      }
+    }
+    v0.faces.resize(kept);
+
+    for (uint32_t neighbor : neighbors) {
+      queue.push(PlanCollapse(vertices, collapse.v0, neighbor));
+    }
+  }
+
+  // Emit the surviving faces, with flat normals or normals smoothed up to the crease angle.
+  float const crease_cosine = std::cos(crease_degrees * 3.14159265f / 180.0f);
+  std::vector<float> result;
+  result.reserve(live_faces * 3 * VERTEX_FLOATS);
+  for (SimplifyFace const& face : faces) {
+    if (face.removed) {
+      continue;
+    }
+
+    glm::vec3 const n = FaceNormal(vertices[face.v[0]].position, vertices[face.v[1]].position, vertices[face.v[2]].position);
+    if (glm::length(n) <= 0.0f) {
+      continue;
+    }
+    glm::vec3 const face_normal = glm::normalize(n);
+
+    for (uint32_t v : face.v) {
+      SimplifyVertex const& vertex = vertices[v];
+
+      // Sum the area-weighted normals of the live faces around this corner within the crease angle.
+      glm::vec3 normal = face_normal;
+      if (crease_degrees > 0.0f) {
+        glm::vec3 sum{0.0f};
+        for (uint32_t f : vertex.faces) {
+          SimplifyFace const& other = faces[f];
+          if (other.removed) {
+            continue;
+          }
+          glm::vec3 const m = FaceNormal(vertices[other.v[0]].position, vertices[other.v[1]].position, vertices[other.v[2]].position);
+          float const area2 = glm::length(m);
+          if (area2 > 0.0f && glm::dot(face_normal, m / area2) >= crease_cosine) {
+            sum += m;
+          }
+        }
+        normal = glm::normalize(sum);  // Includes this face, so never zero
+      }
+
+      float const out[VERTEX_FLOATS] = {
+        vertex.position.x, vertex.position.y, vertex.position.z,
+        normal.x, normal.y, normal.z,
+        face.color.r, face.color.g, face.color.b, face.color.a,
+      };
+      result.insert(result.end(), out, out + VERTEX_FLOATS);
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Simplifies a triangle soup by quadric error edge collapse (Garland & Heckbert).
+//
+// `vertices` holds three vertices per triangle in the working vertex layout
+// (see MESH_SOURCE_VERTEX_FLOATS): a position, a normal, and a color. Coincident
+// positions are welded before simplifying, so the surface stays closed; each
+// triangle keeps the color of its first vertex. Triangles get flat normals,
+// unless `crease_degrees` is positive: then each corner's normal is averaged
+// over the faces around it which meet its own at less than that angle.
+//
+// Returns a soup in the same layout with at most `target_triangles` triangles,
+// or as few as could be reached without folding the surface over itself.
+std::vector<float> simplifyMesh(std::vector<float> const& vertices, size_t target_triangles, float crease_degrees = 0.0f);
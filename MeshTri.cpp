@@ -0,0 +1,256 @@
+#include "MeshTri.h"
+#include "MeshData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <glm/glm.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Powers of ten which are exactly representable as doubles.
+static double const EXACT_POWERS_OF_TEN[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+static int const MAX_EXACT_POWER_OF_TEN = 22;
+
+// Digits beyond this many can't change a float, so they're only counted.
+static int const MAX_SIGNIFICANT_DIGITS = 19;
+
+static bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+static bool IsBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Skips spaces, tabs, and carriage returns, but not newlines.
+static char const* SkipBlanks(char const* p, char const* end) {
+  while (p < end && IsBlank(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+// Parses a decimal number like "-12.5e3" at `p`, independent of the C locale.
+// Returns the end of the number, or null if there is no number at `p`.
+static char const* ParseFloat(char const* p, char const* end, float* const value) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    ++p;
+  }
+
+  uint64_t mantissa = 0;
+  int digits = 0;  // Significant digits in `mantissa`
+  int exponent = 0;
+  bool any_digits = false;
+
+  for (; p < end && IsDigit(*p); ++p) {
+    any_digits = true;
+    if (digits < MAX_SIGNIFICANT_DIGITS) {
+      mantissa = 10*mantissa + (*p - '0');
+      digits += (mantissa != 0);
+    } else {
+      exponent += 1;
+    }
+  }
+  if (p < end && *p == '.') {
+    for (++p; p < end && IsDigit(*p); ++p) {
+      any_digits = true;
+      if (digits < MAX_SIGNIFICANT_DIGITS) {
+        mantissa = 10*mantissa + (*p - '0');
+        digits += (mantissa != 0);
+        exponent -= 1;
+      }
+    }
+  }
+  if (!any_digits) {
+    return nullptr;
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    char const* q = p + 1;
+    bool negative_exponent = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+      negative_exponent = (*q == '-');
+      ++q;
+    }
+    if (q < end && IsDigit(*q)) {
+      int explicit_exponent = 0;
+      for (; q < end && IsDigit(*q); ++q) {
+        explicit_exponent = std::min(10*explicit_exponent + (*q - '0'), 1000);
+      }
+      exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+      p = q;
+    }
+  }
+
+  double result = (double)mantissa;
+  if (mantissa == 0) {
+    // Zero at any scale
+  } else if (exponent >= 0 && exponent <= MAX_EXACT_POWER_OF_TEN) {
+    result *= EXACT_POWERS_OF_TEN[exponent];
+  } else if (exponent < 0 && -exponent <= MAX_EXACT_POWER_OF_TEN) {
+    result /= EXACT_POWERS_OF_TEN[-exponent];
+  } else {
+    result *= std::pow(10.0, exponent);
+  }
+
+  *value = (float)(negative ? -result : result);
+  return p;
+}
+
+// Parses a color like "0xEE80EE" at `p`.
+// Returns the end of the color, or null if there is no color at `p`.
+static char const* ParseColor(char const* p, char const* end, uint32_t* const rgb) {
+  if (end - p < 3 || p[0] != '0' || (p[1] != 'x' && p[1] != 'X')) {
+    return nullptr;
+  }
+  p += 2;
+
+  uint32_t value = 0;
+  int digits = 0;
+  for (; p < end; ++p, ++digits) {
+    char const c = *p;
+    uint32_t digit;
+    if (IsDigit(c)) {
+      digit = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else {
+      break;
+    }
+    value = (value << 4) | digit;
+  }
+  if (digits < 1 || digits > 8) {
+    return nullptr;
+  }
+
+  *rgb = value;
+  return p;
+}
+
+bool parseTriData(char const* text, size_t length, char const* path, std::vector<GLfloat>* const soup) {
+  size_t const vertex_floats = MESH_SOURCE_VERTEX_FLOATS;
+  char const* const end = text + length;
+
+  // Size the output for one triangle per line.
+  size_t lines = 1;
+  for (char const* p = text; (p = static_cast<char const*>(memchr(p, '\n', end - p))); ++p) {
+    lines += 1;
+  }
+  soup->clear();
+  soup->reserve(3*vertex_floats * lines);
+
+  size_t line = 1;
+  char const* p = text;
+  while (p < end) {
+    p = SkipBlanks(p, end);
+    if (p == end) {
+      break;
+    } else if (*p == '\n') {
+      ++p;
+      ++line;
+      continue;
+    }
+
+    // Three corners, then a color.
+    char const* problem = nullptr;
+    float coords[9];
+    for (int i = 0; i < 9 && !problem; ++i) {
+      p = ParseFloat(SkipBlanks(p, end), end, &coords[i]);
+      if (!p || (p < end && !IsBlank(*p))) {
+        problem = "expected a coordinate";
+      }
+    }
+
+    uint32_t rgb = 0;
+    if (!problem) {
+      p = ParseColor(SkipBlanks(p, end), end, &rgb);
+      if (!p) {
+        problem = "expected a color like 0xRRGGBB";
+      }
+    }
+
+    if (!problem) {
+      p = SkipBlanks(p, end);
+      if (p < end && *p != '\n') {
+        problem = "unexpected text after the color";
+      }
+    }
+
+    if (problem) {
+      fprintf(stderr, "'%s', line %u: %s.\n", path, (unsigned)line, problem);
+      soup->clear();
+      return false;
+    }
+
+    glm::vec3 const p1{coords[0], coords[1], coords[2]};
+    glm::vec3 const p2{coords[3], coords[4], coords[5]};
+    glm::vec3 const p3{coords[6], coords[7], coords[8]};
+    glm::vec3 const cross = glm::cross(p2 - p1, p3 - p1);
+    float const area2 = glm::length(cross);
+    if (area2 == 0.0f) {
+      continue;  // Degenerate; the newline is consumed on the next pass
+    }
+    glm::vec3 const normal = cross / area2;
+
+    // bit shifting with masking to separate out RGB color data
+    float const r = (float)((rgb >> 16) & 0xFF) / 0xFF;
+    float const g = (float)((rgb >>  8) & 0xFF) / 0xFF;
+    float const b = (float)((rgb >>  0) & 0xFF) / 0xFF;
+
+    GLfloat const triangle[3*MESH_SOURCE_VERTEX_FLOATS] = {
+      p1.x, p1.y, p1.z, normal.x, normal.y, normal.z, r, g, b, 1.0f,
+      p2.x, p2.y, p2.z, normal.x, normal.y, normal.z, r, g, b, 1.0f,
+      p3.x, p3.y, p3.z, normal.x, normal.y, normal.z, r, g, b, 1.0f,
+    };
+    soup->insert(soup->end(), triangle, triangle + 3*vertex_floats);
+  }
+
+  return true;
+}
+
+bool readTriFile(char const* tri_path, std::vector<GLfloat>* const soup) {
+  int const fd = open(tri_path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Unable to open file '%s'.\n", tri_path);
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    fprintf(stderr, "Unable to read file '%s'.\n", tri_path);
+    close(fd);
+    return false;
+  }
+
+  size_t const length = (size_t)info.st_size;
+  if (length == 0) {
+    close(fd);
+    soup->clear();
+    return true;
+  }
+
+  // Map the whole file, rather than copying it through stdio a line at a time.
+  void* const mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "Unable to map file '%s'.\n", tri_path);
+    return false;
+  }
+  madvise(mapping, length, MADV_SEQUENTIAL);
+
+  bool const ok = parseTriData(static_cast<char const*>(mapping), length, tri_path, soup);
+  munmap(mapping, length);
+  return ok;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+// A .TRI model is a text file with one triangle per line: the x, y and z of each
+// of its three corners, then its color as a hex 0xRRGGBB.
+//
+//   23.2934 -21.0781 24.8774  21.829 -19.9569 36.6226  15.8661 -12.8965 20.766  0xEE80EE
+//
+// Blank lines are allowed. Triangles are flat shaded, so each is given the normal
+// of its face; degenerate triangles cover no pixels and are dropped.
+
+// Reads a .TRI file into a triangle soup in the working vertex layout
+// (see MESH_SOURCE_VERTEX_FLOATS). The file is mapped into memory rather than read.
+// Returns false, reporting the offending line, if the file can't be read or is malformed.
+bool readTriFile(char const* tri_path, std::vector<GLfloat>* const soup);
+
+// Parses the text of a .TRI file, as readTriFile does. `path` only labels error messages.
+bool parseTriData(char const* text, size_t length, char const* path, std::vector<GLfloat>* const soup);
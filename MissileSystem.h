@@ -1,13 +1,16 @@
 #pragma once
 
 #include "GameState.h"
+#include "ScheduleSystem.h"
+#include "util/alloc.h"
+#include "util/profile.h"
 
 #include <glm/gtc/matrix_access.hpp>
 #include <cmath>
 
 // Query result object for interfacing with the EntityDatabase
 struct DirectableEntity {
-  std::string id;
+  std::string const* id;  // The entity's key in `positions`
   PositionComponent* position;
   MissileComponent* missile;
 };
@@ -15,7 +18,7 @@ template<>
 struct EntityQuery<PositionComponent> {
   typedef PositionComponent* Entity;
 
-  static bool Query(EntityDatabase& entities, std::string id, PositionComponent** const entity) {
+  static bool Query(EntityDatabase& entities, std::string const& id, PositionComponent** const entity) {
     auto posItr = entities.positions.find(id);
 
     if (posItr == entities.positions.end()) {
@@ -32,7 +35,7 @@ template<>
 struct EntityQuery<DirectableEntity> {
   typedef DirectableEntity Entity;
 
-  static bool Query(EntityDatabase& entities, std::string id, DirectableEntity* const entity) {
+  static bool Query(EntityDatabase& entities, std::string const& id, DirectableEntity* const entity) {
     auto posItr = entities.positions.find(id);
     auto missileItr = entities.missiles.find(id);
 
@@ -40,7 +43,7 @@ struct EntityQuery<DirectableEntity> {
       return false;
     }
 
-    entity->id = id;
+    entity->id = &posItr->first;
     entity->position = &posItr->second;
     entity->missile = &missileItr->second;
     return true;
@@ -50,36 +53,29 @@ struct EntityQuery<DirectableEntity> {
 // Implements missile orientation, propulsion, and tracking of tarets
 class MissileSystem {
 protected:
-  static glm::mat4 GetWorldMatrix(EntityDatabase& entities, std::string const& id) {
-    PositionComponent const& position = entities.positions.at(id);
-
-    glm::mat4 worldMatrix =
-        glm::translate(glm::mat4{1.0f}, position.translation)
-      * glm::mat4_cast(position.orientation);
-
-    PositionComponent const* current = &position;
-    while (entities.positions.find(current->parent) != entities.positions.end()) {
-      current = &entities.positions.at(current->parent);
-      worldMatrix = glm::translate(glm::mat4{1.0f}, current->translation) * worldMatrix;
-    }
-
-    return worldMatrix;
-  }
-
   static float GetDistance(EntityDatabase& entities, std::string const& id1, std::string const& id2) {
-    auto const pos1 = glm::vec3{GetWorldMatrix(entities, id1) * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
-    auto const pos2 = glm::vec3{GetWorldMatrix(entities, id2) * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
+    auto const pos1 = glm::vec3{entities.GetWorldMatrix(id1) * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
+    auto const pos2 = glm::vec3{entities.GetWorldMatrix(id2) * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
     return glm::length(pos1 - pos2);
   }
 
 public:
   void Update(GameState& state, double delta) {
+    PROFILE_ZONE("MissileSystem::Update");
+    ALLOC_SCOPE("MissileSystem::Update");
+
     auto view = state.entities.Query<DirectableEntity>();
     for (auto itr = view.begin(); itr != view.end();) {
       auto entity = *itr;
 
-      entity.missile->time_to_live -= delta;
-      std::cout << entity.id << ": " << entity.missile->time_to_live << std::endl;
+      // Distant missiles are updated less often, for all the time since they last were.
+      double elapsed = delta;
+      if (!ScheduleSystem::IsDue(state.entities, *entity.id, delta, &elapsed)) {
+        ++itr;
+        continue;
+      }
+
+      entity.missile->time_to_live -= elapsed;
 
       if (entity.missile->time_to_live <= 0) {
       // It's dead now
@@ -116,7 +112,7 @@ public:
               continue;
             }
 
-            float distance = GetDistance(state.entities, entity.id, candidate);
+            float distance = GetDistance(state.entities, *entity.id, candidate);
             if (distance < entity.missile->range) {
               if (target == "" || distance < target_distance) {
                 target = candidate;
@@ -130,8 +126,8 @@ public:
         PositionComponent* target = nullptr;
         if (EntityQuery<PositionComponent>::Query(state.entities, entity.missile->target, &target)) {
           // Find the world-relative position of the entity
-          auto const target_position = glm::vec3{GetWorldMatrix(state.entities, entity.missile->target) * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
-          auto const missile_position = glm::vec3{GetWorldMatrix(state.entities, entity.id) * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
+          auto const target_position = glm::vec3{state.entities.GetWorldMatrix(entity.missile->target) * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
+          auto const missile_position = glm::vec3{state.entities.GetWorldMatrix(*entity.id) * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
 
           // Calculate the axis of rotation for the missile
           auto const target_direction = glm::normalize(target_position - missile_position);
@@ -152,7 +148,7 @@ public:
         }
       }
 
-      entity.position->translation += entity.position->orientation * (((float)delta)*glm::vec3{0.0f, 0.0f, -entity.missile->speed});
+      entity.position->translation += entity.position->orientation * (((float)elapsed)*glm::vec3{0.0f, 0.0f, -entity.missile->speed});
 
       ++itr;
     }
@@ -1,10 +1,17 @@
 #include "RenderSystem.h"
 #include "shaders.h"
 #include "Texture.h"
+#include "util/alloc.h"
+#include "util/debug.h"
+#include "util/profile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
 
 // Query result object for interfacing with the EntityDatabase
 struct RenderableEntity {
-  std::string id;
+  std::string const* id;  // The entity's key in `positions`
   PositionComponent* position;
   ModelComponent* model;
 };
@@ -12,7 +19,7 @@ template<>
 struct EntityQuery<RenderableEntity> {
   typedef RenderableEntity Entity;
 
-  static bool Query(EntityDatabase& entities, std::string id, RenderableEntity* const entity) {
+  static bool Query(EntityDatabase& entities, std::string const& id, RenderableEntity* const entity) {
     auto posItr = entities.positions.find(id);
     auto modelItr = entities.models.find(id);
 
@@ -20,16 +27,50 @@ struct EntityQuery<RenderableEntity> {
       return false;
     }
 
-    entity->id = id;
+    entity->id = &posItr->first;
     entity->position = &posItr->second;
     entity->model = &modelItr->second;
     return true;
   }
 };
 
+// Query result object for interfacing with the EntityDatabase
+struct LitEntity {
+  std::string const* id;  // The entity's key in `positions`
+  PositionComponent* position;
+  LightComponent* light;
+};
+template<>
+struct EntityQuery<LitEntity> {
+  typedef LitEntity Entity;
+
+  static bool Query(EntityDatabase& entities, std::string const& id, LitEntity* const entity) {
+    auto posItr = entities.positions.find(id);
+    auto lightItr = entities.lights.find(id);
+
+    if (posItr == entities.positions.end() || lightItr == entities.lights.end()) {
+      return false;
+    }
+
+    entity->id = &posItr->first;
+    entity->position = &posItr->second;
+    entity->light = &lightItr->second;
+    return true;
+  }
+};
+
+// The procedural starfield: which sky, and how many stars in it
+static uint32_t const STAR_FIELD_SEED = 465;
+static size_t const STAR_FIELD_COUNT = 8000;
+
+// Texture units holding the clustered lighting data
+static int const CLUSTER_GRID_UNIT = 1;
+static int const CLUSTER_INDEX_UNIT = 2;
+static int const CLUSTER_LIGHT_UNIT = 3;
+
 // Computes the view matrix from the world to the given entity.
 static glm::mat4 GetViewMatrix(EntityDatabase& entities, std::string const& id) {
-  PositionComponent const& position = entities.positions.at(id);
+  PositionComponent const& position = entities.GetPosition(id);
   CameraComponent const& camera = entities.cameras.at(id);
 
   glm::mat4 viewMatrix = glm::lookAt(
@@ -39,76 +80,130 @@ static glm::mat4 GetViewMatrix(EntityDatabase& entities, std::string const& id)
   );
 
   if (entities.positions.find(position.parent) != entities.positions.end()) {
-    PositionComponent const& parent = entities.positions.at(position.parent);
+    PositionComponent const& parent = entities.GetPosition(position.parent);
     viewMatrix *= glm::mat4_cast(glm::inverse(parent.orientation));
   }
 
   PositionComponent const* current = &position;
   while (entities.positions.find(current->parent) != entities.positions.end()) {
-    current = &entities.positions.at(current->parent);
+    current = &entities.GetPosition(current->parent);
     viewMatrix *= glm::translate(glm::mat4{1.0f}, -current->translation);
   }
 
   return viewMatrix;
 }
 
-// Computes the model matrix from the given entity to the world.
-static glm::mat4 GetWorldMatrix(EntityDatabase& entities, std::string const& id) {
-  PositionComponent const& position = entities.positions.at(id);
-
-  glm::mat4 worldMatrix =
-      glm::translate(glm::mat4{1.0f}, position.translation)
-    * glm::mat4_cast(position.orientation);
-
-  PositionComponent const* current = &position;
-  while (entities.positions.find(current->parent) != entities.positions.end()) {
-    current = &entities.positions.at(current->parent);
-    worldMatrix = glm::translate(glm::mat4{1.0f}, current->translation) * worldMatrix;
+// The preprocessor definitions selecting the given combination of LIGHTING_* flags.
+std::vector<std::string> RenderSystem::GetLightingDefines(int lighting) {
+  std::vector<std::string> defines{
+    "CLUSTER_TILES_X " + std::to_string(LightClusters::TILES_X),
+    "CLUSTER_TILES_Y " + std::to_string(LightClusters::TILES_Y),
+    "CLUSTER_SLICES " + std::to_string(LightClusters::SLICES),
+  };
+  if (lighting & LIGHTING_RUBER) {
+    defines.push_back("LIGHT_RUBER");
   }
-
-  return worldMatrix;
+  if (lighting & LIGHTING_GLOBAL) {
+    defines.push_back("LIGHT_GLOBAL");
+  }
+  if (lighting & LIGHTING_HEADLIGHT) {
+    defines.push_back("LIGHT_HEADLIGHT");
+  }
+  return defines;
 }
 
-RenderSystem::RenderSystem(GLFWwindow* window, glm::mat4 projectionMatrix)
-  : window{window}, projectionMatrix{projectionMatrix}
+RenderSystem::RenderSystem(GLFWwindow* window, glm::mat4 projectionMatrix, AssetRegistry& registry, Backdrop backdrop)
+  : window{window}, backdrop{backdrop}, projectionMatrix{projectionMatrix}
 {
-  // Prepare the mainline rendering shader
-  this->shader_id = create_program_from_files("shaders/vertex.glsl", "shaders/fragment.glsl");
-  if (this->shader_id == GL_NONE) {
-    // TODO: Throw an exception instead so the environment is cleaned up properly.
-    exit(1);
+  // Queue our assets first, so that they load while the shaders compile.
+  if (this->backdrop == Backdrop::CUBE_MAP) {
+    // The box geometry for our skybox to be drawn on:
+    this->skyboxMesh = registry.LoadMesh("models/skybox.tri");
+
+    // starfield texture management
+    static int const CUBE_MAP_DIM = 908; // our .RAW file tiles are 908 pixels on each side
+    static char const* const FACES[6] = {
+      "images/starfield_1.raw",
+      "images/starfield_2.raw",
+      "images/starfield_3.raw",
+      "images/starfield_4.raw",
+      "images/starfield_5.raw",
+      "images/starfield_6.raw",
+    };
+
+    // create starfield texture cube map; its six square texture tiles fill in as they are read
+    this->cubeMap = registry.LoadCubeMap(FACES, CUBE_MAP_DIM);
+  }
+
+  // Prepare a mainline rendering shader for every combination of lights.
+  for (int lighting = 0; lighting < LIGHTING_PERMUTATIONS; ++lighting) {
+    std::vector<std::string> const defines = GetLightingDefines(lighting);
+    this->shader_ids[lighting] = create_program_from_files("shaders/vertex.glsl", "shaders/fragment.glsl", defines);
+    if (this->shader_ids[lighting] == GL_NONE) {
+      // TODO: Throw an exception instead so the environment is cleaned up properly.
+      exit(1);
+    }
   }
 
-  // Prepare the skybox rendering shader
-  this->skybox_shader_id = create_program_from_files("shaders/skybox-vertex.glsl", "shaders/skybox-fragment.glsl");
-  if (this->skybox_shader_id == GL_NONE) {
-    // TODO: Throw an exception instead so the environment is cleaned up properly.
-    exit(1);
+  // Prepare the GPU-driven path, if the driver can run it.
+  if (IndirectRenderer::IsSupported()) {
+    for (int lighting = 0; lighting < LIGHTING_PERMUTATIONS; ++lighting) {
+      std::vector<std::string> defines = GetLightingDefines(lighting);
+      defines.push_back("GPU_DRIVEN");
+
+      this->indirect_shader_ids[lighting] = create_program_from_files("shaders/indirect-vertex.glsl", "shaders/fragment.glsl", defines);
+      if (this->indirect_shader_ids[lighting] == GL_NONE) {
+        // TODO: Throw an exception instead so the environment is cleaned up properly.
+        exit(1);
+      }
+    }
+
+    this->indirect.reset(new IndirectRenderer{});
+
+    // The indirect renderer knows meshes by address, which an evicted mesh may pass on to another.
+    IndirectRenderer* const indirect = this->indirect.get();
+    registry.AddMeshEvictionListener([indirect](Mesh const& mesh) {
+      indirect->ForgetMesh(mesh);
+    });
   }
 
-  // Load the box geometry for our skybox to be drawn on
-  this->skyboxMesh = loadMeshFromFile("models/skybox.tri");
+  // Prepare the backdrop: the skybox rendering shader, or the stars themselves
+  if (this->backdrop == Backdrop::CUBE_MAP) {
+    this->skybox_shader_id = create_program_from_files("shaders/skybox-vertex.glsl", "shaders/skybox-fragment.glsl");
+    if (this->skybox_shader_id == GL_NONE) {
+      // TODO: Throw an exception instead so the environment is cleaned up properly.
+      exit(1);
+    }
+  } else {
+    this->starField.reset(new StarField{STAR_FIELD_SEED, STAR_FIELD_COUNT});
+  }
 
+  // Prepare the clustered lighting grid for our projection and framebuffer.
   {
-    // starfield texture management
-    static int const CUBE_MAP_DIM = 908; // our .RAW file tiles are 908 pixels on each side
-    unsigned char* texData[6]; // array to hold our texture data
-
-    // load our texture data array with six square texture tiles
-    texData[0] = loadRawData("images/starfield_1.raw", CUBE_MAP_DIM, CUBE_MAP_DIM);
-    texData[1] = loadRawData("images/starfield_2.raw", CUBE_MAP_DIM, CUBE_MAP_DIM);
-    texData[2] = loadRawData("images/starfield_3.raw", CUBE_MAP_DIM, CUBE_MAP_DIM);
-    texData[3] = loadRawData("images/starfield_4.raw", CUBE_MAP_DIM, CUBE_MAP_DIM);
-    texData[4] = loadRawData("images/starfield_5.raw", CUBE_MAP_DIM, CUBE_MAP_DIM);
-    texData[5] = loadRawData("images/starfield_6.raw", CUBE_MAP_DIM, CUBE_MAP_DIM);
-
-    // create starfield texture cube map
-    this->cubeMap = makeCubeMap(texData, CUBE_MAP_DIM);
-
-    // release our .RAW file temp memory
-    for (int i = 0; i < 6; i++) {
-      free(texData[i]);
+    this->clusters.Configure(this->projectionMatrix);
+
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(this->window, &width, &height);
+    this->viewportSize = glm::vec2{(float)width, (float)height};
+    this->clusterTileSize = glm::vec2{
+      (float)width / LightClusters::TILES_X,
+      (float)height / LightClusters::TILES_Y,
+    };
+
+    GLenum const formats[3] = {GL_RG32UI, GL_R32UI, GL_RGBA32F};
+    glGenBuffers(3, this->clusterBuffers);
+    glGenTextures(3, this->clusterTextures);
+    for (int i = 0; i < 3; ++i) {
+      glBindBuffer(GL_TEXTURE_BUFFER, this->clusterBuffers[i]);
+      glBindTexture(GL_TEXTURE_BUFFER, this->clusterTextures[i]);
+      glTexBuffer(GL_TEXTURE_BUFFER, formats[i], this->clusterBuffers[i]);
     }
+    glBindTexture(GL_TEXTURE_BUFFER, GL_NONE);
+    glBindBuffer(GL_TEXTURE_BUFFER, GL_NONE);
+
+    labelGlObject(GL_BUFFER, this->clusterBuffers[0], "cluster grid");
+    labelGlObject(GL_BUFFER, this->clusterBuffers[1], "cluster light indices");
+    labelGlObject(GL_BUFFER, this->clusterBuffers[2], "cluster lights");
   }
 }
 
@@ -124,10 +219,9 @@ struct Light {
   // Specular sharpness/power is fixed in the shader
 
   float attenuation;
-  bool enabled;  // Whether the light should be utilized
 };
 
-static Light GetGlobalLight(GameState& state) {
+static Light GetGlobalLight(GameState& /*state*/) {
   return Light{
     glm::vec3(0.0f, 0.0f, 0.0f),
     glm::vec3(0.0f, 0.0f, 0.0f),
@@ -137,11 +231,10 @@ static Light GetGlobalLight(GameState& state) {
     glm::vec3(0.0f, 0.0f, 0.0f),
 
     0.0f,
-    state.is_lit_global,
   };
 }
 
-static Light GetRuberLight(GameState& state) {
+static Light GetRuberLight(GameState& /*state*/) {
   return Light{
     glm::vec3(0.0f, 0.0f, 0.0f),
     glm::vec3(0.0f, 0.0f, 0.0f),
@@ -151,7 +244,6 @@ static Light GetRuberLight(GameState& state) {
     glm::vec3(0.0f, 0.0f, 0.0f),
 
     0.000000003f,
-    state.is_lit_ruber,
   };
 }
 
@@ -168,19 +260,150 @@ static Light GetHeadLight(GameState& state) {
     glm::vec3(0.8f, 0.8f, 0.8f),
 
     0.0f,
-    state.is_lit_headlight,
   };
 }
 
+// The light emitted by the given entity's surface.
+static glm::vec4 GetEmissivity(std::string const& id) {
+  if (id == "Ruber") {
+    return glm::vec4{0.87f, 0.47f, 0.0f, 1.0f};
+  } else {
+    return glm::vec4{0.0f, 0.0f, 0.0f, 1.0f};
+  }
+}
+
+// Looks up a member of a struct uniform. The name is built on the stack, since
+// this runs for every light in every frame.
+static GLint GetMemberLocation(GLuint shader_id, char const* name, char const* member) {
+  char uniform[64];
+  snprintf(uniform, sizeof(uniform), "%s.%s", name, member);
+  return glGetUniformLocation(shader_id, uniform);
+}
+
+// Sets the uniforms of a given light.
+static void SetLightUniforms(GLuint shader_id, char const* name, Light const& light) {
+  glUniform3fv(GetMemberLocation(shader_id, name, "position"), 1, glm::value_ptr(light.position));
+  glUniform3fv(GetMemberLocation(shader_id, name, "direction"), 1, glm::value_ptr(light.direction));
+  glUniform3fv(GetMemberLocation(shader_id, name, "ambient"), 1, glm::value_ptr(light.ambient));
+  glUniform3fv(GetMemberLocation(shader_id, name, "diffuse"), 1, glm::value_ptr(light.diffuse));
+  glUniform3fv(GetMemberLocation(shader_id, name, "specular"), 1, glm::value_ptr(light.specular));
+
+  glUniform1f(GetMemberLocation(shader_id, name, "attenuation"), light.attenuation);
+}
+
+// Uploads `data` into a texture buffer, reallocating its storage.
+template<typename T>
+static void UploadBuffer(GLuint buffer, std::vector<T> const& data) {
+  // Buffer textures must not be empty, so always upload at least one element.
+  static T const empty{};
+  glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+  glBufferData(
+    GL_TEXTURE_BUFFER,
+    sizeof(T) * std::max(data.size(), (size_t)1),
+    data.empty() ? &empty : data.data(),
+    GL_STREAM_DRAW
+  );
+}
+
+void RenderSystem::UpdateClusters(GameState& state, glm::mat4 const& viewMatrix) {
+  this->clusterLights.clear();
+  for (auto entity : state.entities.Query<LitEntity>()) {
+    glm::mat4 const worldMatrix = state.entities.GetWorldMatrix(*entity.id);
+
+    this->clusterLights.push_back(ClusterLight{
+      glm::vec3{worldMatrix * glm::vec4{entity.light->offset, 1.0f}},
+      entity.light->radius,
+      entity.light->color,
+      entity.light->intensity,
+    });
+  }
+
+  this->clusters.Build(viewMatrix, this->clusterLights);
+
+  UploadBuffer(this->clusterBuffers[0], this->clusters.grid);
+  UploadBuffer(this->clusterBuffers[1], this->clusters.indices);
+  UploadBuffer(this->clusterBuffers[2], this->clusters.lights);
+  glBindBuffer(GL_TEXTURE_BUFFER, GL_NONE);
+}
+
+void RenderSystem::SetFrameUniforms(GLuint shader_id, GameState& state, glm::mat4 const& viewMatrix, int lighting) {
+  GL_DEBUG_SITE("frame uniforms");
+  glUseProgram(shader_id);
+
+  glm::mat4 inverseViewMatrix = glm::inverse(viewMatrix);
+  GLint const viewPositionLocation = glGetUniformLocation(shader_id, "u_viewPosition");
+  glUniform3fv(viewPositionLocation, 1, glm::value_ptr(glm::vec3{inverseViewMatrix * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}}));
+
+  GLint const viewNormalLocation = glGetUniformLocation(shader_id, "u_viewNormal");
+  glUniform3fv(viewNormalLocation, 1, glm::value_ptr(glm::vec3{inverseViewMatrix * glm::vec4{0.0f, 0.0f, -1.0f, 0.0f}}));
+
+  if (lighting & LIGHTING_RUBER) { // Specify Ruber light
+    SetLightUniforms(shader_id, "u_ruberLight", GetRuberLight(state));
+  }
+
+  if (lighting & LIGHTING_GLOBAL) { // Specify Global light
+    SetLightUniforms(shader_id, "u_globalLight", GetGlobalLight(state));
+  }
+
+  if (lighting & LIGHTING_HEADLIGHT) { // Specify Headlight
+    SetLightUniforms(shader_id, "u_headLight", GetHeadLight(state));
+  }
+
+  glUniform1i(glGetUniformLocation(shader_id, "u_clusterGrid"), CLUSTER_GRID_UNIT);
+  glUniform1i(glGetUniformLocation(shader_id, "u_clusterIndices"), CLUSTER_INDEX_UNIT);
+  glUniform1i(glGetUniformLocation(shader_id, "u_clusterLights"), CLUSTER_LIGHT_UNIT);
+  glUniform2fv(glGetUniformLocation(shader_id, "u_clusterTileSize"), 1, glm::value_ptr(this->clusterTileSize));
+  glUniform1f(glGetUniformLocation(shader_id, "u_clusterNear"), this->clusters.GetNearPlane());
+  glUniform1f(glGetUniformLocation(shader_id, "u_clusterFar"), this->clusters.GetFarPlane());
+  glUniform1f(glGetUniformLocation(shader_id, "u_clusterSliceScale"), this->clusters.GetSliceScale());
+}
+
+MeshLod const& RenderSystem::SelectLod(ModelComponent* model, glm::mat4 const& viewMatrix, glm::mat4 const& worldMatrix) {
+  Mesh const& mesh = *model->mesh;
+
+  // Estimate the on-screen radius of the mesh's bounding sphere.
+  float const distance = glm::length(glm::vec3{viewMatrix * worldMatrix[3]});
+  float const pixelRadius =
+      mesh.boundingRadius * this->projectionMatrix[1][1] * 0.5f * this->viewportSize.y
+    / std::max(distance, this->clusters.GetNearPlane());
+
+  model->lod = selectMeshLod(mesh, model->lod, pixelRadius);
+  return mesh.lods[model->lod];
+}
+
 void RenderSystem::Render(GameState& state) {
+  PROFILE_ZONE("RenderSystem::Render");
+  ALLOC_SCOPE("RenderSystem::Render");
+  int const frameZone = this->gpuProfiler.Begin("GPU frame");
+  this->stats = Stats{};
+
   // Clear the previous render results
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
   // Compute the cumulative transformation from the world basis to clip space.
   glm::mat4 const viewMatrix = GetViewMatrix(state.entities, CAMERAS[state.active_camera]);
 
-  // Draw the skybox!
-  {
+  // Pick the shader variant which evaluates exactly the lights that are on.
+  int const lighting =
+      (state.is_lit_ruber ? LIGHTING_RUBER : 0)
+    | (state.is_lit_global ? LIGHTING_GLOBAL : 0)
+    | (state.is_lit_headlight ? LIGHTING_HEADLIGHT : 0);
+  GLuint const shader_id = this->shader_ids[lighting];
+
+  // Draw the stars!
+  if (this->starField) {
+    pushGlDebugGroup("star pass");
+    GPU_PROFILE_ZONE(this->gpuProfiler, "GPU star pass");
+    this->starField->Draw(this->projectionMatrix * glm::mat4{glm::mat3{viewMatrix}}, this->viewportSize);
+    ++this->stats.drawCalls;
+    popGlDebugGroup();
+  }
+
+  // Draw the skybox, once its mesh has loaded!
+  if (this->backdrop == Backdrop::CUBE_MAP && this->skyboxMesh) {
+    pushGlDebugGroup("skybox pass");
+    GPU_PROFILE_ZONE(this->gpuProfiler, "GPU skybox pass");
+    GL_DEBUG_SITE("skybox");
     glUseProgram(this->skybox_shader_id);
 
     glm::mat4 mvpMatrix =
@@ -190,116 +413,187 @@ void RenderSystem::Render(GameState& state) {
     GLint const mvpMatrixLocation = glGetUniformLocation(this->skybox_shader_id, "mvpMatrix");
     glUniformMatrix4fv(mvpMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
 
+    // The cube map is sampled by model-space position, so the shader unpacks positions itself.
+    GLint const positionOffsetLocation = glGetUniformLocation(this->skybox_shader_id, "u_positionOffset");
+    glUniform3fv(positionOffsetLocation, 1, glm::value_ptr(this->skyboxMesh->positionOffset));
+    GLint const positionScaleLocation = glGetUniformLocation(this->skybox_shader_id, "u_positionScale");
+    glUniform3fv(positionScaleLocation, 1, glm::value_ptr(this->skyboxMesh->positionScale));
+
     GLint const cubeLocation = glGetUniformLocation(this->skybox_shader_id, "cube");
     glActiveTexture(GL_TEXTURE0);
     glUniform1i(cubeLocation, 0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, this->cubeMap);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, this->cubeMap->id);
 
     glDepthMask(GL_FALSE);
     glFrontFace(GL_CW);
 
     // Issue a draw task to the GPU
-    glBindVertexArray(this->skyboxMesh.vao);
-    glDrawArrays(this->skyboxMesh.primitiveType, 0, this->skyboxMesh.primitiveCount);
+    glBindVertexArray(this->skyboxMesh->vao);
+    glDrawElements(this->skyboxMesh->primitiveType, this->skyboxMesh->primitiveCount, GL_UNSIGNED_INT, (GLvoid*)0);
+    ++this->stats.drawCalls;
 
     glBindTexture(GL_TEXTURE_CUBE_MAP, GL_NONE);
     glDepthMask(GL_TRUE);
     glFrontFace(GL_CCW);
+    popGlDebugGroup();
+  }
+
+  // Bin the dynamic lights and bind them for the entity pass
+  {
+    pushGlDebugGroup("light clustering");
+    GPU_PROFILE_ZONE(this->gpuProfiler, "GPU light clustering");
+    GL_DEBUG_SITE("light clusters");
+    UpdateClusters(state, viewMatrix);
+
+    int const units[3] = {CLUSTER_GRID_UNIT, CLUSTER_INDEX_UNIT, CLUSTER_LIGHT_UNIT};
+    for (int i = 0; i < 3; ++i) {
+      glActiveTexture(GL_TEXTURE0 + units[i]);
+      glBindTexture(GL_TEXTURE_BUFFER, this->clusterTextures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    popGlDebugGroup();
   }
 
   // Draw all the other entities
-  for (auto entity : state.entities.Query<RenderableEntity>()) {
-    // Set up the shader for this instance
-    {
-      // Use our simple ("100% ambient light") shader.
-      glUseProgram(this->shader_id);
-
-      // Configure the render properties of this instance via shader uniforms.
-      // Properties specific to each instance may include its position, animation step, etc.
-
-      glm::mat4 const worldMatrix = GetWorldMatrix(state.entities, entity.id);
-      GLint const worldMatrixLocation = glGetUniformLocation(this->shader_id, "worldMatrix");
-      glUniformMatrix4fv(worldMatrixLocation, 1, GL_FALSE, glm::value_ptr(worldMatrix));
-
-      GLint const normalMatrixLocation = glGetUniformLocation(this->shader_id, "normalMatrix");
-      glUniformMatrix3fv(normalMatrixLocation, 1, GL_FALSE, glm::value_ptr(glm::mat3{glm::inverseTranspose(worldMatrix)}));
-
-      glm::mat4 const mvpMatrix = this->projectionMatrix * viewMatrix * worldMatrix;
-      GLint const mvpMatrixLocation = glGetUniformLocation(this->shader_id, "mvpMatrix");
-      glUniformMatrix4fv(mvpMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
-
-      GLint const emissivityLocation = glGetUniformLocation(this->shader_id, "u_emissivity");
-      if (entity.id == "Ruber") {
-        glUniform4f(emissivityLocation, 0.87f, 0.47f, 0.0f, 1.0f);
-      } else {
-        glUniform4f(emissivityLocation, 0.0f, 0.0f, 0.0f, 1.0f);
+  pushGlDebugGroup("entity pass");
+  int const entityZone = this->gpuProfiler.Begin("GPU entity pass");
+  glm::mat4 const viewProjectionMatrix = this->projectionMatrix * viewMatrix;
+  glm::vec4 frustumPlanes[6];
+  getFrustumPlanes(viewProjectionMatrix, frustumPlanes);
+  if (state.gpu_driven && this->indirect) {
+    GLuint const program = this->indirect_shader_ids[lighting];
+    SetFrameUniforms(program, state, viewMatrix, lighting);
+
+    glUniformMatrix4fv(glGetUniformLocation(program, "viewProjectionMatrix"), 1, GL_FALSE, glm::value_ptr(viewProjectionMatrix));
+
+    // Gather every instance; culling and draw submission happen on the GPU.
+    this->indirectInstances.clear();
+    for (auto entity : state.entities.Query<RenderableEntity>()) {
+      auto& mesh = entity.model->mesh;
+      if (!mesh) {
+        continue;  // Still loading
+      }
+      glm::mat4 const worldMatrix = state.entities.GetWorldMatrix(*entity.id);
+      SelectLod(entity.model, viewMatrix, worldMatrix);
+
+      IndirectInstance instance{};
+      instance.worldMatrix = worldMatrix * mesh->GetPositionMatrix();
+      instance.normalMatrix = glm::mat4{glm::mat3{glm::inverseTranspose(worldMatrix)}};
+      instance.emissivity = GetEmissivity(*entity.id);
+      instance.sphere = glm::vec4{glm::vec3{worldMatrix[3]}, mesh->boundingRadius};
+      instance.mesh = this->indirect->GetMeshSlot(*mesh, entity.model->lod);
+      this->indirectInstances.push_back(instance);
+
+      // The GPU culls these itself; count the ones it will, for the HUD.
+      ++this->stats.entities;
+      if (!isSphereInFrustum(frustumPlanes, instance.sphere)) {
+        ++this->stats.culled;
       }
+    }
 
-      glm::mat4 inverseViewMatrix = glm::inverse(viewMatrix);
-      GLint const viewPositionLocation = glGetUniformLocation(this->shader_id, "u_viewPosition");
-      glUniform3fv(viewPositionLocation, 1, glm::value_ptr(glm::vec3{inverseViewMatrix * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}}));
+    if (!assertShaderValid(program)) {
+      // TODO: Throw an exception instead so the environment is cleaned up properly.
+      exit(1);
+    }
 
-      GLint const viewNormalLocation = glGetUniformLocation(this->shader_id, "u_viewNormal");
-      glUniform3fv(viewNormalLocation, 1, glm::value_ptr(glm::vec3{inverseViewMatrix * glm::vec4{0.0f, 0.0f, -1.0f, 0.0f}}));
+    this->indirect->Draw(program, this->indirectInstances, viewProjectionMatrix);
+    ++this->stats.drawCalls;
+  } else {
+    SetFrameUniforms(shader_id, state, viewMatrix, lighting);
 
-      { // Specify Ruber light
-        Light light = GetRuberLight(state);
-        glUniform3fv(glGetUniformLocation(this->shader_id, "u_ruberLight.position"), 1, glm::value_ptr(light.position));
-        glUniform3fv(glGetUniformLocation(this->shader_id, "u_ruberLight.direction"), 1, glm::value_ptr(light.direction));
-        glUniform3fv(glGetUniformLocation(this->shader_id, "u_ruberLight.ambient"), 1, glm::value_ptr(light.ambient));
-        glUniform3fv(glGetUniformLocation(this->shader_id, "u_ruberLight.diffuse"), 1, glm::value_ptr(light.diffuse));
-        glUniform3fv(glGetUniformLocation(this->shader_id, "u_ruberLight.specular"), 1, glm::value_ptr(light.specular));
+    for (auto entity : state.entities.Query<RenderableEntity>()) {
+      if (!entity.model->mesh) {
+        continue;  // Still loading
+      }
+      glm::mat4 const worldMatrix = state.entities.GetWorldMatrix(*entity.id);
 
-        glUniform1f(glGetUniformLocation(this->shader_id, "u_ruberLight.attenuation"), light.attenuation);
-        glUniform1i(glGetUniformLocation(this->shader_id, "u_ruberLight.enabled"), light.enabled);
+      // Skip entities outside the view, as the GPU-driven path's culling does.
+      ++this->stats.entities;
+      if (!isSphereInFrustum(frustumPlanes, glm::vec4{glm::vec3{worldMatrix[3]}, entity.model->mesh->boundingRadius})) {
+        ++this->stats.culled;
+        continue;
       }
 
-      { // Specify Global light
-        Light light = GetGlobalLight(state);
-        glUniform3fv(glGetUniformLocation(this->shader_id, "u_globalLight.position"), 1, glm::value_ptr(light.position));
-        glUniform3fv(glGetUniformLocation(this->shader_id, "u_globalLight.direction"), 1, glm::value_ptr(light.direction));
-        glUniform3fv(glGetUniformLocation(this->shader_id, "u_globalLight.ambient"), 1, glm::value_ptr(light.ambient));
-        glUniform3fv(glGetUniformLocation(this->shader_id, "u_globalLight.diffuse"), 1, glm::value_ptr(light.diffuse));
-        glUniform3fv(glGetUniformLocation(this->shader_id, "u_globalLight.specular"), 1, glm::value_ptr(light.specular));
+      pushGlDebugGroup(entity.id->c_str());
 
-        glUniform1f(glGetUniformLocation(this->shader_id, "u_globalLight.attenuation"), light.attenuation);
-        glUniform1i(glGetUniformLocation(this->shader_id, "u_globalLight.enabled"), light.enabled);
-      }
+      // Set up the shader for this instance
+      {
+        GL_DEBUG_SITE("entity uniforms");
 
-      { // Specify Headlight
-        Light light = GetHeadLight(state);
-        glUniform3fv(glGetUniformLocation(this->shader_id, "u_headLight.position"), 1, glm::value_ptr(light.position));
-        glUniform3fv(glGetUniformLocation(this->shader_id, "u_headLight.direction"), 1, glm::value_ptr(light.direction));
-        glUniform3fv(glGetUniformLocation(this->shader_id, "u_headLight.ambient"), 1, glm::value_ptr(light.ambient));
-        glUniform3fv(glGetUniformLocation(this->shader_id, "u_headLight.diffuse"), 1, glm::value_ptr(light.diffuse));
-        glUniform3fv(glGetUniformLocation(this->shader_id, "u_headLight.specular"), 1, glm::value_ptr(light.specular));
+        // Configure the render properties of this instance via shader uniforms.
+        // Properties specific to each instance may include its position, animation step, etc.
 
-        glUniform1f(glGetUniformLocation(this->shader_id, "u_headLight.attenuation"), light.attenuation);
-        glUniform1i(glGetUniformLocation(this->shader_id, "u_headLight.enabled"), light.enabled);
-      }
-    }
+        // Vertex positions are packed, so fold their decoding into the position transforms.
+        glm::mat4 const packedWorldMatrix = worldMatrix * entity.model->mesh->GetPositionMatrix();
+        GLint const worldMatrixLocation = glGetUniformLocation(shader_id, "worldMatrix");
+        glUniformMatrix4fv(worldMatrixLocation, 1, GL_FALSE, glm::value_ptr(packedWorldMatrix));
 
-    // Render the instance's geometry
-    {
-      // Bind the necessary draw state for this model
-      // This state was pre-configured when the Mesh was created.
-      auto& mesh = entity.model->mesh;
-      glBindVertexArray(mesh->vao);
+        GLint const normalMatrixLocation = glGetUniformLocation(shader_id, "normalMatrix");
+        glUniformMatrix3fv(normalMatrixLocation, 1, GL_FALSE, glm::value_ptr(glm::mat3{glm::inverseTranspose(worldMatrix)}));
 
-      // Confirm that the shader has everything it needs to operate.
-      if (!assertShaderValid(this->shader_id)) {
-        // TODO: Throw an exception instead so the environment is cleaned up properly.
-        exit(1);
+        glm::mat4 const mvpMatrix = this->projectionMatrix * viewMatrix * packedWorldMatrix;
+        GLint const mvpMatrixLocation = glGetUniformLocation(shader_id, "mvpMatrix");
+        glUniformMatrix4fv(mvpMatrixLocation, 1, GL_FALSE, glm::value_ptr(mvpMatrix));
+
+        GLint const emissivityLocation = glGetUniformLocation(shader_id, "u_emissivity");
+        glUniform4fv(emissivityLocation, 1, glm::value_ptr(GetEmissivity(*entity.id)));
+      }
+
+      // Render the instance's geometry
+      {
+        // Bind the necessary draw state for this model
+        // This state was pre-configured when the Mesh was created.
+        auto& mesh = entity.model->mesh;
+        glBindVertexArray(mesh->vao);
+
+        // Confirm that the shader has everything it needs to operate.
+        if (!assertShaderValid(shader_id)) {
+          // TODO: Throw an exception instead so the environment is cleaned up properly.
+          exit(1);
+        }
+
+        // Issue a draw task to the GPU, at a level of detail suited to the entity's size on screen
+        GL_DEBUG_SITE("entity draw");
+        MeshLod const& lod = SelectLod(entity.model, viewMatrix, worldMatrix);
+        glDrawElements(mesh->primitiveType, lod.count, GL_UNSIGNED_INT, (GLvoid*)(lod.first * sizeof(GLuint)));
+        ++this->stats.drawCalls;
       }
 
-      // Issue a draw task to the GPU
-      glDrawArrays(mesh->primitiveType, 0, mesh->primitiveCount);
+      popGlDebugGroup();
     }
   }
+  this->gpuProfiler.End(entityZone);
+  popGlDebugGroup();
 
   // Clean up
   glBindVertexArray(GL_NONE);
 
+  // Overlay the HUD
+  if (state.show_hud) {
+    pushGlDebugGroup("HUD");
+    GPU_PROFILE_ZONE(this->gpuProfiler, "GPU HUD");
+    this->hud.Draw(this->viewportSize);
+    ++this->stats.drawCalls;
+    popGlDebugGroup();
+  }
+  this->gpuProfiler.End(frameZone);
+
   // Copy the draw buffer to the screen
-  glfwSwapBuffers(this->window);
+  {
+    PROFILE_ZONE("glfwSwapBuffers");
+    ALLOC_SCOPE_UNCHECKED("glfwSwapBuffers");
+    glfwSwapBuffers(this->window);
+  }
+
+  // Hand the GPU's timings from a few frames ago to the profiler.
+  this->gpuProfiler.EndFrame();
+}
+
+Hud& RenderSystem::GetHud() {
+  return this->hud;
+}
+
+RenderSystem::Stats const& RenderSystem::GetStats() const {
+  return this->stats;
 }
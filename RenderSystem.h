@@ -4,23 +4,98 @@
 // Cross-platform GL context and window toolkit. Handles the boilerplate.
 #include <GLFW/glfw3.h>
 
+#include "AssetRegistry.h"
 #include "GameState.h"
+#include "Hud.h"
+#include "IndirectRenderer.h"
+#include "LightClusters.h"
+#include "StarField.h"
+#include "util/gpuprofile.h"
+
+#include <memory>
+#include <string>
+#include <vector>
 
 class RenderSystem {
+public:
+  // What the last frame drew.
+  struct Stats {
+    unsigned drawCalls = 0;
+    unsigned entities = 0;  // Entities with models
+    unsigned culled = 0;  // Of those, the ones outside the view frustum
+  };
+
+  // What to draw behind everything else.
+  enum class Backdrop {
+    CUBE_MAP,  // The starfield cube map, drawn on a skybox
+    STARS,  // Procedural stars (see StarField.h); loads no cube map at all
+  };
+
 private:
   GLFWwindow* window = nullptr;
-  GLuint shader_id = GL_NONE;  // The ID of the current shader program.
+  // The mainline shader program for each lighting configuration,
+  // indexed by a bitmask of LIGHTING_* flags.
+  static int const LIGHTING_RUBER = 1 << 0;
+  static int const LIGHTING_GLOBAL = 1 << 1;
+  static int const LIGHTING_HEADLIGHT = 1 << 2;
+  static int const LIGHTING_PERMUTATIONS = 1 << 3;
+  GLuint shader_ids[LIGHTING_PERMUTATIONS] = {};
+  // The same, for instances drawn through the GPU-driven path.
+  GLuint indirect_shader_ids[LIGHTING_PERMUTATIONS] = {};
+
+  Backdrop backdrop = Backdrop::CUBE_MAP;
+
   GLuint skybox_shader_id = GL_NONE;  // The ID of the skybox shader.
 
-  Mesh skyboxMesh;
-  GLuint cubeMap = GL_NONE;  // The cube map texture
+  MeshHandle skyboxMesh;
+  TextureHandle cubeMap;  // The starfield cube map
+
+  std::unique_ptr<StarField> starField;  // Null unless the backdrop is STARS
+
+  // Clustered dynamic lights (missile engine glows, silo beacons, ...).
+  // Each cluster's light list lives in a buffer texture; see LightClusters.h.
+  LightClusters clusters;
+  std::vector<ClusterLight> clusterLights;  // Scratch list of this frame's lights
+  GLuint clusterBuffers[3] = {};  // Grid, index, and light data buffers
+  GLuint clusterTextures[3] = {};  // Buffer textures viewing clusterBuffers
+  glm::vec2 clusterTileSize{1.0f};  // Size of a cluster tile in pixels
+
+  glm::vec2 viewportSize{1.0f};  // Size of the framebuffer in pixels
+
+  // GPU-driven culling and submission. Null if the driver lacks GL 4.3.
+  std::unique_ptr<IndirectRenderer> indirect;
+  std::vector<IndirectInstance> indirectInstances;  // Scratch list of this frame's instances
 
   // Transformation from camera space into clip space.
   // This maps all visible content onto the volume of a unit cube centered at the origin.
   glm::mat4 projectionMatrix{1.0f};
 
+  // Times each pass on the GPU, if the profiler is compiled in.
+  GpuProfiler gpuProfiler;
+
+  Hud hud;
+  Stats stats;
+
 public:
-  RenderSystem(GLFWwindow* window, glm::mat4 projectionMatrix);
+  // Queues the backdrop's assets on `registry`; they are ready once the registry finishes.
+  RenderSystem(GLFWwindow* window, glm::mat4 projectionMatrix, AssetRegistry& registry, Backdrop backdrop = Backdrop::CUBE_MAP);
 
   void Render(GameState& state);
+
+  // The performance overlay, drawn over each frame while the game state asks for it.
+  Hud& GetHud();
+
+  Stats const& GetStats() const;
+
+private:
+  static std::vector<std::string> GetLightingDefines(int lighting);
+
+  // Sets the per-frame uniforms shared by every instance drawn with `shader_id`.
+  void SetFrameUniforms(GLuint shader_id, GameState& state, glm::mat4 const& viewMatrix, int lighting);
+
+  // Picks the level of detail to draw the given entity at.
+  MeshLod const& SelectLod(ModelComponent* model, glm::mat4 const& viewMatrix, glm::mat4 const& worldMatrix);
+
+  // Bins this frame's dynamic lights and uploads them for the entity pass.
+  void UpdateClusters(GameState& state, glm::mat4 const& viewMatrix);
 };
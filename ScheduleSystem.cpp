@@ -0,0 +1,86 @@
+#include "ScheduleSystem.h"
+#include "util/alloc.h"
+#include "util/profile.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The longest gap between updates in each tier, in game seconds: every step,
+// then 50 Hz, then 10 Hz.
+static double const TIER_PERIODS[ScheduleSystem::TIER_COUNT] = {0.0, 0.02, 0.1};
+
+// Entities nearer than these distances to whatever matters are in the matching tier.
+static float const TIER_RANGES[ScheduleSystem::TIER_COUNT - 1] = {2000.0f, 6000.0f};
+
+// Updates within a tier are spread over this many offsets.
+static unsigned const STAGGER_COUNT = 8;
+
+// The tier an entity falls into at the given distance from whatever matters most.
+static int GetTier(float distance) {
+  int tier = 0;
+  while (tier < ScheduleSystem::TIER_COUNT - 1 && distance >= TIER_RANGES[tier]) {
+    ++tier;
+  }
+  return tier;
+}
+
+void ScheduleSystem::Update(GameState& state, double delta) {
+  PROFILE_ZONE("ScheduleSystem::Update");
+  ALLOC_SCOPE("ScheduleSystem::Update");
+
+  EntityDatabase& entities = state.entities;
+  glm::vec3 const ship_position = entities.GetWorldPosition("ship");
+  glm::vec3 const camera_position = entities.GetWorldPosition(CAMERAS[state.active_camera]);
+
+  for (size_t& count : this->tierCounts) {
+    count = 0;
+  }
+
+  for (auto& entry : entities.schedules) {
+    ScheduleComponent& schedule = entry.second;
+    if (std::isnan(schedule.updated_time)) {
+      schedule.offset = (double)(this->scheduled++ % STAGGER_COUNT) / STAGGER_COUNT;
+      schedule.updated_time = entities.time - delta;
+    }
+
+    if (schedule.priority >= 0) {
+      schedule.tier = std::min(schedule.priority, TIER_COUNT - 1);
+    } else {
+      glm::vec3 const position = entities.GetWorldPosition(entry.first);
+      float distance = std::min(glm::length(position - ship_position), glm::length(position - camera_position));
+
+      // A missile matters near its target, too, or it could fly through it between updates.
+      auto missileItr = entities.missiles.find(entry.first);
+      if (missileItr != entities.missiles.end() && entities.positions.find(missileItr->second.target) != entities.positions.end()) {
+        distance = std::min(distance, glm::length(position - entities.GetWorldPosition(missileItr->second.target)));
+      }
+
+      schedule.tier = GetTier(distance);
+    }
+    ++this->tierCounts[schedule.tier];
+
+    // Due once the clock crosses into a new period, counted from the entity's offset.
+    double const period = TIER_PERIODS[schedule.tier];
+    schedule.due = (period <= 0.0)
+        || std::floor(entities.time / period + schedule.offset) != std::floor(schedule.updated_time / period + schedule.offset);
+    schedule.elapsed = entities.time - schedule.updated_time;
+    if (schedule.due) {
+      schedule.updated_time = entities.time;
+    }
+  }
+}
+
+bool ScheduleSystem::IsDue(EntityDatabase& entities, std::string const& id, double delta, double* const elapsed) {
+  auto scheduleItr = entities.schedules.find(id);
+  if (scheduleItr == entities.schedules.end()) {
+    *elapsed = delta;
+    return true;
+  }
+
+  *elapsed = scheduleItr->second.elapsed;
+  return scheduleItr->second.due;
+}
+
+size_t ScheduleSystem::GetTierCount(int tier) const {
+  return this->tierCounts[tier];
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "GameState.h"
+
+#include <cstddef>
+#include <string>
+
+// Decides how often each scheduled entity is simulated, by how much it matters
+// to the player, so that distant silos and missiles don't cost as much as ones
+// right next to the ship.
+//
+// Entities with a ScheduleComponent fall into one of TIER_COUNT tiers. Tier 0 is
+// simulated every step; the others at most every TIER_PERIODS[tier] seconds of
+// game time. An entity's tier is its ScheduleComponent's priority, if it has one,
+// or else set by its distance from the ship, the active camera, or (for a missile)
+// its target, whichever is nearest. Updates within a tier are staggered, so that
+// they don't all land on the same step.
+//
+// Run this at the start of each step. Systems then ask IsDue whether to update an
+// entity, and with what delta; that delta is all the time since the entity's last
+// update, so nothing is lost to skipped steps.
+class ScheduleSystem {
+public:
+  static int const TIER_COUNT = 3;
+
+private:
+  size_t tierCounts[TIER_COUNT] = {};
+  unsigned scheduled = 0;  // Entities seen so far, to stagger them
+
+public:
+  void Update(GameState& state, double delta);
+
+  // Whether the given entity is to be updated this step, and if so, the game time
+  // since its last update. Unscheduled entities are updated every step.
+  static bool IsDue(EntityDatabase& entities, std::string const& id, double delta, double* const elapsed);
+
+  // The number of scheduled entities in the given tier, as of the last Update.
+  size_t GetTierCount(int tier) const;
+};
@@ -1,9 +1,19 @@
 #include "SiloSystem.h"
+#include "ScheduleSystem.h"
+#include "util/alloc.h"
+#include "util/profile.h"
 #include <glm/gtc/quaternion.hpp>
+#include <cstdio>
+
+// Missiles get a larger bounding sphere for collision detection.
+static float const MISSILE_COLLISION_PADDING = 10.0f;
+
+// Missiles fall under gravity (see GravitySystem), barely pulling on anything themselves.
+static float const MISSILE_MASS = 0.1f;
 
 // Query result object for interfacing with the EntityDatabase
 struct FiringEntity {
-  std::string id;
+  std::string const* id;  // The entity's key in `positions`
   SiloComponent* silo;
   PositionComponent* position;
 };
@@ -11,7 +21,7 @@ template<>
 struct EntityQuery<FiringEntity> {
   typedef FiringEntity Entity;
 
-  static bool Query(EntityDatabase& entities, std::string id, FiringEntity* const entity) {
+  static bool Query(EntityDatabase& entities, std::string const& id, FiringEntity* const entity) {
     auto siloItr = entities.silos.find(id);
     auto posItr = entities.positions.find(id);
 
@@ -19,33 +29,16 @@ struct EntityQuery<FiringEntity> {
       return false;
     }
 
-    entity->id = id;
+    entity->id = &posItr->first;
     entity->silo = &siloItr->second;
     entity->position = &posItr->second;
     return true;
   }
 };
 
-// Computes the model matrix from the given entity to the world.
-static glm::mat4 GetWorldMatrix(EntityDatabase& entities, std::string const& id) {
-  PositionComponent const& position = entities.positions.at(id);
-
-  glm::mat4 worldMatrix =
-      glm::translate(glm::mat4{1.0f}, position.translation)
-    * glm::mat4_cast(position.orientation);
-
-  PositionComponent const* current = &position;
-  while (entities.positions.find(current->parent) != entities.positions.end()) {
-    current = &entities.positions.at(current->parent);
-    worldMatrix = glm::translate(glm::mat4{1.0f}, current->translation) * worldMatrix;
-  }
-
-  return worldMatrix;
-}
-
 // FireMissile controls missile firing for all silo-enabled entities in the game
 // (including the ship and enemy bases)
-void SiloSystem::FireMissile(GameState& state, std::string owner, targeting_mode targeting, Mesh* missileMesh) {
+void SiloSystem::FireMissile(GameState& state, std::string owner, targeting_mode targeting, MeshHandle const& missileMesh) {
   bool canFire = true;
 
   // check if the silo-enabled entity can fire
@@ -58,11 +51,11 @@ void SiloSystem::FireMissile(GameState& state, std::string owner, targeting_mode
 
   // if the entity can fire a missile, prepare and instantiate a new missile
   if (canFire) {
-    glm::mat4 worldMatrix = GetWorldMatrix(state.entities, owner);
-    std::stringstream tmpMissile;
+    glm::mat4 worldMatrix = state.entities.GetWorldMatrix(owner);
+    char name[64];
+    snprintf(name, sizeof(name), "missile: %s %d", owner.c_str(), state.entities.silos.at(owner).missiles);
+    std::string const newMissile{name};
     glm::quat orientation;
-    tmpMissile << "missile: " << owner << " " << state.entities.silos.at(owner).missiles;
-    std::string newMissile = tmpMissile.str();
     switch (targeting) {
       case SILO_TARGETING: { // a ship missile
         orientation = state.entities.positions.at(owner).orientation;
@@ -93,21 +86,40 @@ void SiloSystem::FireMissile(GameState& state, std::string owner, targeting_mode
       state.entities.silos.at(owner).missile_range,
       state.entities.silos.at(owner).missile_speed,
     }));
-    state.entities.models.insert(std::make_pair(newMissile, ModelComponent{missileMesh}));
+    state.entities.models.insert(std::make_pair(newMissile, ModelComponent{missileMesh, MISSILE_COLLISION_PADDING}));
+    state.entities.masses.insert(std::make_pair(newMissile, MassComponent{MISSILE_MASS}));
+    state.entities.schedules.insert(std::make_pair(newMissile, ScheduleComponent{}));
+
+    // Engine glow, trailing behind the missile
+    state.entities.lights.insert(std::make_pair(newMissile, LightComponent{
+      glm::vec3{0.0f, 0.0f, 40.0f},
+      glm::vec3{1.0f, 0.6f, 0.2f},
+      1.5f,
+      400.0f,
+    }));
   }
 }
 
-void SiloSystem::Update(GameState& state, double /*delta*/) {
+void SiloSystem::Update(GameState& state, double delta) {
+  PROFILE_ZONE("SiloSystem::Update");
+  ALLOC_SCOPE("SiloSystem::Update");
+
   for (auto entity : state.entities.Query<FiringEntity>()) {
+    // Distant silos look for the ship less often.
+    double elapsed = delta;
+    if (!ScheduleSystem::IsDue(state.entities, *entity.id, delta, &elapsed)) {
+      continue;
+    }
+
     // entities with positive ranges are enemy silos
     if (entity.silo->range > 0.0 && !state.entities.silos.at("ship").destroyed) {
       // calculate distance between current silo and warbird
-      auto const silo_position = glm::vec3{GetWorldMatrix(state.entities, entity.id) * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
-      auto const ship_position = glm::vec3{GetWorldMatrix(state.entities, "ship") * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
+      auto const silo_position = glm::vec3{state.entities.GetWorldMatrix(*entity.id) * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
+      auto const ship_position = glm::vec3{state.entities.GetWorldMatrix("ship") * glm::vec4{0.0f, 0.0f, 0.0f, 1.0f}};
       double ship_distance = glm::length(silo_position - ship_position);
       // if the silo is within range, attempt to fire a missile
       if (ship_distance <= entity.silo->range) {
-        FireMissile(state, entity.id, SHIP_TARGETING, this->missileMesh);
+        FireMissile(state, *entity.id, SHIP_TARGETING, *this->missileMesh);
       }
     }
   }
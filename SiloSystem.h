@@ -1,5 +1,6 @@
 #pragma once
 
+#include "AssetHandle.h"
 #include "GameState.h"
 #include "Mesh.h"
 #include <sstream>
@@ -8,13 +9,13 @@
 // detection range of the silo.
 class SiloSystem {
 private:
-   Mesh* missileMesh;
+   MeshHandle const* missileMesh;  // Loaded by the time the first missile flies
 
 public:
-  SiloSystem(Mesh* missileMesh)
+  SiloSystem(MeshHandle const* missileMesh)
     : missileMesh{missileMesh}
   {}
 
   void Update(GameState& state, double delta);
-  static void FireMissile(GameState& state, std::string owner, targeting_mode targeting, Mesh* missileMesh);
+  static void FireMissile(GameState& state, std::string owner, targeting_mode targeting, MeshHandle const& missileMesh);
 };
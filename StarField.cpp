@@ -0,0 +1,161 @@
+#include "StarField.h"
+#include "shaders.h"
+#include "util/debug.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <glm/gtc/type_ptr.hpp>
+#include <random>
+
+// Apparent magnitudes of the brightest and faintest stars generated.
+static float const MAGNITUDE_BRIGHTEST = -1.0f;
+static float const MAGNITUDE_FAINTEST = 6.5f;
+
+// Sprite diameters of the faintest and brightest stars, in pixels.
+static float const SIZE_FAINTEST = 1.5f;
+static float const SIZE_BRIGHTEST = 6.0f;
+
+// Star colors by B-V color index, blue-white to orange.
+struct StarColor {
+  float colorIndex;
+  glm::vec3 rgb;
+};
+static StarColor const STAR_COLORS[] = {
+  {-0.3f, glm::vec3{0.61f, 0.69f, 1.00f}},
+  { 0.0f, glm::vec3{0.79f, 0.84f, 1.00f}},
+  { 0.4f, glm::vec3{1.00f, 0.98f, 0.95f}},
+  { 0.8f, glm::vec3{1.00f, 0.92f, 0.78f}},
+  { 1.2f, glm::vec3{1.00f, 0.82f, 0.60f}},
+  { 1.6f, glm::vec3{1.00f, 0.72f, 0.45f}},
+};
+static size_t const STAR_COLOR_COUNT = sizeof(STAR_COLORS) / sizeof(STAR_COLORS[0]);
+
+// Vertex attributes of shaders/stars-vertex.glsl
+static GLuint const STAR_ATTRIBUTE = 0;
+static GLuint const COLOR_ATTRIBUTE = 1;
+
+// A uniform random number in [0, 1). Built from the generator's raw output, whose
+// sequence the standard fixes, so a seed gives the same sky with any library.
+static float Uniform(std::mt19937& rng) {
+  return (float)(rng() >> 8) * (1.0f / 16777216.0f);
+}
+
+// The color of a star with the given B-V color index.
+static glm::vec3 GetStarColor(float color_index) {
+  if (color_index <= STAR_COLORS[0].colorIndex) {
+    return STAR_COLORS[0].rgb;
+  }
+
+  for (size_t i = 1; i < STAR_COLOR_COUNT; ++i) {
+    StarColor const& lower = STAR_COLORS[i - 1];
+    StarColor const& upper = STAR_COLORS[i];
+    if (color_index <= upper.colorIndex) {
+      float const t = (color_index - lower.colorIndex) / (upper.colorIndex - lower.colorIndex);
+      return lower.rgb + t * (upper.rgb - lower.rgb);
+    }
+  }
+
+  return STAR_COLORS[STAR_COLOR_COUNT - 1].rgb;
+}
+
+std::vector<StarVertex> generateStars(uint32_t seed, size_t count) {
+  std::mt19937 rng{seed};
+  float const pi = 3.14159265358979f;
+
+  // The number of stars brighter than magnitude m grows as 10^(m/2).
+  float const brightest_count = std::pow(10.0f, 0.5f * MAGNITUDE_BRIGHTEST);
+  float const faintest_count = std::pow(10.0f, 0.5f * MAGNITUDE_FAINTEST);
+
+  std::vector<StarVertex> stars;
+  stars.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    // A uniformly random direction: uniform in height along an axis, and in angle around it.
+    float const z = 2.0f * Uniform(rng) - 1.0f;
+    float const phi = 2.0f * pi * Uniform(rng);
+    float const r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+
+    // Invert the count law to draw a magnitude.
+    float const count_below = brightest_count + Uniform(rng) * (faintest_count - brightest_count);
+    float const magnitude = 2.0f * std::log10(count_below);
+    float const brightness = (MAGNITUDE_FAINTEST - magnitude) / (MAGNITUDE_FAINTEST - MAGNITUDE_BRIGHTEST);
+
+    // Color indices are roughly normal around a yellowish white.
+    float const u1 = std::max(Uniform(rng), 1e-7f);
+    float const u2 = Uniform(rng);
+    float const color_index = 0.6f + 0.35f * std::sqrt(-2.0f * std::log(u1)) * std::cos(2.0f * pi * u2);
+    glm::vec3 const rgb = GetStarColor(color_index);
+
+    StarVertex star;
+    star.direction = glm::vec3{r * std::cos(phi), r * std::sin(phi), z};
+    star.size = SIZE_FAINTEST + brightness * (SIZE_BRIGHTEST - SIZE_FAINTEST);
+    star.color[0] = (GLubyte)(255.0f * rgb.r + 0.5f);
+    star.color[1] = (GLubyte)(255.0f * rgb.g + 0.5f);
+    star.color[2] = (GLubyte)(255.0f * rgb.b + 0.5f);
+    star.color[3] = (GLubyte)(255.0f * (0.3f + 0.7f * brightness) + 0.5f);
+    stars.push_back(star);
+  }
+
+  return stars;
+}
+
+StarField::StarField(uint32_t seed, size_t count) {
+  this->program = create_program_from_files("shaders/stars-vertex.glsl", "shaders/stars-fragment.glsl");
+  if (this->program == GL_NONE) {
+    // TODO: Throw an exception instead so the environment is cleaned up properly.
+    exit(1);
+  }
+
+  std::vector<StarVertex> const stars = generateStars(seed, count);
+  this->star_count = (GLsizei)stars.size();
+
+  GL_DEBUG_SITE("star field");
+  glGenVertexArrays(1, &this->vao);
+  glGenBuffers(1, &this->star_buffer);
+  glBindVertexArray(this->vao);
+  glBindBuffer(GL_ARRAY_BUFFER, this->star_buffer);
+  labelGlObject(GL_VERTEX_ARRAY, this->vao, "star field");
+  labelGlObject(GL_BUFFER, this->star_buffer, "star field");
+
+  glBufferData(GL_ARRAY_BUFFER, sizeof(StarVertex) * stars.size(), stars.data(), GL_STATIC_DRAW);
+
+  // Each instance is one star; the quad's corners come from gl_VertexID.
+  glVertexAttribPointer(STAR_ATTRIBUTE, 4, GL_FLOAT, GL_FALSE, sizeof(StarVertex), (GLvoid*)offsetof(StarVertex, direction));
+  glVertexAttribDivisor(STAR_ATTRIBUTE, 1);
+  glEnableVertexAttribArray(STAR_ATTRIBUTE);
+  glVertexAttribPointer(COLOR_ATTRIBUTE, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(StarVertex), (GLvoid*)offsetof(StarVertex, color));
+  glVertexAttribDivisor(COLOR_ATTRIBUTE, 1);
+  glEnableVertexAttribArray(COLOR_ATTRIBUTE);
+
+  glBindVertexArray(GL_NONE);
+  glBindBuffer(GL_ARRAY_BUFFER, GL_NONE);
+}
+
+StarField::~StarField() {
+  glDeleteProgram(this->program);
+  glDeleteVertexArrays(1, &this->vao);
+  glDeleteBuffers(1, &this->star_buffer);
+}
+
+void StarField::Draw(glm::mat4 const& skyMatrix, glm::vec2 viewportSize) {
+  GL_DEBUG_SITE("star field");
+  glUseProgram(this->program);
+  glUniformMatrix4fv(glGetUniformLocation(this->program, "u_skyMatrix"), 1, GL_FALSE, glm::value_ptr(skyMatrix));
+  glm::vec2 const pixelSize{2.0f / viewportSize.x, 2.0f / viewportSize.y};
+  glUniform2fv(glGetUniformLocation(this->program, "u_pixelSize"), 1, glm::value_ptr(pixelSize));
+
+  // The stars lie on the far plane, where the depth test would reject them, and
+  // overlapping sprites add up.
+  glDisable(GL_DEPTH_TEST);
+  glDepthMask(GL_FALSE);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE);
+
+  glBindVertexArray(this->vao);
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, this->star_count);
+  glBindVertexArray(GL_NONE);
+
+  glDisable(GL_BLEND);
+  glDepthMask(GL_TRUE);
+  glEnable(GL_DEPTH_TEST);
+}
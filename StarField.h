@@ -0,0 +1,51 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A mirror of the per-instance attributes of shaders/stars-vertex.glsl.
+struct StarVertex {
+  glm::vec3 direction;  // Unit vector towards the star
+  float size;  // Diameter of the star's sprite, in pixels
+  GLubyte color[4];  // RGB, and brightness in alpha
+};
+
+// Generates `count` stars, scattered uniformly over the sky. The same seed always
+// gives the same sky.
+//
+// Apparent magnitudes follow the usual count law, in which each magnitude fainter
+// holds about three times as many stars as the last, so most stars are faint
+// specks and a few are bright. Brighter stars are drawn larger. Colors range from
+// blue-white to orange, mostly near white and yellow.
+std::vector<StarVertex> generateStars(uint32_t seed, size_t count);
+
+// A procedural starfield, for a backdrop that costs a few hundred kilobytes rather
+// than a cube map's megabytes.
+//
+// The stars sit at infinity, so they turn with the camera but never move. Each is
+// drawn as an instanced, camera-facing quad (rather than a GL point, whose size
+// drivers may clamp) shaded as a soft disc, and blended additively.
+class StarField {
+private:
+  GLuint program = GL_NONE;
+  GLuint vao = GL_NONE;
+  GLuint star_buffer = GL_NONE;  // StarVertex per star
+  GLsizei star_count = 0;
+
+public:
+  StarField(uint32_t seed, size_t count);
+  ~StarField();
+
+  StarField(StarField const&) = delete;
+  StarField& operator=(StarField const&) = delete;
+
+  // Draws the stars behind everything else; call before anything else is drawn.
+  // `skyMatrix` takes directions to clip space: the projection times the rotation
+  // of the view, without its translation.
+  void Draw(glm::mat4 const& skyMatrix, glm::vec2 viewportSize);
+};
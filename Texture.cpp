@@ -1,5 +1,13 @@
 #include "Texture.h"
+#include "util/debug.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 /* Based on example code developed by Mike Barnes (11/5/2013)
 
@@ -14,37 +22,72 @@ void freeTexture(GLuint texture) {
   glDeleteTextures(1, &texture);
 }
 
-GLuint loadRawTexture(GLuint texture, const char* filename, int width, int height) {
-  unsigned char* data;
-  FILE* file;
-  int readResult;
-
-  // open texture data
-  file = fopen(filename, "rb");
-  if (file == NULL) {
-     printf("File %s can't be opened\n", filename);
-     return 0;
+Texture::~Texture() {
+  freeTexture(this->id);
+}
+
+MappedRawFile::~MappedRawFile() {
+  if (this->mapping) {
+    munmap(this->mapping, this->size);
   }
-  // allocate buffer -- 3 bytes / texel -- rgb
-  data = (unsigned char*) malloc(width * height * 3);
-  // read texture data
-  readResult = fread(data, width * height * 3, 1, file);
-  if (readResult != 1) {
-     printf("File %s was not read correctly\n", filename);
-     return 0;
+}
+
+bool MappedRawFile::Open(char const* filename, int width, int height) {
+  int const fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    printf("file %s can't be opened!\n", filename);
+    return false;
+  }
+
+  struct stat info;
+  size_t const bytes = 3 * (size_t)width * (size_t)height;
+  if (fstat(fd, &info) != 0 || (size_t)info.st_size < bytes) {
+    printf("File %s was not read correctly!\n", filename);
+    close(fd);
+    return false;
+  }
+
+  // The mapping keeps the file alive after the descriptor is closed.
+  void* const mapping = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    printf("File %s was not read correctly!\n", filename);
+    return false;
+  }
+
+  // Start reading the whole image in now; it'll all be wanted shortly.
+  madvise(mapping, bytes, MADV_WILLNEED);
+
+  this->mapping = mapping;
+  this->size = bytes;
+  return true;
+}
+
+unsigned char const* MappedRawFile::GetData() const {
+  return static_cast<unsigned char const*>(this->mapping);
+}
+
+size_t MappedRawFile::GetSize() const {
+  return this->size;
+}
+
+GLuint loadRawTexture(GLuint texture, const char* filename, int width, int height) {
+  unsigned char* const data = loadRawData(filename, width, height);
+  if (!data) {
+    return 0;
   }
-  fclose(file);
 
   glGenTextures(1, &texture); // generate the texture with the loaded data
   glBindTexture(GL_TEXTURE_2D, texture); // bind the texture
-  glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE); // set texture environment parameters
   // set texture parameters
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-  // generate the texture
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  // generate the texture; .RAW rows are tightly packed
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
   free(data); // free temp memory location
   return texture; // return whether it was successful
 }
@@ -61,6 +104,7 @@ unsigned char* loadRawData(const char* filename, int width, int height) {
   unsigned char* data = (unsigned char*)malloc(width * height * 3);
   if (fread(data, width * height * 3, 1, file) != 1) {
     printf("File %s was not read correctly!\n", filename);
+    free(data);
     data = nullptr;
   }
 
@@ -71,12 +115,21 @@ unsigned char* loadRawData(const char* filename, int width, int height) {
 GLuint makeCubeMap(unsigned char* texData[6], int edge) {
   // creates cube map texture object and initializes it with image data in
   // passed-in array; edge is number of pixels in each edge of cube
+  GLuint const texture = createCubeMap(edge);
+  for (int face = 0; face < 6; face++) {
+    uploadCubeMapFace(texture, face, texData[face], edge);
+  }
+  return texture;
+}
 
+GLuint createCubeMap(int edge) {
   // set cube map texture parameters
   GLuint texture = GL_NONE;
+  GL_DEBUG_SITE("cube map");
   glGenTextures(1, &texture);
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_CUBE_MAP, texture); // bind the texture
+  labelGlObject(GL_TEXTURE, texture, "cube map");
 
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -86,7 +139,7 @@ GLuint makeCubeMap(unsigned char* texData[6], int edge) {
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
 
-  // place texture data into cube map's texel array
+  // allocate each face's texel array, to be filled in later
   for (int face = 0; face < 6; face++) {
     GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
     glTexImage2D(
@@ -97,10 +150,110 @@ GLuint makeCubeMap(unsigned char* texData[6], int edge) {
       0,                // must be zero!
       GL_RGB,           // format
       GL_UNSIGNED_BYTE, // type
-      texData[face]     // image data
+      nullptr           // no image data yet
     );
   }
 
   glBindTexture(GL_TEXTURE_CUBE_MAP, GL_NONE);
   return texture;
 }
+
+void uploadCubeMapFace(GLuint texture, int face, unsigned char const* data, int edge) {
+  if (!data) {
+    return;  // The face failed to load, and was already reported
+  }
+
+  GL_DEBUG_SITE("cube map face");
+  glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+
+  // .RAW rows are tightly packed, and 3*edge need not be a multiple of 4.
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, 0, 0, edge, edge, GL_RGB, GL_UNSIGNED_BYTE, data);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  glBindTexture(GL_TEXTURE_CUBE_MAP, GL_NONE);
+}
+
+bool isTextureCompressionSupported() {
+  char const* setting = getenv("COMP465_TEXTURE_COMPRESSION");
+  if (setting && strcmp(setting, "0") == 0) {
+    return false;
+  }
+
+  return GLEW_EXT_texture_compression_s3tc;
+}
+
+bool readCompressedTexture(char const* raw_path, int width, int height, LoadedTexture* const loaded) {
+  // Prefer the converted texture, which is already compressed.
+  std::string const texture_path = getTextureFilePath(raw_path);
+  if (isTextureFileCurrent(texture_path.c_str(), raw_path)) {
+    std::unique_ptr<MappedTextureFile> file{new MappedTextureFile{}};
+    if (file->Open(texture_path.c_str(), width, height)) {
+      loaded->file = std::move(file);
+      return true;
+    }
+  }
+
+  // Otherwise, compress the source image, and keep the result for next time.
+  loaded->file.reset();
+  unsigned char* const rgb = loadRawData(raw_path, width, height);
+  if (!rgb) {
+    return false;
+  }
+  buildTextureData(rgb, width, height, &loaded->data);
+  free(rgb);
+
+  // If the cache can't be written, we'll just compress again next time.
+  writeTextureFile(texture_path.c_str(), loaded->data);
+  return true;
+}
+
+GLuint createCompressedCubeMap(int edge) {
+  GLuint texture = GL_NONE;
+  GL_DEBUG_SITE("compressed cube map");
+  glGenTextures(1, &texture);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+  labelGlObject(GL_TEXTURE, texture, "compressed cube map");
+
+  // Sample from the mip chain, so that distant stars shimmer less and read less memory.
+  int const level_count = std::min(getTextureLevelCount(edge, edge), TEXTURE_MAX_LEVELS);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, level_count - 1);
+
+  // allocate each level of each face, to be filled in later
+  for (int face = 0; face < 6; ++face) {
+    for (int level = 0; level < level_count; ++level) {
+      int const level_edge = getTextureLevelSize(edge, level);
+      glCompressedTexImage2D(
+        GL_TEXTURE_CUBE_MAP_POSITIVE_X + face,
+        level,
+        TEXTURE_COMPRESSED_FORMAT,
+        level_edge, level_edge,
+        0,
+        (GLsizei)getCompressedImageBytes(level_edge, level_edge),
+        nullptr  // no image data yet
+      );
+    }
+  }
+
+  glBindTexture(GL_TEXTURE_CUBE_MAP, GL_NONE);
+  return texture;
+}
+
+unsigned char const* getLoadedTextureLevel(LoadedTexture const& loaded, int level) {
+  if (loaded.file) {
+    return static_cast<unsigned char const*>(loaded.file->GetLevel(level));
+  } else {
+    return loaded.data.levels[level].data();
+  }
+}
+
+int getLoadedTextureLevelCount(LoadedTexture const& loaded) {
+  return loaded.file ? (int)loaded.file->GetHeader().level_count : (int)loaded.data.levels.size();
+}
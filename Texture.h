@@ -1,6 +1,49 @@
 #pragma once
 
 #include <GL/glew.h>
+#include <cstddef>
+#include <memory>
+
+#include "TextureData.h"
+#include "TextureFile.h"
+
+// A GL texture object, deleted along with this.
+struct Texture {
+  GLuint id = GL_NONE;
+  GLenum target = GL_TEXTURE_2D;  // What the texture binds to
+  size_t bytes = 0;  // GPU memory held by the texture's images
+
+  Texture(GLuint id, GLenum target, size_t bytes)
+    : id{id}, target{target}, bytes{bytes}
+  {}
+
+  ~Texture();
+
+  /* Disable copy semantics for this type. */
+  Texture(Texture const&) = delete;
+  Texture& operator=(Texture const&) = delete;
+};
+
+// A .RAW image file (tightly-packed 24-bit RGB), mapped read-only into memory.
+class MappedRawFile {
+private:
+  void* mapping = nullptr;
+  size_t size = 0;
+
+public:
+  MappedRawFile() {}
+  ~MappedRawFile();
+
+  MappedRawFile(MappedRawFile const&) = delete;
+  MappedRawFile& operator=(MappedRawFile const&) = delete;
+
+  // Maps the given file, which must hold at least `width` x `height` pixels.
+  // Returns false (and reports the problem) if it can't.
+  bool Open(char const* filename, int width, int height);
+
+  unsigned char const* GetData() const;
+  size_t GetSize() const;
+};
 
 void freeTexture(GLuint texture);
 
@@ -9,3 +52,37 @@ GLuint loadRawTexture(GLuint texture, const char* filename, int width, int heigh
 unsigned char* loadRawData(const char* filename, int width, int height);
 
 GLuint makeCubeMap(unsigned char* texData[6], int edge);
+
+// Creates a cube map with room for six RGB faces of `edge` pixels square, for
+// filling in one face at a time with uploadCubeMapFace.
+GLuint createCubeMap(int edge);
+
+// Fills in one face (0 through 5, in GL_TEXTURE_CUBE_MAP_POSITIVE_X order) of a cube map.
+void uploadCubeMapFace(GLuint texture, int face, unsigned char const* data, int edge);
+
+// An image read from the filesystem, but not yet uploaded to the GPU: either a
+// mapped .tex conversion, or compressed from the source image just now.
+struct LoadedTexture {
+  std::unique_ptr<MappedTextureFile> file;  // Null if the source image was compressed instead
+  TextureData data;
+};
+
+// Whether to use BC1-compressed textures: the driver must support
+// EXT_texture_compression_s3tc, and COMP465_TEXTURE_COMPRESSION must not be 0.
+bool isTextureCompressionSupported();
+
+// Reads a .RAW image of the given size as a compressed mip chain (see TextureData.h).
+// If a current .tex conversion of the image sits next to it, that is loaded instead;
+// otherwise the image is compressed now, and the result is saved there for next time.
+// Makes no GL calls, so it may run on any thread.
+bool readCompressedTexture(char const* raw_path, int width, int height, LoadedTexture* const loaded);
+
+// The compressed blocks of one mip level of a loaded texture.
+unsigned char const* getLoadedTextureLevel(LoadedTexture const& loaded, int level);
+
+// The number of mip levels of a loaded texture; zero if it failed to load.
+int getLoadedTextureLevelCount(LoadedTexture const& loaded);
+
+// Creates a cube map with room for six compressed faces of `edge` pixels square,
+// with full mip chains, for filling in with glCompressedTexSubImage2D.
+GLuint createCompressedCubeMap(int edge);
@@ -0,0 +1,356 @@
+#include "TextureData.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Pixels in a compressed block.
+static int const BLOCK_PIXELS = TEXTURE_BLOCK_EDGE * TEXTURE_BLOCK_EDGE;
+
+// Rounds a color (on [0, 255]) to RGB565.
+static uint16_t PackColor(glm::vec3 const& color) {
+  glm::vec3 const clamped = glm::clamp(color, 0.0f, 255.0f);
+  uint16_t const r = (uint16_t)std::lround(clamped.r * 31.0f / 255.0f);
+  uint16_t const g = (uint16_t)std::lround(clamped.g * 63.0f / 255.0f);
+  uint16_t const b = (uint16_t)std::lround(clamped.b * 31.0f / 255.0f);
+  return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+// Expands an RGB565 color to [0, 255], as the GPU does.
+static glm::vec3 UnpackColor(uint16_t packed) {
+  int const r = (packed >> 11) & 0x1F;
+  int const g = (packed >> 5) & 0x3F;
+  int const b = packed & 0x1F;
+  return glm::vec3{(float)((r << 3) | (r >> 2)), (float)((g << 2) | (g >> 4)), (float)((b << 3) | (b >> 2))};
+}
+
+// The four colors a block can pick from, given its endpoints (in four-color mode, c0 > c1).
+static void GetPalette(uint16_t c0, uint16_t c1, glm::vec3 palette[4]) {
+  palette[0] = UnpackColor(c0);
+  palette[1] = UnpackColor(c1);
+  if (c0 > c1) {
+    palette[2] = (2.0f*palette[0] + palette[1]) / 3.0f;
+    palette[3] = (palette[0] + 2.0f*palette[1]) / 3.0f;
+  } else {
+    palette[2] = 0.5f * (palette[0] + palette[1]);
+    palette[3] = glm::vec3{0.0f};
+  }
+}
+
+static float SquaredDistance(glm::vec3 const& a, glm::vec3 const& b) {
+  glm::vec3 const d = a - b;
+  return glm::dot(d, d);
+}
+
+// Picks the nearest palette entry for each pixel, and returns the total squared error.
+static float ChooseIndices(glm::vec3 const pixels[BLOCK_PIXELS], uint16_t c0, uint16_t c1, int indices[BLOCK_PIXELS]) {
+  glm::vec3 palette[4];
+  GetPalette(c0, c1, palette);
+
+  float error = 0.0f;
+  for (int i = 0; i < BLOCK_PIXELS; ++i) {
+    int best = 0;
+    float best_error = SquaredDistance(pixels[i], palette[0]);
+    for (int entry = 1; entry < 4; ++entry) {
+      float const entry_error = SquaredDistance(pixels[i], palette[entry]);
+      if (entry_error < best_error) {
+        best = entry;
+        best_error = entry_error;
+      }
+    }
+    indices[i] = best;
+    error += best_error;
+  }
+  return error;
+}
+
+// Orders a pair of endpoints for four-color mode.
+static void OrderEndpoints(uint16_t* const c0, uint16_t* const c1) {
+  if (*c0 < *c1) {
+    std::swap(*c0, *c1);
+  }
+}
+
+// Finds the endpoints which best fit the pixels for the given choice of indices, by least squares.
+// Returns false if the indices don't pin the endpoints down (every pixel picked the same weight).
+static bool RefitEndpoints(glm::vec3 const pixels[BLOCK_PIXELS], int const indices[BLOCK_PIXELS], glm::vec3* const e0, glm::vec3* const e1) {
+  // How much of the first endpoint each four-color palette entry holds.
+  static float const WEIGHTS[4] = {1.0f, 0.0f, 2.0f/3.0f, 1.0f/3.0f};
+
+  float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+  glm::vec3 ax{0.0f}, bx{0.0f};
+  for (int i = 0; i < BLOCK_PIXELS; ++i) {
+    float const a = WEIGHTS[indices[i]];
+    float const b = 1.0f - a;
+    aa += a*a;
+    ab += a*b;
+    bb += b*b;
+    ax += a * pixels[i];
+    bx += b * pixels[i];
+  }
+
+  float const determinant = aa*bb - ab*ab;
+  if (std::abs(determinant) < 1e-6f) {
+    return false;
+  }
+
+  *e0 = (bb*ax - ab*bx) / determinant;
+  *e1 = (aa*bx - ab*ax) / determinant;
+  return true;
+}
+
+// Compresses one block of pixels into 8 bytes.
+//
+// The endpoints start at the extremes of the pixels along their principal axis,
+// then are refit by least squares to the indices that they pick.
+static void CompressBlock(glm::vec3 const pixels[BLOCK_PIXELS], unsigned char* const block) {
+  glm::vec3 mean{0.0f};
+  glm::vec3 min = pixels[0];
+  glm::vec3 max = pixels[0];
+  for (int i = 0; i < BLOCK_PIXELS; ++i) {
+    mean += pixels[i];
+    min = glm::min(min, pixels[i]);
+    max = glm::max(max, pixels[i]);
+  }
+  mean /= (float)BLOCK_PIXELS;
+
+  uint16_t c0 = PackColor(max);
+  uint16_t c1 = PackColor(min);
+  int indices[BLOCK_PIXELS] = {};
+
+  if (c0 == c1) {
+    // A flat block (most of a starfield is black): every pixel takes the first endpoint.
+  } else {
+    // Find the principal axis of the pixels by power iteration on their covariance,
+    // starting from the diagonal of their bounding box.
+    float cov[6] = {};  // xx, xy, xz, yy, yz, zz
+    for (int i = 0; i < BLOCK_PIXELS; ++i) {
+      glm::vec3 const d = pixels[i] - mean;
+      cov[0] += d.x*d.x;
+      cov[1] += d.x*d.y;
+      cov[2] += d.x*d.z;
+      cov[3] += d.y*d.y;
+      cov[4] += d.y*d.z;
+      cov[5] += d.z*d.z;
+    }
+
+    glm::vec3 axis = max - min;
+    for (int iteration = 0; iteration < 8; ++iteration) {
+      glm::vec3 const next{
+        cov[0]*axis.x + cov[1]*axis.y + cov[2]*axis.z,
+        cov[1]*axis.x + cov[3]*axis.y + cov[4]*axis.z,
+        cov[2]*axis.x + cov[4]*axis.y + cov[5]*axis.z,
+      };
+      float const length = glm::length(next);
+      if (length < 1e-6f) {
+        break;
+      }
+      axis = next / length;
+    }
+
+    // Start from the pixels furthest along each way of the axis.
+    int lowest = 0;
+    int highest = 0;
+    for (int i = 1; i < BLOCK_PIXELS; ++i) {
+      float const t = glm::dot(pixels[i] - mean, axis);
+      if (t < glm::dot(pixels[lowest] - mean, axis)) {
+        lowest = i;
+      }
+      if (t > glm::dot(pixels[highest] - mean, axis)) {
+        highest = i;
+      }
+    }
+    c0 = PackColor(pixels[highest]);
+    c1 = PackColor(pixels[lowest]);
+    OrderEndpoints(&c0, &c1);
+
+    if (c0 != c1) {
+      float error = ChooseIndices(pixels, c0, c1, indices);
+
+      // Refine once by least squares, keeping the result only if it's better.
+      glm::vec3 e0, e1;
+      if (RefitEndpoints(pixels, indices, &e0, &e1)) {
+        uint16_t r0 = PackColor(e0);
+        uint16_t r1 = PackColor(e1);
+        OrderEndpoints(&r0, &r1);
+        if (r0 != r1) {
+          int refit_indices[BLOCK_PIXELS];
+          float const refit_error = ChooseIndices(pixels, r0, r1, refit_indices);
+          if (refit_error < error) {
+            c0 = r0;
+            c1 = r1;
+            std::copy(refit_indices, refit_indices + BLOCK_PIXELS, indices);
+          }
+        }
+      }
+    }
+  }
+
+  uint32_t bits = 0;
+  for (int i = 0; i < BLOCK_PIXELS; ++i) {
+    bits |= (uint32_t)indices[i] << (2*i);
+  }
+
+  // Everything is stored little-endian.
+  block[0] = (unsigned char)(c0 & 0xFF);
+  block[1] = (unsigned char)(c0 >> 8);
+  block[2] = (unsigned char)(c1 & 0xFF);
+  block[3] = (unsigned char)(c1 >> 8);
+  for (int byte = 0; byte < 4; ++byte) {
+    block[4 + byte] = (unsigned char)(bits >> (8*byte));
+  }
+}
+
+int getTextureLevelCount(int width, int height) {
+  int levels = 1;
+  for (int size = std::max(width, height); size > 1; size /= 2) {
+    levels += 1;
+  }
+  return levels;
+}
+
+int getTextureLevelSize(int size, int level) {
+  return std::max(size >> level, 1);
+}
+
+size_t getCompressedImageBytes(int width, int height) {
+  size_t const blocks_x = (width + TEXTURE_BLOCK_EDGE - 1) / TEXTURE_BLOCK_EDGE;
+  size_t const blocks_y = (height + TEXTURE_BLOCK_EDGE - 1) / TEXTURE_BLOCK_EDGE;
+  return blocks_x * blocks_y * TEXTURE_BLOCK_BYTES;
+}
+
+size_t getCompressedTextureBytes(int width, int height) {
+  int const level_count = std::min(getTextureLevelCount(width, height), TEXTURE_MAX_LEVELS);
+
+  size_t bytes = 0;
+  for (int level = 0; level < level_count; ++level) {
+    bytes += getCompressedImageBytes(getTextureLevelSize(width, level), getTextureLevelSize(height, level));
+  }
+  return bytes;
+}
+
+void compressImage(unsigned char const* rgb, int width, int height, unsigned char* const blocks) {
+  int const blocks_x = (width + TEXTURE_BLOCK_EDGE - 1) / TEXTURE_BLOCK_EDGE;
+  int const blocks_y = (height + TEXTURE_BLOCK_EDGE - 1) / TEXTURE_BLOCK_EDGE;
+
+  for (int by = 0; by < blocks_y; ++by) {
+    for (int bx = 0; bx < blocks_x; ++bx) {
+      glm::vec3 pixels[BLOCK_PIXELS];
+      for (int y = 0; y < TEXTURE_BLOCK_EDGE; ++y) {
+        for (int x = 0; x < TEXTURE_BLOCK_EDGE; ++x) {
+          int const px = std::min(bx*TEXTURE_BLOCK_EDGE + x, width - 1);
+          int const py = std::min(by*TEXTURE_BLOCK_EDGE + y, height - 1);
+          unsigned char const* const pixel = rgb + 3*((size_t)py*width + px);
+          pixels[y*TEXTURE_BLOCK_EDGE + x] = glm::vec3{(float)pixel[0], (float)pixel[1], (float)pixel[2]};
+        }
+      }
+
+      CompressBlock(pixels, blocks + ((size_t)by*blocks_x + bx) * TEXTURE_BLOCK_BYTES);
+    }
+  }
+}
+
+void decompressImage(unsigned char const* blocks, int width, int height, unsigned char* const rgb) {
+  int const blocks_x = (width + TEXTURE_BLOCK_EDGE - 1) / TEXTURE_BLOCK_EDGE;
+  int const blocks_y = (height + TEXTURE_BLOCK_EDGE - 1) / TEXTURE_BLOCK_EDGE;
+
+  for (int by = 0; by < blocks_y; ++by) {
+    for (int bx = 0; bx < blocks_x; ++bx) {
+      unsigned char const* const block = blocks + ((size_t)by*blocks_x + bx) * TEXTURE_BLOCK_BYTES;
+      uint16_t const c0 = (uint16_t)(block[0] | (block[1] << 8));
+      uint16_t const c1 = (uint16_t)(block[2] | (block[3] << 8));
+      uint32_t const bits = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+
+      glm::vec3 palette[4];
+      GetPalette(c0, c1, palette);
+
+      for (int y = 0; y < TEXTURE_BLOCK_EDGE; ++y) {
+        for (int x = 0; x < TEXTURE_BLOCK_EDGE; ++x) {
+          int const px = bx*TEXTURE_BLOCK_EDGE + x;
+          int const py = by*TEXTURE_BLOCK_EDGE + y;
+          if (px >= width || py >= height) {
+            continue;
+          }
+
+          glm::vec3 const& color = palette[(bits >> (2*(y*TEXTURE_BLOCK_EDGE + x))) & 3];
+          unsigned char* const pixel = rgb + 3*((size_t)py*width + px);
+          for (int channel = 0; channel < 3; ++channel) {
+            pixel[channel] = (unsigned char)std::lround(color[channel]);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Halves an image, averaging each 2x2 box of pixels. An odd last row or column
+// is folded into the box before it.
+static void Downsample(std::vector<unsigned char> const& source, int width, int height, std::vector<unsigned char>* const result) {
+  int const result_width = std::max(width / 2, 1);
+  int const result_height = std::max(height / 2, 1);
+  result->assign(3 * (size_t)result_width * result_height, 0);
+
+  for (int y = 0; y < result_height; ++y) {
+    int const y0 = std::min(2*y, height - 1);
+    int const y1 = (y == result_height - 1) ? height - 1 : std::min(2*y + 1, height - 1);
+    for (int x = 0; x < result_width; ++x) {
+      int const x0 = std::min(2*x, width - 1);
+      int const x1 = (x == result_width - 1) ? width - 1 : std::min(2*x + 1, width - 1);
+
+      for (int channel = 0; channel < 3; ++channel) {
+        unsigned sum = 0;
+        unsigned count = 0;
+        for (int sy = y0; sy <= y1; ++sy) {
+          for (int sx = x0; sx <= x1; ++sx) {
+            sum += source[3*((size_t)sy*width + sx) + channel];
+            count += 1;
+          }
+        }
+        (*result)[3*((size_t)y*result_width + x) + channel] = (unsigned char)((sum + count/2) / count);
+      }
+    }
+  }
+}
+
+void buildTextureData(unsigned char const* rgb, int width, int height, TextureData* const data, TextureReport* const report) {
+  int const level_count = std::min(getTextureLevelCount(width, height), TEXTURE_MAX_LEVELS);
+
+  data->format = TEXTURE_COMPRESSED_FORMAT;
+  data->width = width;
+  data->height = height;
+  data->levels.resize(level_count);
+
+  std::vector<unsigned char> image{rgb, rgb + 3 * (size_t)width * height};
+  std::vector<unsigned char> next;
+  for (int level = 0; level < level_count; ++level) {
+    int const level_width = getTextureLevelSize(width, level);
+    int const level_height = getTextureLevelSize(height, level);
+
+    data->levels[level].resize(getCompressedImageBytes(level_width, level_height));
+    compressImage(image.data(), level_width, level_height, data->levels[level].data());
+
+    if (level + 1 < level_count) {
+      Downsample(image, level_width, level_height, &next);
+      image.swap(next);
+    }
+  }
+
+  if (report) {
+    report->sourceBytes = 3 * (size_t)width * height;
+    report->compressedBytes = 0;
+    for (auto const& level : data->levels) {
+      report->compressedBytes += level.size();
+    }
+
+    std::vector<unsigned char> decoded(3 * (size_t)width * height);
+    decompressImage(data->levels[0].data(), width, height, decoded.data());
+    double squared_error = 0.0;
+    for (size_t i = 0; i < decoded.size(); ++i) {
+      double const difference = (double)decoded[i] - rgb[i];
+      squared_error += difference * difference;
+    }
+    double const mse = squared_error / std::max(decoded.size(), (size_t)1);
+    report->psnr = (mse > 0.0) ? (float)(10.0 * std::log10(255.0*255.0 / mse)) : INFINITY;
+  }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+// Images are stored on the GPU block-compressed as BC1 (S3TC's DXT1): every 4x4 block
+// of pixels is two RGB565 endpoint colors and a 2-bit index per pixel choosing
+// between them and two colors in between, 8 bytes in all. That's a sixth of the
+// size of 24-bit RGB (or an eighth, as drivers pad RGB out to 32 bits), and
+// decompression is free in the texture units.
+static GLenum const TEXTURE_COMPRESSED_FORMAT = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+static int const TEXTURE_BLOCK_EDGE = 4;  // Pixels on a side of a compressed block
+static size_t const TEXTURE_BLOCK_BYTES = 8;
+
+// Mip chains never have more levels than this (enough for a 32768-pixel image).
+static int const TEXTURE_MAX_LEVELS = 16;
+
+// A BC1-compressed image with its full mip chain.
+struct TextureData {
+  GLenum format = TEXTURE_COMPRESSED_FORMAT;
+  int width = 0;  // Of level 0
+  int height = 0;
+
+  // Compressed blocks of each level, from full size (levels[0]) down to 1x1.
+  // Each level halves the size of the last, rounding down.
+  std::vector<std::vector<unsigned char>> levels;
+};
+
+// Statistics about a compressed image, as built by buildTextureData.
+struct TextureReport {
+  size_t sourceBytes;  // Of the uncompressed level 0
+  size_t compressedBytes;  // Of every level
+  float psnr;  // Peak signal-to-noise ratio of the compressed level 0, in dB
+};
+
+// The number of levels in a full mip chain for an image of the given size.
+int getTextureLevelCount(int width, int height);
+
+// The size of a mip level, given the size of level 0.
+int getTextureLevelSize(int size, int level);
+
+// The bytes of BC1 blocks covering an image of the given size.
+size_t getCompressedImageBytes(int width, int height);
+
+// The bytes of BC1 blocks covering every level of a full mip chain.
+size_t getCompressedTextureBytes(int width, int height);
+
+// Compresses tightly-packed 24-bit RGB pixels into BC1 blocks, row by row of blocks.
+// Edges which aren't a multiple of the block size are padded by repeating the last pixel.
+void compressImage(unsigned char const* rgb, int width, int height, unsigned char* const blocks);
+
+// Decompresses BC1 blocks back into tightly-packed 24-bit RGB pixels.
+void decompressImage(unsigned char const* blocks, int width, int height, unsigned char* const rgb);
+
+// Builds a full mip chain from tightly-packed 24-bit RGB pixels, box filtering
+// each level down from the last, and compresses every level.
+// Optionally reports how large and how faithful the result is.
+void buildTextureData(unsigned char const* rgb, int width, int height, TextureData* const data, TextureReport* const report = nullptr);
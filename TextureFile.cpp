@@ -0,0 +1,181 @@
+#include "TextureFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Each level's blocks start on a boundary of this many bytes.
+static uint32_t const DATA_ALIGNMENT = 16;
+
+static uint32_t Align(uint32_t offset) {
+  return (offset + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+}
+
+bool writeTextureFile(char const* texture_path, TextureData const& data) {
+  if (data.levels.empty() || data.levels.size() > (size_t)TEXTURE_MAX_LEVELS) {
+    fprintf(stderr, "'%s': bad mip level count (%u).\n", texture_path, (unsigned)data.levels.size());
+    return false;
+  }
+
+  TextureFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TEXTURE_FILE_MAGIC, sizeof(header.magic));
+  header.version = TEXTURE_FILE_VERSION;
+  header.format = data.format;
+  header.width = (uint32_t)data.width;
+  header.height = (uint32_t)data.height;
+
+  header.level_count = (uint32_t)data.levels.size();
+  uint32_t offset = sizeof(header);
+  for (size_t level = 0; level < data.levels.size(); ++level) {
+    offset = Align(offset);
+    header.levels[level] = TextureFileLevel{offset, (uint32_t)data.levels[level].size()};
+    offset += header.levels[level].bytes;
+  }
+
+  // Write to a temporary file first, so that no reader ever maps a partial file.
+  std::string const temp_path = std::string{texture_path} + ".tmp";
+  FILE* f = fopen(temp_path.c_str(), "wb");
+  if (!f) {
+    fprintf(stderr, "Unable to open file '%s'.\n", temp_path.c_str());
+    return false;
+  }
+
+  static char const padding[DATA_ALIGNMENT] = {};
+  bool written = fwrite(&header, sizeof(header), 1, f) == 1;
+  uint32_t end = sizeof(header);
+  for (size_t level = 0; level < data.levels.size() && written; ++level) {
+    size_t const level_padding = header.levels[level].offset - end;
+    written =
+         fwrite(padding, 1, level_padding, f) == level_padding
+      && fwrite(data.levels[level].data(), 1, header.levels[level].bytes, f) == header.levels[level].bytes;
+    end = header.levels[level].offset + header.levels[level].bytes;
+  }
+
+  if (fclose(f) != 0 || !written) {
+    fprintf(stderr, "Unable to write file '%s'.\n", temp_path.c_str());
+    remove(temp_path.c_str());
+    return false;
+  }
+
+  if (rename(temp_path.c_str(), texture_path) != 0) {
+    fprintf(stderr, "Unable to replace file '%s'.\n", texture_path);
+    remove(temp_path.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+MappedTextureFile::~MappedTextureFile() {
+  Close();
+}
+
+void MappedTextureFile::Close() {
+  if (this->mapping) {
+    munmap(this->mapping, this->size);
+  }
+  this->mapping = nullptr;
+  this->size = 0;
+}
+
+bool MappedTextureFile::Open(char const* texture_path, int width, int height) {
+  Close();
+
+  int const fd = open(texture_path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Unable to open file '%s'.\n", texture_path);
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(TextureFileHeader)) {
+    fprintf(stderr, "'%s' is not a texture file.\n", texture_path);
+    close(fd);
+    return false;
+  }
+
+  // The mapping keeps the file alive after the descriptor is closed.
+  void* const mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "Unable to map file '%s'.\n", texture_path);
+    return false;
+  }
+  this->mapping = mapping;
+  this->size = (size_t)info.st_size;
+
+  // Make sure the header describes the image we expect, and data that actually fits in the file.
+  TextureFileHeader const& header = GetHeader();
+  char const* problem = nullptr;
+  if (memcmp(header.magic, TEXTURE_FILE_MAGIC, sizeof(header.magic)) != 0) {
+    problem = "is not a texture file";
+  } else if (header.version != TEXTURE_FILE_VERSION) {
+    problem = "has an unsupported version";
+  } else if (header.format != (uint32_t)TEXTURE_COMPRESSED_FORMAT) {
+    problem = "has an unsupported format";
+  } else if (header.width != (uint32_t)width || header.height != (uint32_t)height) {
+    problem = "has the wrong size";
+  } else if (header.level_count != (uint32_t)std::min(getTextureLevelCount(width, height), TEXTURE_MAX_LEVELS)) {
+    problem = "has a bad mip level count";
+  } else {
+    for (uint32_t level = 0; level < header.level_count && !problem; ++level) {
+      int const level_width = getTextureLevelSize(width, (int)level);
+      int const level_height = getTextureLevelSize(height, (int)level);
+      if (header.levels[level].bytes != getCompressedImageBytes(level_width, level_height)) {
+        problem = "has a bad mip level size";
+      } else if (header.levels[level].offset < sizeof(TextureFileHeader)
+              || (uint64_t)header.levels[level].offset + header.levels[level].bytes > this->size) {
+        problem = "is truncated";
+      }
+    }
+  }
+
+  if (problem) {
+    fprintf(stderr, "'%s' %s.\n", texture_path, problem);
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+TextureFileHeader const& MappedTextureFile::GetHeader() const {
+  return *static_cast<TextureFileHeader const*>(this->mapping);
+}
+
+void const* MappedTextureFile::GetLevel(int level) const {
+  return static_cast<char const*>(this->mapping) + GetHeader().levels[level].offset;
+}
+
+std::string getTextureFilePath(char const* source_path) {
+  std::string path{source_path};
+
+  // Swap the extension (if any) for ".tex".
+  size_t const dot = path.find_last_of('.');
+  size_t const slash = path.find_last_of('/');
+  if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+    path.erase(dot);
+  }
+
+  return path + ".tex";
+}
+
+bool isTextureFileCurrent(char const* texture_path, char const* source_path) {
+  struct stat texture_info;
+  if (stat(texture_path, &texture_info) != 0) {
+    return false;
+  }
+
+  // Without the source, the converted file is all we have.
+  struct stat source_info;
+  if (stat(source_path, &source_info) != 0) {
+    return true;
+  }
+
+  return texture_info.st_mtime >= source_info.st_mtime;
+}
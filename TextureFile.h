@@ -0,0 +1,67 @@
+#pragma once
+
+#include "TextureData.h"
+
+#include <cstdint>
+#include <string>
+
+// A .tex file holds a converted image: its compressed mip chain, ready to hand
+// straight to glCompressedTexImage2D.
+//
+// The file is a TextureFileHeader followed by the compressed blocks of each level,
+// each starting (at its `offset`) on a 16-byte boundary. Files are mapped read-only,
+// as .mesh files are (see MeshFile.h).
+static char const TEXTURE_FILE_MAGIC[8] = {'C', '4', '6', '5', 'T', 'E', 'X', '\0'};
+static uint32_t const TEXTURE_FILE_VERSION = 1;
+
+struct TextureFileLevel {
+  uint32_t offset;  // Byte offset of the level's blocks from the start of the file
+  uint32_t bytes;  // Size of the level's blocks
+};
+
+struct TextureFileHeader {
+  char magic[8];  // TEXTURE_FILE_MAGIC
+  uint32_t version;  // TEXTURE_FILE_VERSION
+  uint32_t format;  // The GL internal format of the blocks; must equal TEXTURE_COMPRESSED_FORMAT
+
+  uint32_t width;  // Of level 0
+  uint32_t height;
+
+  uint32_t level_count;
+  TextureFileLevel levels[TEXTURE_MAX_LEVELS];
+};
+
+// Writes a compressed image to a .tex file, replacing it atomically.
+// Returns false if the file couldn't be written.
+bool writeTextureFile(char const* texture_path, TextureData const& data);
+
+// A read-only view of a memory-mapped .tex file.
+class MappedTextureFile {
+private:
+  void* mapping = nullptr;
+  size_t size = 0;
+
+public:
+  MappedTextureFile() {}
+  ~MappedTextureFile();
+
+  MappedTextureFile(MappedTextureFile const&) = delete;
+  MappedTextureFile& operator=(MappedTextureFile const&) = delete;
+
+  // Maps the given file, and checks that it is a well-formed .tex file of the given size.
+  // Returns false (and reports the problem) if it isn't.
+  bool Open(char const* texture_path, int width, int height);
+
+  TextureFileHeader const& GetHeader() const;
+  void const* GetLevel(int level) const;
+
+private:
+  void Close();
+};
+
+// The path of the .tex conversion of an image: "images/starfield_1.raw" -> "images/starfield_1.tex".
+std::string getTextureFilePath(char const* source_path);
+
+// Whether the .tex file exists and is at least as new as its source image.
+// A .tex file without a source is always current.
+bool isTextureFileCurrent(char const* texture_path, char const* source_path);
@@ -0,0 +1,169 @@
+#include "TextureStream.h"
+#include "util/debug.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
+
+// The bytes and pixel rows of one unstreamable unit of an image: a row of
+// pixels, or a row of compressed blocks.
+static void GetRowUnit(GLenum format, GLsizei width, size_t* const bytes, GLsizei* const rows) {
+  if (format == TEXTURE_COMPRESSED_FORMAT) {
+    *bytes = getCompressedImageBytes(width, 1);
+    *rows = TEXTURE_BLOCK_EDGE;
+  } else {
+    *bytes = 3 * (size_t)width;
+    *rows = 1;
+  }
+}
+
+TextureStreamer::TextureStreamer() {
+  GL_DEBUG_SITE("texture streamer");
+  glGenBuffers(1, &this->buffer);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->buffer);
+  labelGlObject(GL_BUFFER, this->buffer, "texture streamer");
+
+  GLsizeiptr const size = SLOT_COUNT * SLOT_BYTES;
+  if (GLEW_ARB_buffer_storage || GLEW_VERSION_4_4) {
+    // Map the whole buffer once. Coherent writes are seen by GL without flushing.
+    GLbitfield const flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+    this->mapping = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags));
+  } else {
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+  }
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, GL_NONE);
+}
+
+TextureStreamer::~TextureStreamer() {
+  for (GLsync fence : this->fences) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+
+  // Deleting the buffer also unmaps it.
+  glDeleteBuffers(1, &this->buffer);
+}
+
+void TextureStreamer::StreamImage(
+  std::shared_ptr<Texture const> texture,
+  GLenum image_target, GLint level,
+  GLsizei width, GLsizei height,
+  GLenum format,
+  unsigned char const* data,
+  std::shared_ptr<void const> source
+) {
+  if (!data) {
+    return;  // The image failed to load, and was already reported
+  }
+
+  this->uploads.push_back(Upload{texture, image_target, level, width, height, format, data, source, 0});
+}
+
+void TextureStreamer::Update() {
+  if (this->uploads.empty()) {
+    return;
+  }
+
+  GL_DEBUG_SITE("texture streaming");
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->buffer);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);  // .RAW rows are tightly packed
+
+  size_t streamed = 0;
+  while (!this->uploads.empty() && streamed < FRAME_BYTES) {
+    // Slots are used in turn, so if this one is still being read, so are the rest.
+    size_t const slot = this->next_slot;
+    GLsync& fence = this->fences[slot];
+    if (fence) {
+      if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        break;
+      }
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+
+    Upload& upload = this->uploads.front();
+    streamed += StreamRows(upload, slot);
+    if (upload.row >= upload.height) {
+      this->uploads.pop_front();
+    }
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, GL_NONE);
+}
+
+bool TextureStreamer::IsIdle() const {
+  return this->uploads.empty();
+}
+
+size_t TextureStreamer::StreamRows(Upload& upload, size_t slot) {
+  size_t unit_bytes;
+  GLsizei unit_rows;
+  GetRowUnit(upload.format, upload.width, &unit_bytes, &unit_rows);
+
+  // Take as many whole units as fit in a slot. The last unit may be cut short by
+  // the bottom of the image.
+  size_t const units_left = (size_t)((upload.height - upload.row + unit_rows - 1) / unit_rows);
+  size_t const units = std::min(units_left, SLOT_BYTES / unit_bytes);
+  GLsizei const y = upload.row;
+  GLsizei const rows = std::min((GLsizei)units * unit_rows, upload.height - y);
+  size_t const bytes = units * unit_bytes;
+  unsigned char const* const data = upload.data + (size_t)(y / unit_rows) * unit_bytes;
+
+  glBindTexture(upload.texture->target, upload.texture->id);
+
+  void const* pixels = nullptr;
+  if (units == 0) {
+    // A single row too wide for a slot; upload the whole image straight from memory.
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, GL_NONE);
+    pixels = upload.data;
+  } else {
+    size_t const offset = slot * SLOT_BYTES;
+    if (this->mapping) {
+      memcpy(this->mapping + offset, data, bytes);
+    } else {
+      // The fence guarantees GL is done with the slot, so there's no need to synchronize.
+      void* const target = glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, offset, bytes,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+      );
+      memcpy(target, data, bytes);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    pixels = reinterpret_cast<void const*>(offset);
+  }
+
+  GLsizei const height = (units == 0) ? upload.height : rows;
+  GLsizei const image_bytes = (GLsizei)((units == 0) ? getCompressedImageBytes(upload.width, upload.height) : bytes);
+  if (upload.format == TEXTURE_COMPRESSED_FORMAT) {
+    glCompressedTexSubImage2D(upload.imageTarget, upload.level, 0, y, upload.width, height, upload.format, image_bytes, pixels);
+  } else {
+    glTexSubImage2D(upload.imageTarget, upload.level, 0, y, upload.width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+  }
+  glBindTexture(upload.texture->target, GL_NONE);
+
+  if (units == 0) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->buffer);
+    upload.row = upload.height;
+    return 0;
+  }
+
+  this->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  this->next_slot = (slot + 1) % SLOT_COUNT;
+  upload.row += rows;
+  return bytes;
+}
+
+void prefaultPages(void const* data, size_t size) {
+  size_t const page = (size_t)sysconf(_SC_PAGESIZE);
+  unsigned char const volatile* const bytes = static_cast<unsigned char const*>(data);
+
+  unsigned sum = 0;
+  for (size_t offset = 0; offset < size; offset += page) {
+    sum += bytes[offset];
+  }
+  (void)sum;
+}
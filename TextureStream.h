@@ -0,0 +1,77 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <deque>
+#include <memory>
+
+#include "Texture.h"
+
+// Streams image data into textures through a pixel buffer object, a little each frame.
+//
+// The pixel buffer is split into slots. Each frame, Update copies rows of queued
+// images into free slots and has GL copy each slot into its texture from there,
+// fencing the slot until GL is done with it. Update never waits on the GPU: if the
+// next slot is still in use, the rest of the queue waits for the next frame.
+//
+// Where the driver has ARB_buffer_storage, the buffer is mapped once, persistently;
+// otherwise each slot is mapped as it is filled.
+class TextureStreamer {
+private:
+  static size_t const SLOT_COUNT = 8;
+  static size_t const SLOT_BYTES = 1024 * 1024;
+  static size_t const FRAME_BYTES = 4 * SLOT_BYTES;  // Copied per call to Update, at most
+
+  struct Upload {
+    std::shared_ptr<Texture const> texture;
+    GLenum imageTarget;  // GL_TEXTURE_2D, or a cube map face
+    GLint level;
+    GLsizei width;
+    GLsizei height;
+    GLenum format;  // GL_RGB (tightly packed), or TEXTURE_COMPRESSED_FORMAT
+    unsigned char const* data;
+    std::shared_ptr<void const> source;  // Keeps `data` alive
+    GLsizei row;  // The next pixel row to copy
+  };
+
+  GLuint buffer = GL_NONE;
+  unsigned char* mapping = nullptr;  // The persistent mapping of `buffer`, if any
+  GLsync fences[SLOT_COUNT] = {};  // Set while GL may still be reading the slot
+  size_t next_slot = 0;
+
+  std::deque<Upload> uploads;
+
+public:
+  TextureStreamer();
+  ~TextureStreamer();
+
+  TextureStreamer(TextureStreamer const&) = delete;
+  TextureStreamer& operator=(TextureStreamer const&) = delete;
+
+  // Queues an image for uploading into one level of a texture, which must already
+  // have storage for it. `data` must stay valid for as long as `source` is held.
+  void StreamImage(
+    std::shared_ptr<Texture const> texture,
+    GLenum image_target, GLint level,
+    GLsizei width, GLsizei height,
+    GLenum format,
+    unsigned char const* data,
+    std::shared_ptr<void const> source
+  );
+
+  // Streams as much of the queue as fits in the free slots and this frame's budget.
+  // Must be called on the thread that owns the GL context.
+  void Update();
+
+  // Whether every queued image has been handed to GL.
+  bool IsIdle() const;
+
+private:
+  // Copies the next rows of the front upload into a slot, and has GL upload them.
+  // Returns the bytes copied.
+  size_t StreamRows(Upload& upload, size_t slot);
+};
+
+// Reads one byte of each page of the given memory, so that a mapped file is paged
+// in by the thread calling this, rather than by whoever first touches the data.
+void prefaultPages(void const* data, size_t size);
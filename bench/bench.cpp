@@ -0,0 +1,358 @@
+// Microbenchmarks of the engine's hot paths, none of which need a GL context.
+//
+// Usage: COMP465_bench [table|json|csv] [filter]
+// Runs every case whose name contains `filter` (default: all of them), and writes
+// the results to stdout as a table (the default), JSON, or CSV. Each case runs
+// for enough iterations to take at least 20 ms, five times over, and reports the
+// fastest and median times per iteration ("op"); and per item, for cases which
+// work through many (entities, triangles, bytes). Builds configured with
+// -DALLOC_TRACKING=ON also report heap allocations per op.
+
+#include "../CollisionSystem.h"
+#include "../MeshData.h"
+#include "../MeshTri.h"
+#include "../MissileSystem.h"
+#include "../Texture.h"
+#include "../util/alloc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// Iterations are added until one run takes at least this long.
+static double const MIN_RUN_SECONDS = 0.02;
+
+// Timed runs of each case, after calibrating.
+static int const RUNS = 5;
+
+// Keeps the compiler from optimizing away work whose result is never used.
+static volatile float g_sink;
+
+struct Result {
+  std::string name;
+  std::string param;
+  uint64_t iterations;
+  double minNs;  // Per op
+  double medianNs;  // Per op
+  double items;  // Per op
+  double allocs;  // Per op, or NaN when not tracked
+};
+
+class Bench {
+private:
+  char const* filter;
+  std::vector<Result> results;
+
+  // Seconds taken by `iterations` calls of `work`.
+  template<typename Work>
+  static double Time(uint64_t iterations, Work& work) {
+    Clock::time_point const start = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+      work();
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+public:
+  explicit Bench(char const* filter)
+    : filter{filter}
+  {}
+
+  // Whether the case of the given name is to run; checked before setting it up.
+  bool IsSelected(char const* name) const {
+    return std::strstr(name, this->filter) != nullptr;
+  }
+
+  // Times `work`, which handles `items` items per call.
+  template<typename Work>
+  void Run(char const* name, std::string const& param, double items, Work work) {
+    uint64_t iterations = 1;
+    for (;;) {
+      double const seconds = Time(iterations, work);
+      if (seconds >= MIN_RUN_SECONDS) {
+        break;
+      }
+      // Aim a little past the goal, so the next run is usually the last.
+      double const scale = (seconds > 0.0) ? 1.2 * MIN_RUN_SECONDS / seconds : 100.0;
+      iterations = std::max(iterations + 1, (uint64_t)(iterations * std::min(scale, 100.0)));
+    }
+
+    std::vector<double> times;
+    uint64_t allocations = 0;
+    for (int run = 0; run < RUNS; ++run) {
+      endAllocFrame();
+      double const seconds = Time(iterations, work);
+      allocations = endAllocFrame().count;
+      times.push_back(seconds * 1e9 / iterations);
+    }
+    std::sort(times.begin(), times.end());
+
+    double const allocs = isAllocTrackingEnabled() ? (double)allocations / iterations : NAN;
+    this->results.push_back(Result{name, param, iterations, times.front(), times[RUNS / 2], items, allocs});
+  }
+
+  void PrintTable() const {
+    printf("%-14s %-16s %10s %14s %14s %10s %12s %10s\n",
+      "case", "param", "iterations", "min ns/op", "median ns/op", "items/op", "ns/item", "allocs/op");
+    for (Result const& result : this->results) {
+      printf("%-14s %-16s %10llu %14.1f %14.1f %10.0f %12.3f ",
+        result.name.c_str(), result.param.c_str(), (unsigned long long)result.iterations,
+        result.minNs, result.medianNs, result.items, result.minNs / result.items);
+      if (std::isnan(result.allocs)) {
+        printf("%10s\n", "-");
+      } else {
+        printf("%10.2f\n", result.allocs);
+      }
+    }
+  }
+
+  void PrintJson() const {
+    printf("{\n  \"runs\": %d,\n  \"alloc_tracking\": %s,\n  \"results\": [\n", RUNS, isAllocTrackingEnabled() ? "true" : "false");
+    for (size_t i = 0; i < this->results.size(); ++i) {
+      Result const& result = this->results[i];
+      printf("    {\"name\": \"%s\", \"param\": \"%s\", \"iterations\": %llu, "
+        "\"min_ns_per_op\": %.1f, \"median_ns_per_op\": %.1f, \"items_per_op\": %.0f, \"min_ns_per_item\": %.3f, ",
+        result.name.c_str(), result.param.c_str(), (unsigned long long)result.iterations,
+        result.minNs, result.medianNs, result.items, result.minNs / result.items);
+      if (std::isnan(result.allocs)) {
+        printf("\"allocs_per_op\": null}");
+      } else {
+        printf("\"allocs_per_op\": %.2f}", result.allocs);
+      }
+      printf((i + 1 < this->results.size()) ? ",\n" : "\n");
+    }
+    printf("  ]\n}\n");
+  }
+
+  void PrintCsv() const {
+    printf("name,param,iterations,min_ns_per_op,median_ns_per_op,items_per_op,min_ns_per_item,allocs_per_op\n");
+    for (Result const& result : this->results) {
+      printf("%s,%s,%llu,%.1f,%.1f,%.0f,%.3f,",
+        result.name.c_str(), result.param.c_str(), (unsigned long long)result.iterations,
+        result.minNs, result.medianNs, result.items, result.minNs / result.items);
+      if (std::isnan(result.allocs)) {
+        printf("\n");
+      } else {
+        printf("%.2f\n", result.allocs);
+      }
+    }
+  }
+};
+
+// A mesh of the given bounding radius. It has no GL objects, and makes no GL calls.
+static MeshHandle MakeMesh(float bounding_radius) {
+  std::shared_ptr<Mesh> mesh{new Mesh{}};
+  mesh->boundingRadius = bounding_radius;
+  return MeshHandle{std::make_shared<std::shared_ptr<Mesh>>(mesh)};
+}
+
+static std::string Param(char const* key, size_t value) {
+  char text[64];
+  snprintf(text, sizeof(text), "%s=%u", key, (unsigned)value);
+  return text;
+}
+
+// Walks every entity with a position and a model, as the render and collision systems do.
+static void BenchQuery(Bench& bench) {
+  if (!bench.IsSelected("query")) {
+    return;
+  }
+
+  for (size_t count : {10, 1000, 100000}) {
+    EntityDatabase entities;
+    for (size_t i = 0; i < count; ++i) {
+      std::string const id = "entity " + std::to_string(i);
+      entities.positions.insert(std::make_pair(id, PositionComponent{"::world", glm::vec3{(float)i, 0.0f, 0.0f}}));
+      entities.models.insert(std::make_pair(id, ModelComponent{MeshHandle{}}));
+    }
+
+    bench.Run("query", Param("entities", count), (double)count, [&]() {
+      float sum = 0.0f;
+      for (CollidableEntity entity : entities.Query<CollidableEntity>()) {
+        sum += entity.position->translation.x;
+      }
+      g_sink = sum;
+    });
+  }
+}
+
+// Composes the transform of an entity at the end of a chain of parents.
+static void BenchWorldMatrix(Bench& bench) {
+  if (!bench.IsSelected("world_matrix")) {
+    return;
+  }
+
+  for (size_t depth : {1, 2, 4, 8, 16}) {
+    EntityDatabase entities;
+    std::string parent = "::world";
+    for (size_t i = 0; i < depth; ++i) {
+      std::string const id = "link " + std::to_string(i);
+      entities.positions.insert(std::make_pair(id, PositionComponent{parent, glm::vec3{1.0f, 0.0f, 0.0f}}));
+      parent = id;
+    }
+
+    bench.Run("world_matrix", Param("depth", depth), (double)depth, [&]() {
+      g_sink = entities.GetWorldMatrix(parent)[3][0];
+    });
+  }
+}
+
+// Tests every pair of entities for collisions, none of which collide.
+static void BenchCollision(Bench& bench) {
+  if (!bench.IsSelected("collision")) {
+    return;
+  }
+
+  MeshHandle const mesh = MakeMesh(1.0f);
+  for (size_t count : {10, 100, 1000}) {
+    GameState state;
+    for (size_t i = 0; i < count; ++i) {
+      std::string const id = "entity " + std::to_string(i);
+      state.entities.positions.insert(std::make_pair(id, PositionComponent{"::world", glm::vec3{10.0f * i, 0.0f, 0.0f}}));
+      state.entities.models.insert(std::make_pair(id, ModelComponent{mesh}));
+    }
+
+    CollisionSystem collisionSystem;
+    bench.Run("collision", Param("entities", count), (double)(count * count), [&]() {
+      collisionSystem.Update(state, 0.0);
+    });
+  }
+}
+
+// Steers homing missiles towards their targets. With no time passing, they never
+// move, expire, or reach them, so every op does the same work.
+static void BenchMissiles(Bench& bench) {
+  if (!bench.IsSelected("missiles")) {
+    return;
+  }
+
+  for (size_t count : {1, 10, 100, 1000}) {
+    GameState state;
+    EntityDatabase& entities = state.entities;
+
+    // The targets the missile system looks for by name.
+    char const* const targets[] = {"ship", "Unum Silo", "Secundus Silo"};
+    for (int i = 0; i < 3; ++i) {
+      entities.positions.insert(std::make_pair(targets[i], PositionComponent{"::world", glm::vec3{0.0f, 1000.0f * i, -5000.0f}}));
+      entities.silos.insert(std::make_pair(targets[i], SiloComponent{0, 0.0, 0.0, 0.0}));
+    }
+
+    std::mt19937 random{465};
+    std::uniform_real_distribution<float> coordinate{-2000.0f, 2000.0f};
+    for (size_t i = 0; i < count; ++i) {
+      std::string const id = "missile " + std::to_string(i);
+      glm::vec3 const position{coordinate(random), coordinate(random), coordinate(random)};
+      entities.positions.insert(std::make_pair(id, PositionComponent{"::world", position}));
+
+      MissileComponent missile{"ship", (i % 2 == 0) ? SILO_TARGETING : SHIP_TARGETING, 1e6, 50.0};
+      missile.time_to_live = MissileComponent::MAX_LIFETIME - MissileComponent::IDLE_PERIOD - 1.0;
+      entities.missiles.insert(std::make_pair(id, missile));
+    }
+
+    MissileSystem missileSystem;
+    bench.Run("missiles", Param("missiles", count), (double)count, [&]() {
+      missileSystem.Update(state, 0.0);
+    });
+  }
+}
+
+// Writes `triangles` random triangles, formatted like the shipped models.
+static bool WriteSyntheticModel(char const* path, size_t triangles) {
+  FILE* f = fopen(path, "w");
+  if (!f) {
+    return false;
+  }
+
+  std::mt19937 random{465};
+  std::uniform_real_distribution<float> coordinate{-2000.0f, 2000.0f};
+  std::uniform_int_distribution<unsigned> color{0, 0xFFFFFF};
+  for (size_t t = 0; t < triangles; ++t) {
+    for (int i = 0; i < 9; ++i) {
+      fprintf(f, (i % 3 == 0 && i > 0) ? "  %g" : (i > 0 ? " %g" : "%g"), coordinate(random));
+    }
+    fprintf(f, "  0x%06X\n", color(random));
+  }
+
+  return fclose(f) == 0;
+}
+
+// Parses a large .TRI model into a triangle soup.
+static void BenchTriParse(Bench& bench) {
+  if (!bench.IsSelected("tri_parse")) {
+    return;
+  }
+
+  size_t const triangles = 100000;
+  char const* const path = "bench-synthetic.tri";
+  if (!WriteSyntheticModel(path, triangles)) {
+    fprintf(stderr, "Unable to write '%s'.\n", path);
+    return;
+  }
+
+  std::vector<GLfloat> soup;
+  bench.Run("tri_parse", Param("triangles", triangles), (double)triangles, [&]() {
+    readTriFile(path, &soup);
+  });
+  remove(path);
+}
+
+// Reads a .RAW image the size of a starfield face into memory.
+static void BenchRawLoad(Bench& bench) {
+  if (!bench.IsSelected("raw_load")) {
+    return;
+  }
+
+  int const edge = 908;
+  size_t const bytes = (size_t)edge * edge * 3;
+  char const* const path = "bench-synthetic.raw";
+  FILE* f = fopen(path, "wb");
+  if (!f) {
+    fprintf(stderr, "Unable to write '%s'.\n", path);
+    return;
+  }
+  std::vector<unsigned char> const pixels(bytes, 0x80);
+  bool const written = (fwrite(pixels.data(), bytes, 1, f) == 1);
+  if (fclose(f) != 0 || !written) {
+    fprintf(stderr, "Unable to write '%s'.\n", path);
+    remove(path);
+    return;
+  }
+
+  bench.Run("raw_load", Param("bytes", bytes), (double)bytes, [&]() {
+    free(loadRawData(path, edge, edge));
+  });
+  remove(path);
+}
+
+int main(int argc, char** argv) {
+  char const* const format = (argc > 1) ? argv[1] : "table";
+  if (strcmp(format, "table") != 0 && strcmp(format, "json") != 0 && strcmp(format, "csv") != 0) {
+    fprintf(stderr, "Usage: %s [table|json|csv] [filter]\n", argv[0]);
+    return 1;
+  }
+
+  Bench bench{(argc > 2) ? argv[2] : ""};
+  BenchQuery(bench);
+  BenchWorldMatrix(bench);
+  BenchCollision(bench);
+  BenchMissiles(bench);
+  BenchTriParse(bench);
+  BenchRawLoad(bench);
+
+  if (strcmp(format, "json") == 0) {
+    bench.PrintJson();
+  } else if (strcmp(format, "csv") == 0) {
+    bench.PrintCsv();
+  } else {
+    bench.PrintTable();
+  }
+  return 0;
+}
@@ -0,0 +1,109 @@
+// Measures how the Barnes-Hut gravity solver (see Gravity.h) scales with the
+// number of bodies, and how far it strays from summing every pair.
+//
+// Usage: gravitybench [max_bodies] [opening_angle] [threads]
+// Solves clusters of 1,000 bodies up to `max_bodies` (default 100,000) with the
+// given opening angle (default 0.5) on `threads` threads (default: one per core),
+// reporting the best of three solves at each size. Up to 10,000 bodies, every pair
+// is also summed directly for comparison; the error is always measured against
+// direct sums for a sample of 500 bodies.
+
+#include "../Gravity.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// Above this many bodies, the O(n^2) solve takes too long to time.
+static size_t const EXACT_MAX_BODIES = 10000;
+
+// Bodies whose error is measured against direct sums.
+static size_t const ERROR_SAMPLES = 500;
+
+// A Plummer sphere, the usual model of a star cluster: dense in the middle, thinning outward.
+static std::vector<GravityBody> MakeCluster(size_t count) {
+  std::mt19937 random{465};
+  std::uniform_real_distribution<float> uniform{0.0f, 1.0f};
+
+  std::vector<GravityBody> bodies(count);
+  for (GravityBody& body : bodies) {
+    // Truncated at 99% of the mass, about twelve scale radii out.
+    float const mass_fraction = std::min(std::max(uniform(random), 1e-6f), 0.99f);
+    float const radius = 1000.0f / std::sqrt(std::pow(mass_fraction, -2.0f / 3.0f) - 1.0f);
+    float const z = 2.0f * uniform(random) - 1.0f;
+    float const phi = 6.2831853f * uniform(random);
+    float const r = std::sqrt(1.0f - z * z);
+    body.position = radius * glm::vec3{r * std::cos(phi), r * std::sin(phi), z};
+    body.mass = 1.0f / count;
+  }
+  return bodies;
+}
+
+// The shortest of three runs of `solve`, in seconds.
+static double BestTime(std::function<void()> const& solve) {
+  double best = INFINITY;
+  for (int run = 0; run < 3; ++run) {
+    Clock::time_point const start = Clock::now();
+    solve();
+    best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+  }
+  return best;
+}
+
+int main(int argc, char** argv) {
+  size_t const max_bodies = (argc > 1) ? (size_t)atol(argv[1]) : 100000;
+  GravitySettings settings;
+  settings.openingAngle = (argc > 2) ? (float)atof(argv[2]) : 0.5f;
+  settings.threadCount = (argc > 3) ? (unsigned)atoi(argv[3]) : 0;
+
+  GravitySettings exact_settings = settings;
+  exact_settings.exact = true;
+
+  printf("opening angle %.2f\n", settings.openingAngle);
+  printf("%8s %8s %11s %11s %14s %10s\n", "bodies", "cells", "tree ms", "exact ms", "ns/(n log n)", "rms error");
+
+  GravitySolver solver;
+  std::vector<glm::vec3> accelerations;
+  std::vector<glm::vec3> exact_accelerations;
+  for (double n = 1000; n <= max_bodies * 1.001; n *= std::sqrt(10.0)) {
+    size_t const count = (size_t)std::round(n);
+    std::vector<GravityBody> const bodies = MakeCluster(count);
+
+    double const tree = BestTime([&]() { solver.Solve(bodies, settings, &accelerations); });
+    double exact = NAN;
+    if (count <= EXACT_MAX_BODIES) {
+      exact = BestTime([&]() { solver.Solve(bodies, exact_settings, &exact_accelerations); });
+    }
+
+    // The RMS of the relative error of the accelerations of a sample of bodies.
+    double error = 0.0;
+    size_t const stride = std::max(count / ERROR_SAMPLES, (size_t)1);
+    size_t samples = 0;
+    for (size_t body = 0; body < count; body += stride, ++samples) {
+      glm::vec3 const reference = getExactAcceleration(bodies, body, settings);
+      double const relative = glm::length(accelerations[body] - reference) / glm::length(reference);
+      error += relative * relative;
+    }
+    error = std::sqrt(error / samples);
+
+    printf("%8u %8u %11.2f %11.2f %14.2f %10.2e\n",
+      (unsigned)count,
+      (unsigned)solver.GetNodeCount(),
+      1000.0 * tree,
+      1000.0 * exact,
+      1e9 * tree / (count * std::log2((double)count)),
+      error
+    );
+  }
+
+  return 0;
+}
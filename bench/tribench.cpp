@@ -0,0 +1,116 @@
+// Measures .TRI parsing throughput (see MeshTri.h) on a large synthetic model.
+//
+// Usage: tribench [triangles] [runs]
+// Writes a model of `triangles` triangles (default 1,000,000) to a temporary
+// file, then reports the best of `runs` (default 5) loads, both through
+// readTriFile and through the fscanf loop it replaced.
+
+#include "../MeshData.h"
+#include "../MeshTri.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// The loader that readTriFile replaced: one fscanf per line, through stdio.
+static bool ReadTriFileWithFscanf(char const* tri_path, std::vector<GLfloat>* const soup) {
+  FILE* f = fopen(tri_path, "r");
+  if (!f) {
+    return false;
+  }
+
+  soup->clear();
+  float p[9];
+  unsigned int rgb;
+  while (fscanf(f, "%f %f %f %f %f %f %f %f %f 0x%x", &p[0], &p[1], &p[2], &p[3], &p[4], &p[5], &p[6], &p[7], &p[8], &rgb) == 10) {
+    for (int corner = 0; corner < 3; ++corner) {
+      GLfloat const vertex[MESH_SOURCE_VERTEX_FLOATS] = {
+        p[3*corner], p[3*corner + 1], p[3*corner + 2],
+        0.0f, 0.0f, 1.0f,
+        (float)((rgb >> 16) & 0xFF) / 0xFF, (float)((rgb >> 8) & 0xFF) / 0xFF, (float)(rgb & 0xFF) / 0xFF, 1.0f,
+      };
+      soup->insert(soup->end(), vertex, vertex + MESH_SOURCE_VERTEX_FLOATS);
+    }
+  }
+
+  fclose(f);
+  return true;
+}
+
+// Writes `triangles` random triangles, formatted like the shipped models.
+static bool WriteSyntheticModel(char const* path, size_t triangles) {
+  FILE* f = fopen(path, "w");
+  if (!f) {
+    return false;
+  }
+
+  std::mt19937 random{465};
+  std::uniform_real_distribution<float> coordinate{-2000.0f, 2000.0f};
+  std::uniform_int_distribution<unsigned> color{0, 0xFFFFFF};
+  for (size_t t = 0; t < triangles; ++t) {
+    for (int i = 0; i < 9; ++i) {
+      fprintf(f, (i % 3 == 0 && i > 0) ? "  %g" : (i > 0 ? " %g" : "%g"), coordinate(random));
+    }
+    fprintf(f, "  0x%06X\n", color(random));
+  }
+
+  return fclose(f) == 0;
+}
+
+// The shortest of `runs` runs of `load`, in seconds.
+static double BestTime(int runs, std::function<bool()> const& load) {
+  double best = INFINITY;
+  for (int run = 0; run < runs; ++run) {
+    Clock::time_point const start = Clock::now();
+    if (!load()) {
+      return NAN;
+    }
+    best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+  }
+  return best;
+}
+
+int main(int argc, char** argv) {
+  size_t const triangles = (argc > 1) ? (size_t)atol(argv[1]) : 1000000;
+  int const runs = (argc > 2) ? atoi(argv[2]) : 5;
+
+  std::string const path = "tribench-synthetic.tri";
+  if (!WriteSyntheticModel(path.c_str(), triangles)) {
+    fprintf(stderr, "Unable to write '%s'.\n", path.c_str());
+    return 1;
+  }
+
+  FILE* f = fopen(path.c_str(), "rb");
+  fseek(f, 0, SEEK_END);
+  double const megabytes = ftell(f) / (1024.0 * 1024.0);
+  fclose(f);
+
+  std::vector<GLfloat> soup, reference;
+  double const fast = BestTime(runs, [&]() { return readTriFile(path.c_str(), &soup); });
+  double const slow = BestTime(runs, [&]() { return ReadTriFileWithFscanf(path.c_str(), &reference); });
+  remove(path.c_str());
+
+  // Both loaders must agree on every coordinate and color (normals aside).
+  bool agree = (soup.size() == reference.size());
+  for (size_t i = 0; agree && i < soup.size(); ++i) {
+    size_t const field = i % MESH_SOURCE_VERTEX_FLOATS;
+    if ((field < 3 || field >= 6) && soup[i] != reference[i]) {
+      fprintf(stderr, "Mismatch at float %u: %.9g vs %.9g\n", (unsigned)i, soup[i], reference[i]);
+      agree = false;
+    }
+  }
+
+  printf("%u triangles, %.1f MB, best of %d runs\n", (unsigned)triangles, megabytes, runs);
+  printf("  readTriFile  %8.1f ms  %7.1f MB/s\n", 1000.0 * fast, megabytes / fast);
+  printf("  fscanf       %8.1f ms  %7.1f MB/s\n", 1000.0 * slow, megabytes / slow);
+  printf("  speedup      %8.1fx\n", slow / fast);
+  return agree ? 0 : 1;
+}
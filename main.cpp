@@ -1,11 +1,21 @@
 #include "App.h"
+#include "CollisionSystem.h"
+#include "GravitySystem.h"
 #include "RenderSystem.h"
 #include "MissileSystem.h"
+#include "ScheduleSystem.h"
 #include "SiloSystem.h"
-
+#include "util/alloc.h"
+#include "util/arena.h"
+#include "util/debug.h"
+#include "util/profile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <thread>
-#include <sstream>
 
 using namespace std;
 
@@ -26,6 +36,10 @@ static GLFWwindow* setupGLFW(int width, int height, char const* title, GLFWerror
   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
   glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
 
+  // Ask for a debug context when the GL validation layer is active,
+  // so that the driver reports problems through KHR_debug.
+  glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, isGlDebugEnabled() ? GL_TRUE : GL_FALSE);
+
   // Create a window with the desired dimensions and title
   GLFWwindow* window = glfwCreateWindow(width, height, title, nullptr, nullptr);
   if (!window) {
@@ -52,6 +66,9 @@ static bool setupGLEW() {
   // Purge the GL_INVALID_ENUM which glewInit may cause.
   while (glGetError() != GL_NO_ERROR) {}
 
+  // Hook up the GL validation layer, if it was compiled in.
+  installGlDebugOutput();
+
   return true;
 }
 
@@ -69,44 +86,85 @@ void error_callback(int /*error*/, char const* description) {
   cerr << description << endl;
 }
 
-// Generates simulation window title text
-std::string make_window_title(App const& app, int framerate) {
+// Generates simulation window title text into `title`, which holds `size` characters.
+void make_window_title(App const& app, int framerate, char* const title, size_t size) {
   if (app.state.entities.silos.at("Unum Silo").destroyed &&
     app.state.entities.silos.at("Secundus Silo").destroyed &&
     !app.state.entities.silos.at("ship").destroyed)
   {
-    return "Cadet passes flight training";
+    snprintf(title, size, "Cadet passes flight training");
   } else if (app.state.entities.silos.at("ship").destroyed
   || (app.state.entities.silos.at("ship").missiles <= 0 && app.state.entities.silos.at("ship").current_missile == "")
   ) {
-    return "Cadet resigns from War College";
+    snprintf(title, size, "Cadet resigns from War College");
   } else {
-    std::stringstream builder;
-    builder << "Warbird: " << app.state.entities.silos.at("ship").missiles;
-    builder << " | Unum: ";
-    if (app.state.entities.silos.at("Unum Silo").destroyed) {
-      builder << "X";
-    } else {
-      builder << app.state.entities.silos.at("Unum Silo").missiles;
+    char unum[16] = "X";
+    if (!app.state.entities.silos.at("Unum Silo").destroyed) {
+      snprintf(unum, sizeof(unum), "%d", app.state.entities.silos.at("Unum Silo").missiles);
     }
-    builder << " | Secundus: ";
-    if (app.state.entities.silos.at("Secundus Silo").destroyed) {
-      builder << "X";
-    } else {
-      builder << app.state.entities.silos.at("Secundus Silo").missiles;
+    char secundus[16] = "X";
+    if (!app.state.entities.silos.at("Secundus Silo").destroyed) {
+      snprintf(secundus, sizeof(secundus), "%d", app.state.entities.silos.at("Secundus Silo").missiles);
     }
-    builder << " | U/S: " << (1000.0 * app.GetTimeScaling()) / 40.0
-            << " | F/S: " << framerate
-            << " | " << CAMERAS[app.state.active_camera]
-            << " | Gravity: " << (app.state.gravity_enabled ? "On" : "Off")
-            << " | Thrust: " << (int)THRUSTS[app.state.active_thrust_factor]
-            ;
-    return builder.str();
+
+    snprintf(title, size, "Warbird: %d | Unum: %s | Secundus: %s | U/S: %g | F/S: %d | %s | Gravity: %s | Thrust: %d",
+      app.state.entities.silos.at("ship").missiles,
+      unum,
+      secundus,
+      (1000.0 * app.GetTimeScaling()) / 40.0,
+      framerate,
+      CAMERAS[app.state.active_camera].c_str(),
+      app.state.gravity_enabled ? "On" : "Off",
+      (int)THRUSTS[app.state.active_thrust_factor]
+    );
+  }
+}
+
+// Generates the performance overlay's text into `text`, which holds `size`
+// characters, from frames measured since it was last updated.
+void make_hud_text(
+  App const& app, RenderSystem const& renderSystem, ScheduleSystem const& scheduler, AssetRegistry const& registry,
+  double frameSeconds, double worstFrameSeconds, double stepsPerFrame, double allocsPerFrame, double allocBytesPerFrame,
+  char* const text, size_t size
+) {
+  RenderSystem::Stats const& stats = renderSystem.GetStats();
+
+  int const length = snprintf(text, size,
+    "Frame %.1f ms (%.0f FPS), worst %.1f ms\n"
+    "Sim %.1f steps/frame, tiers %u/%u/%u\n"
+    "Entities %u, %u models, %u culled\n"
+    "Draw calls %u\n"
+    "Assets %.1f MB CPU, %.1f MB GPU",
+    1000.0 * frameSeconds, 1.0 / frameSeconds, 1000.0 * worstFrameSeconds,
+    stepsPerFrame, (unsigned)scheduler.GetTierCount(0), (unsigned)scheduler.GetTierCount(1), (unsigned)scheduler.GetTierCount(2),
+    (unsigned)app.state.entities.positions.size(), stats.entities, stats.culled,
+    stats.drawCalls,
+    registry.GetCpuBytes() / (1024.0 * 1024.0), registry.GetGpuBytes() / (1024.0 * 1024.0)
+  );
+
+  if (isAllocTrackingEnabled() && length >= 0 && (size_t)length < size) {
+    snprintf(text + length, size - length, "\nHeap %.1f allocs/frame, %.1f KB/frame", allocsPerFrame, allocBytesPerFrame / 1024.0);
   }
 }
 
 // Entry point.
 int main(int /*argc*/, char** /*argv*/) {
+  // Check that steady frames allocate nothing on this thread, if requested: play this
+  // many of them, failing at the first which allocates, then quit. A diagnostic for
+  // whole frames; the simulation alone is checked by tests/alloccheck.cpp, under ctest.
+  int allocCheckFrames = 0;
+  {
+    char const* setting = getenv("COMP465_ALLOC_CHECK");
+    if (setting) {
+      allocCheckFrames = atoi(setting);
+    }
+    if (allocCheckFrames > 0 && !isAllocTrackingEnabled()) {
+      cout << "COMP465_ALLOC_CHECK needs allocation tracking; configure with -DALLOC_TRACKING=ON." << endl;
+      return 1;
+    }
+  }
+  int exitCode = 0;
+
   // Initialize GLFW
   GLFWwindow* const window = setupGLFW(1024, 768, "Project Phase 1", &error_callback);
   if (!window) {
@@ -124,10 +182,39 @@ int main(int /*argc*/, char** /*argv*/) {
     return 1;
   }
 
+  // Reads asset files on worker threads, while this thread sets up GL state.
+  AssetLoader loader;
+
+  // Keeps each asset loaded once, while anything uses it. Unused assets are kept
+  // as a cache, up to a budget of COMP465_ASSET_BUDGET_MB megabytes.
+  size_t budget_megabytes = 256;
+  {
+    char const* setting = getenv("COMP465_ASSET_BUDGET_MB");
+    if (setting) {
+      budget_megabytes = strtoul(setting, nullptr, 10);
+    }
+  }
+  AssetRegistry registry{loader, budget_megabytes * 1024 * 1024};
+
   // Set up our app object.
   // Note that this has to happen AFTER a GL context is made current.
   App app;
 
+  // Start on the GPU-driven rendering path if requested.
+  {
+    char const* setting = getenv("COMP465_GPU_DRIVEN");
+    app.state.gpu_driven = (setting && strcmp(setting, "0") != 0);
+  }
+
+  // Draw procedural stars instead of the cube map if requested, to save its memory.
+  RenderSystem::Backdrop backdrop = RenderSystem::Backdrop::CUBE_MAP;
+  {
+    char const* setting = getenv("COMP465_STARFIELD");
+    if (setting && strcmp(setting, "procedural") == 0) {
+      backdrop = RenderSystem::Backdrop::STARS;
+    }
+  }
+
   RenderSystem renderSystem{
     window,
 
@@ -138,8 +225,26 @@ int main(int /*argc*/, char** /*argv*/) {
     // with a 75-degree field of view (along the Y axis). The 4/3 ratio determines the field of view
     // along the X axis, and serves to couple the viewing frustum to the (default) dimensions of the canvas.
     glm::perspective(glm::radians(75.0f), 4.0f / 3.0f, 1.0f, 100001.0f),
+
+    registry,
+    backdrop,
   };
 
+  // Tune the Barnes-Hut opening angle, or sum every pair of bodies directly, if requested.
+  GravitySettings gravitySettings;
+  {
+    char const* setting = getenv("COMP465_GRAVITY_THETA");
+    if (setting) {
+      gravitySettings.openingAngle = (float)atof(setting);
+    }
+
+    setting = getenv("COMP465_GRAVITY_EXACT");
+    gravitySettings.exact = (setting && strcmp(setting, "0") != 0);
+  }
+
+  CollisionSystem collisionSystem{};
+  ScheduleSystem scheduleSystem{};
+  GravitySystem gravitySystem{gravitySettings};
   MissileSystem missileSystem{};
   SiloSystem siloSystem{&app.missileMesh};
 
@@ -150,26 +255,55 @@ int main(int /*argc*/, char** /*argv*/) {
     glfwSetKeyCallback(window, &keyboard_callback);
 
     // Notify the app object that a GL context has been acquired
-    G_APP->OnAcquireContext(window);
+    G_APP->OnAcquireContext(window, registry);
 
     // Game Loop pattern
     // More information at http://gameprogrammingpatterns.com/game-loop.html
     // This particular game loop is modeled after one at http://gafferongames.com/game-physics/fix-your-timestep/
     {
       double const dt = 0.005;  // Fixed timestep for simulation evolution
+      int const MAX_STEPS_PER_FRAME = 200;  // Time steps simulated per frame, at most
 
       // Time elapsed (in seconds) since GLFW startup
       double currentTime = glfwGetTime();
       // Accumulates time as time passes. The simulator consumes this in discrete time quanta.
       double accumulator = 0.0;
 
-      // Tracks our approximate FPS
-      float prevFPS = 0;
+      // The HUD's text is refreshed every HUD_PERIOD seconds, and the window title (a
+      // round trip to the window server) every TITLE_PERIOD, from the frames between.
+      double const HUD_PERIOD = 0.25;
+      double const TITLE_PERIOD = 1.0;
+      double hudStart = currentTime;
+      int hudFrames = 0;
+      int hudSteps = 0;
+      double hudWorstFrame = 0.0;
+      double titleStart = currentTime;
+      int titleFrames = 0;
+      char title[256] = "";
+
+      // Heap allocations on this thread since the HUD's text was last refreshed.
+      uint64_t hudAllocs = 0;
+      uint64_t hudAllocBytes = 0;
+
+      // Frames played before the allocation check starts, while assets stream in
+      // and scratch space grows to fit.
+      int const ALLOC_WARMUP_FRAMES = 300;
+      int frameCount = 0;
+      int allocCheckedFrames = 0;
+
+      // Whether the first frame has been presented yet
+      bool presented = false;
+
+      nameProfileThread("main");
 
       while (!glfwWindowShouldClose(window)) {
+        PROFILE_ZONE("frame");
+        size_t const entityCount = G_APP->state.entities.positions.size();
+
         double const newTime = glfwGetTime();
         double const delta = newTime - currentTime;
         currentTime = newTime;
+        renderSystem.GetHud().AddFrameTime(delta);
 
         // Update simulation
         {
@@ -178,13 +312,27 @@ int main(int /*argc*/, char** /*argv*/) {
           //   from the real world's clock speed.
           accumulator += G_APP->GetTimeScaling() * delta;
 
-          // Run the simulation for as many time quanta as possible.
+          // Run the simulation for as many time quanta as possible. While nothing
+          // is interacting, many quanta are taken in one step.
+          PROFILE_ZONE("simulate");
+          ALLOC_SCOPE("simulate");
+          int steps = 0;
           while (accumulator >= dt) {
-            accumulator -= dt;
-            G_APP->OnTimeStep(dt);
-            missileSystem.Update(G_APP->state, dt);
-            siloSystem.Update(G_APP->state, dt);
+            double const step = G_APP->GetStepSize(dt, accumulator);
+            accumulator -= step;
+            G_APP->OnTimeStep(step);
+            collisionSystem.Update(G_APP->state, step);
+            scheduleSystem.Update(G_APP->state, step);
+            gravitySystem.Update(G_APP->state, step);
+            missileSystem.Update(G_APP->state, step);
+            siloSystem.Update(G_APP->state, step);
+
+            // Rather than fall ever further behind, let a warp we can't keep up with run slower.
+            if (++steps == MAX_STEPS_PER_FRAME) {
+              accumulator = 0.0;
+            }
           }
+          hudSteps += steps;
         }
 
         // Render simulation
@@ -194,23 +342,98 @@ int main(int /*argc*/, char** /*argv*/) {
         // but that's not terribly important here.
         renderSystem.Render(G_APP->state);
 
+        // Stream in the next part of any loaded textures, and let go of assets
+        // nothing has used in a while, if we're over budget.
+        registry.Update();
+
+        // GLFW's clock starts at glfwInit, so it measures our whole startup.
+        if (!presented) {
+          glFinish();
+          cout << "Time to first frame: " << (1000.0 * glfwGetTime()) << " ms" << endl;
+          presented = true;
+        }
+
         // Interact with window
         {
-          // Update the current FPS
-          float const currentFPS = 1 / ((glfwGetTime() - newTime) + delta);
-          prevFPS = 0.05*currentFPS + 0.95*prevFPS;
+          ++hudFrames;
+          ++titleFrames;
+          hudWorstFrame = std::max(hudWorstFrame, delta);
+
+          if (newTime - hudStart >= HUD_PERIOD) {
+            double const frameSeconds = (newTime - hudStart) / hudFrames;
+            char text[Hud::MAX_TEXT];
+            make_hud_text(
+              *G_APP, renderSystem, scheduleSystem, registry,
+              frameSeconds, hudWorstFrame, (double)hudSteps / hudFrames, (double)hudAllocs / hudFrames, (double)hudAllocBytes / hudFrames,
+              text, sizeof(text)
+            );
+            renderSystem.GetHud().SetText(text);
+            hudStart = newTime;
+            hudFrames = 0;
+            hudSteps = 0;
+            hudWorstFrame = 0.0;
+            hudAllocs = 0;
+            hudAllocBytes = 0;
+          }
 
-          // viewing window title update
-          glfwSetWindowTitle(window, make_window_title(*G_APP, (int)prevFPS).c_str());
+          // viewing window title update, only when it changes
+          if (newTime - titleStart >= TITLE_PERIOD) {
+            char newTitle[sizeof(title)];
+            make_window_title(*G_APP, (int)(titleFrames / (newTime - titleStart) + 0.5), newTitle, sizeof(newTitle));
+            if (strcmp(newTitle, title) != 0) {
+              memcpy(title, newTitle, sizeof(title));
+              ALLOC_SCOPE_UNCHECKED("glfwSetWindowTitle");
+              glfwSetWindowTitle(window, title);
+            }
+            titleStart = newTime;
+            titleFrames = 0;
+          }
         }
 
-        glfwPollEvents();
+        {
+          PROFILE_ZONE("glfwPollEvents");
+          ALLOC_SCOPE_UNCHECKED("glfwPollEvents");
+          glfwPollEvents();
+        }
+
+        // Take back this frame's scratch memory, and count what the frame allocated.
+        // Growing the arena after a frame which spilled over is how it settles, so
+        // that isn't held against the frame.
+        {
+          ALLOC_SCOPE_UNCHECKED("FrameArena::Reset");
+          getFrameArena().Reset();
+        }
+        AllocFrameStats const allocs = endAllocFrame();
+        hudAllocs += allocs.count;
+        hudAllocBytes += allocs.bytes;
+
+        // Once warmed up, a frame which neither makes nor destroys an entity should allocate nothing.
+        if (allocCheckFrames > 0) {
+          ++frameCount;
+          if (frameCount == ALLOC_WARMUP_FRAMES) {
+            printAllocStats();
+          }
+
+          bool const steady = (frameCount > ALLOC_WARMUP_FRAMES && G_APP->state.entities.positions.size() == entityCount);
+          if (steady && allocs.checked > 0) {
+            cout << "Steady frame " << (allocCheckedFrames + 1) << " allocated " << allocs.checked << " times:" << endl;
+            printAllocStats();
+            exitCode = 1;
+            glfwSetWindowShouldClose(window, GL_TRUE);
+          } else if (steady && ++allocCheckedFrames == allocCheckFrames) {
+            cout << "No allocations in " << allocCheckedFrames << " steady frames" << endl;
+            glfwSetWindowShouldClose(window, GL_TRUE);
+          }
+        }
 
         // Relinquish the rest of our timeslice to other programs on this CPU.
         this_thread::yield();
       }
     }
 
+    // Save whatever the profiler caught, if it's compiled in.
+    writeProfileTrace();
+
     // Clean up after ourselves
     G_APP->OnReleaseContext();
 
@@ -220,5 +443,5 @@ int main(int /*argc*/, char** /*argv*/) {
   glfwDestroyWindow(window);
 
   glfwTerminate();
-  return 0;
+  return exitCode;
 }
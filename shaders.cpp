@@ -1,7 +1,16 @@
 #include "shaders.h"
+#include "util/debug.h"
 
+#include <sys/stat.h>
 #include <limits>
 #include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+// Whether the driver can hand us linked program binaries to cache.
+static bool program_cache_supported() {
+  return GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary;
+}
 
 // Compiles and links a GL program using shaders provided as source strings.
 //
@@ -57,6 +66,11 @@ GLuint create_program(char const* vs, size_t vs_length, char const* fs, size_t f
   glAttachShader(program, fragment_shader);
   glDeleteShader(fragment_shader);
 
+  // Allow the linked binary to be retrieved for the program cache.
+  if (program_cache_supported()) {
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+
   glLinkProgram(program);
 
   {
@@ -78,49 +92,265 @@ GLuint create_program(char const* vs, size_t vs_length, char const* fs, size_t f
   return program;
 }
 
-// Compiles and links a GL shader program using shaders loaded from the filesystem.
-GLuint create_program_from_files(char const* vs_path, char const* fs_path) {
-  char vs[256*1024];  // shader size up to 256 KiB
-  size_t vs_length = 0;
+// Compiles and links a GL compute program using a shader provided as a source string.
+GLuint create_compute_program(char const* cs, size_t cs_length) {
+  if (cs_length > std::numeric_limits<GLint>::max()) {
+    fprintf(stderr, "Compute shader source too long for OpenGL\n");
+    return GL_NONE;
+  }
+
+  GLuint compute_shader = glCreateShader(GL_COMPUTE_SHADER);
+  GLuint program = glCreateProgram();
+
   {
-    FILE* f = fopen(vs_path, "r");
-    if (!f) {
-      fprintf(stderr, "Unable to open file '%s'.\n", vs_path);
-      return GL_NONE;
-    }
+    GLint const length = (GLint)cs_length;
+    glShaderSource(compute_shader, 1, &cs, &length);
+    glCompileShader(compute_shader);
+
+    GLint success;
+    glGetShaderiv(compute_shader, GL_COMPILE_STATUS, &success);
+    if (success != GL_TRUE) {
+      GLchar log[1024];
+      glGetShaderInfoLog(compute_shader, sizeof(log), nullptr, log);
 
-    vs_length = fread(vs, 1, sizeof(vs), f);
-    if (!feof(f)) {
-      fprintf(stderr, "Vertex shader too long to load from disk.\n");
+      fprintf(stderr, "Error compiling compute shader:\n%s\n\n", log);
+      glDeleteShader(compute_shader);
+      glDeleteProgram(program);
       return GL_NONE;
     }
+  }
 
-    fclose(f);
+  glAttachShader(program, compute_shader);
+  glDeleteShader(compute_shader);
+
+  // Allow the linked binary to be retrieved for the program cache.
+  if (program_cache_supported()) {
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
   }
 
-  char fs[256*1024];  // shader size up to 256 KiB
-  size_t fs_length = 0;
+  glLinkProgram(program);
+
   {
-    FILE* f = fopen(fs_path, "r");
-    if (!f) {
-      fprintf(stderr, "Unable to open file '%s'.\n", fs_path);
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (success != GL_TRUE) {
+      GLchar log[1024];
+      glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+
+      fprintf(stderr, "Error linking compute program:\n%s\n\n", log);
+      glDeleteProgram(program);
       return GL_NONE;
     }
+  }
 
-    fs_length = fread(fs, 1, sizeof(fs), f);
-    if (!feof(f)) {
-      fprintf(stderr, "Fragment shader too long to load from disk.\n");
-      return GL_NONE;
+  glDetachShader(program, compute_shader);
+  return program;
+}
+
+// Reads an entire file into `contents`. Returns false if the file can't be read.
+static bool read_file(char const* path, std::string* const contents) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "Unable to open file '%s'.\n", path);
+    return false;
+  }
+
+  char buffer[4096];
+  size_t count = 0;
+  contents->clear();
+  while ((count = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    contents->append(buffer, count);
+  }
+
+  bool const success = !ferror(f);
+  fclose(f);
+  return success;
+}
+
+// Inserts a #define for each symbol directly after the source's #version line.
+// A #line directive keeps compiler diagnostics pointing at the original file.
+static std::string inject_defines(std::string const& source, std::vector<std::string> const& defines) {
+  if (defines.empty()) {
+    return source;
+  }
+
+  size_t insert_at = 0;
+  if (source.compare(0, 8, "#version") == 0) {
+    insert_at = source.find('\n');
+    insert_at = (insert_at == std::string::npos) ? source.size() : insert_at + 1;
+  }
+
+  std::string result = source.substr(0, insert_at);
+  for (auto const& define : defines) {
+    result += "#define " + define + "\n";
+  }
+  result += (insert_at == 0) ? "#line 1\n" : "#line 2\n";
+  result += source.substr(insert_at);
+  return result;
+}
+
+// 64-bit FNV-1a, used to key the program binary cache.
+static uint64_t fnv1a(std::string const& data, uint64_t hash = 0xcbf29ce484222325ull) {
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// Where linked program binaries are kept between runs.
+static char const* const PROGRAM_CACHE_DIR = "shader-cache";
+
+// Identifies program binary cache files, followed by a format version.
+static char const PROGRAM_CACHE_MAGIC[8] = {'C', '4', '6', '5', 'P', 'R', 'G', '1'};
+
+// Computes the cache file path for a program built from the given sources.
+// Binaries are only valid for the driver that produced them, so the driver
+// identity is part of the key.
+static std::string program_cache_path(std::string const& vs, std::string const& fs) {
+  std::string driver;
+  driver += (char const*)glGetString(GL_VENDOR);
+  driver += '\n';
+  driver += (char const*)glGetString(GL_RENDERER);
+  driver += '\n';
+  driver += (char const*)glGetString(GL_VERSION);
+
+  uint64_t hash = fnv1a(vs);
+  hash = fnv1a(std::string(1, '\0') + fs, hash);
+  hash = fnv1a(std::string(1, '\0') + driver, hash);
+
+  char name[64];
+  snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)hash);
+  return std::string(PROGRAM_CACHE_DIR) + name;
+}
+
+// Attempts to create a program from a cached binary.
+// Returns GL_NONE if there is no usable binary, e.g. after a driver update.
+static GLuint load_cached_program(std::string const& path) {
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0) {
+    return GL_NONE;
+  }
+
+  std::string data;
+  if (!read_file(path.c_str(), &data)) {
+    return GL_NONE;
+  }
+
+  size_t const header_size = sizeof(PROGRAM_CACHE_MAGIC) + sizeof(GLenum);
+  if (data.size() <= header_size || data.compare(0, sizeof(PROGRAM_CACHE_MAGIC), PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC)) != 0) {
+    return GL_NONE;
+  }
+
+  GLenum format = GL_NONE;
+  memcpy(&format, data.data() + sizeof(PROGRAM_CACHE_MAGIC), sizeof(format));
+
+  GLuint const program = glCreateProgram();
+  glProgramBinary(program, format, data.data() + header_size, (GLsizei)(data.size() - header_size));
+
+  GLint success = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (success != GL_TRUE) {
+    glDeleteProgram(program);
+    return GL_NONE;
+  }
+
+  return program;
+}
+
+// Stores a linked program's binary so the next launch can skip compilation.
+static void store_cached_program(std::string const& path, GLuint program) {
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+
+  std::vector<char> binary(length);
+  GLenum format = GL_NONE;
+  glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+  mkdir(PROGRAM_CACHE_DIR, 0755);
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) {
+    fprintf(stderr, "Unable to write shader cache file '%s'.\n", path.c_str());
+    return;
+  }
+
+  fwrite(PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC), 1, f);
+  fwrite(&format, sizeof(format), 1, f);
+  fwrite(binary.data(), binary.size(), 1, f);
+  fclose(f);
+}
+
+// Compiles and links a GL shader program using shaders loaded from the filesystem.
+GLuint create_program_from_files(char const* vs_path, char const* fs_path, std::vector<std::string> const& defines) {
+  std::string vs;
+  std::string fs;
+  if (!read_file(vs_path, &vs) || !read_file(fs_path, &fs)) {
+    return GL_NONE;
+  }
+
+  vs = inject_defines(vs, defines);
+  fs = inject_defines(fs, defines);
+
+  GL_DEBUG_SITE(fs_path);
+
+  std::string cache_path;
+  GLuint program = GL_NONE;
+  if (program_cache_supported()) {
+    cache_path = program_cache_path(vs, fs);
+    program = load_cached_program(cache_path);
+  }
+
+  if (program == GL_NONE) {
+    program = create_program(vs.data(), vs.size(), fs.data(), fs.size());
+
+    if (program != GL_NONE && program_cache_supported()) {
+      store_cached_program(cache_path, program);
     }
+  }
+
+  labelGlObject(GL_PROGRAM, program, fs_path);
+  return program;
+}
 
-    fclose(f);
+// Compiles and links a GL compute program using a shader loaded from the filesystem.
+GLuint create_compute_program_from_file(char const* cs_path, std::vector<std::string> const& defines) {
+  std::string cs;
+  if (!read_file(cs_path, &cs)) {
+    return GL_NONE;
+  }
+
+  cs = inject_defines(cs, defines);
+
+  GL_DEBUG_SITE(cs_path);
+
+  std::string cache_path;
+  GLuint program = GL_NONE;
+  if (program_cache_supported()) {
+    cache_path = program_cache_path(cs, "");
+    program = load_cached_program(cache_path);
+  }
+
+  if (program == GL_NONE) {
+    program = create_compute_program(cs.data(), cs.size());
+
+    if (program != GL_NONE && program_cache_supported()) {
+      store_cached_program(cache_path, program);
+    }
   }
 
-  return create_program(vs, vs_length, fs, fs_length);
+  labelGlObject(GL_PROGRAM, program, cs_path);
+  return program;
 }
 
-#if GL_VALIDATE_SHADERS
+#ifdef GL_DEBUG_LAYER
 bool assertShaderValid(GLuint program) {
+  if (!isGlDebugEnabled()) {
+    return true;
+  }
+
   // Ensure that all shader inputs are available, and other such stuff.
   glValidateProgram(program);
 
@@ -130,12 +360,10 @@ bool assertShaderValid(GLuint program) {
     GLchar log[1024];
     glGetProgramInfoLog(program, sizeof(log), nullptr, log);
 
-    fprintf(stderr, "Error linking shader program:\n%s\n\n", log);
+    fprintf(stderr, "Error validating shader program:\n%s\n\n", log);
     return false;
   }
 
   return true;
 }
-#else
-bool assertShaderValid(GLuint /*program*/) {}
 #endif
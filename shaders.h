@@ -1,6 +1,8 @@
 #pragma once
 
 #include <GL/glew.h>
+#include <string>
+#include <vector>
 
 // Compiles and links a GL program using shaders provided as source strings.
 // Returns the GL handle for the program if successful, or GL_NONE otherwise.
@@ -8,10 +10,28 @@ GLuint create_program(char const* vs, size_t vs_length, char const* fs, size_t f
 
 // Compiles and links a GL shader progran using shaders loaded from the filesystem.
 // Returns the GL handle for the program if successful, or GL_NONE otherwise.
-GLuint create_program_from_files(char const* vs_path, char const* fs_path);
+//
+// Each entry of `defines` is injected as a `#define` after the #version line of
+// both shaders, so one source file can yield several program variants.
+// Linked programs are cached on disk (when the driver supports program binaries),
+// keyed by the final source text and the driver identity.
+GLuint create_program_from_files(char const* vs_path, char const* fs_path, std::vector<std::string> const& defines = {});
+
+// Compiles and links a GL compute program (GL 4.3+) using a shader provided as a source string.
+// Returns the GL handle for the program if successful, or GL_NONE otherwise.
+GLuint create_compute_program(char const* cs, size_t cs_length);
+
+// Compiles and links a GL compute program (GL 4.3+) using a shader loaded from the filesystem.
+// Defines and caching behave as for create_program_from_files.
+GLuint create_compute_program_from_file(char const* cs_path, std::vector<std::string> const& defines = {});
 
 // Checks if a shader's state requirements are satisfied, e.g. a VAO is present.
 // If it is, returns true; otherwise, returns false and prints a message to stderr.
 //
-// When GL_VALIDATE_SHADERS is false, always returns true.
+// Validation stalls the pipeline, so it only happens when the GL validation
+// layer (util/debug.h) is compiled in and enabled. Otherwise, always returns true.
+#ifdef GL_DEBUG_LAYER
 bool assertShaderValid(GLuint program);
+#else
+inline bool assertShaderValid(GLuint /*program*/) { return true; }
+#endif
@@ -0,0 +1,58 @@
+#version 430 core
+
+// Frustum-culls instances and builds the indirect draw commands for the
+// surviving ones. See IndirectRenderer.h.
+
+layout(local_size_x = 64) in;
+
+// A mirror of IndirectInstance in IndirectRenderer.h
+struct Instance {
+  mat4 worldMatrix;
+  mat4 normalMatrix;
+  vec4 emissivity;
+  vec4 sphere;  // World-space bounding sphere: center, radius
+  uint mesh;
+};
+
+// A DrawElementsIndirectCommand
+struct DrawCommand {
+  uint count;
+  uint instanceCount;
+  uint firstIndex;
+  uint baseVertex;
+  uint baseInstance;
+};
+
+layout(std430, binding=0) readonly buffer Instances {
+  Instance instances[];
+};
+
+layout(std430, binding=1) buffer Commands {
+  DrawCommand commands[];  // One per mesh
+};
+
+layout(std430, binding=2) writeonly buffer Visible {
+  uint visible[];  // Indices of visible instances, in per-mesh ranges starting at baseInstance
+};
+
+// Frustum planes, with normals pointing inwards
+uniform vec4 u_frustumPlanes[6];
+uniform uint u_instanceCount;
+
+void main() {
+  uint index = gl_GlobalInvocationID.x;
+  if (index >= u_instanceCount) {
+    return;
+  }
+
+  vec4 sphere = instances[index].sphere;
+  for (int i = 0; i < 6; ++i) {
+    if (dot(u_frustumPlanes[i].xyz, sphere.xyz) + u_frustumPlanes[i].w < -sphere.w) {
+      return;  // Entirely outside this plane
+    }
+  }
+
+  uint mesh = instances[index].mesh;
+  uint slot = atomicAdd(commands[mesh].instanceCount, 1u);
+  visible[commands[mesh].baseInstance + slot] = index;
+}
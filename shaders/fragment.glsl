@@ -1,5 +1,9 @@
 #version 330 core
 
+// This shader is compiled once per lighting configuration. The renderer defines
+// any of LIGHT_RUBER, LIGHT_GLOBAL and LIGHT_HEADLIGHT for the lights which are
+// switched on, so lights which are off cost nothing per fragment.
+
 // Represents all of the parameters for a single light source
 struct Light {
   vec3 position;
@@ -10,13 +14,28 @@ struct Light {
   vec3 specular;
 
   float attenuation;
-  bool enabled;  // Whether the light should be utilized
 };
 
-// The three light sources we process in this shader
-uniform Light u_ruberLight;
-uniform Light u_globalLight;
-uniform Light u_headLight;
+// The light sources we process in this shader
+#ifdef LIGHT_RUBER
+uniform Light u_ruberLight;  // Point light
+#endif
+#ifdef LIGHT_GLOBAL
+uniform Light u_globalLight;  // Point light
+#endif
+#ifdef LIGHT_HEADLIGHT
+uniform Light u_headLight;  // Directional light
+#endif
+
+// Dynamic point lights, binned into view-space clusters on the CPU (see LightClusters.h).
+// The cluster layout (CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_SLICES) is defined by the renderer.
+uniform usamplerBuffer u_clusterGrid;  // Per cluster: (offset into u_clusterIndices, count)
+uniform usamplerBuffer u_clusterIndices;  // Light indices into u_clusterLights
+uniform samplerBuffer u_clusterLights;  // Per light: (position, radius), (radiance, 0)
+uniform vec2 u_clusterTileSize;  // Size of a cluster tile in pixels
+uniform float u_clusterNear;
+uniform float u_clusterFar;
+uniform float u_clusterSliceScale;  // Maps log(depth / near) to a slice index
 
 // The position of the viewer in world space
 uniform vec3 u_viewPosition;
@@ -27,48 +46,83 @@ in vec3 position;
 in vec3 normal;
 // The material properties of the fragment
 in vec4 color;
+#ifdef GPU_DRIVEN
+// Emissivity is per instance when drawing through shaders/indirect-vertex.glsl.
+flat in vec4 emissivity;
+#define u_emissivity emissivity
+#else
 uniform vec4 u_emissivity;
+#endif
 
 layout(location=0) out vec4 fragColor;
 
-// Applies a point/directional light to the current fragment.
-vec4 applyLighting(Light light) {
-  if (!light.enabled) {
-    return vec4(0, 0, 0, 1);
-  }
+// Applies a light arriving from `to_light` (normalized) to the current fragment.
+// `lit` scales the diffuse and specular terms.
+vec4 shade(Light light, vec3 to_light, float dist_light, float lit) {
+  vec3 to_eye = normalize(u_viewPosition - position);
 
-  vec3 to_light;
-  if (length(light.direction) == 0) {
-    to_light = light.position - position;
-  } else {
-    to_light = -light.direction;
-  }
+  vec3 ambientFactor = light.ambient;
+  vec3 diffuseFactor = lit * light.diffuse * max(0, dot(normal, to_light));
+  vec3 specularFactor = lit * light.specular * pow(max(0, dot(to_eye, reflect(-to_light, normal))), 16);
 
-  float dist_light = length(to_light);
-  to_light = normalize(to_light);
+  float attenuation = 1.0/(1.0 + light.attenuation*dist_light*dist_light);
+  return vec4(ambientFactor + diffuseFactor + specularFactor, 1) * attenuation * color;
+}
 
-  vec3 to_eye = u_viewPosition - position;
-  float dist_eye = length(to_eye);
-  to_eye = normalize(to_eye);
+// Applies a point light to the current fragment.
+vec4 applyPointLight(Light light) {
+  vec3 to_light = light.position - position;
+  return shade(light, normalize(to_light), length(to_light), 1.0);
+}
 
-  vec3 ambientFactor = light.ambient;
-  vec3 diffuseFactor = vec3(0, 0, 0);
-  vec3 specularFactor = vec3(0, 0, 0);
-  if (dot(light.direction, u_viewPosition - light.position) <= 0) {
-    diffuseFactor = light.diffuse * max(0, dot(normal, to_light));
-    specularFactor = light.specular * pow(max(0, dot(to_eye, reflect(-to_light, normal))), 16);
+// Applies a directional light to the current fragment.
+// Only viewers on the lit side of the light's origin see its diffuse/specular terms.
+vec4 applyDirectionalLight(Light light) {
+  float lit = step(dot(light.direction, u_viewPosition - light.position), 0.0);
+  return shade(light, normalize(-light.direction), 1.0, lit);
+}
+
+// Applies the dynamic lights overlapping this fragment's cluster.
+vec4 applyClusteredLights() {
+  // Recover the fragment's view-space depth to find its depth slice.
+  float ndc_z = 2.0*gl_FragCoord.z - 1.0;
+  float depth = 2.0*u_clusterNear*u_clusterFar / (u_clusterFar + u_clusterNear - ndc_z*(u_clusterFar - u_clusterNear));
+
+  int slice = clamp(int(log(depth/u_clusterNear) * u_clusterSliceScale), 0, CLUSTER_SLICES - 1);
+  ivec2 tile = clamp(ivec2(gl_FragCoord.xy / u_clusterTileSize), ivec2(0, 0), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+  int cluster = (slice*CLUSTER_TILES_Y + tile.y)*CLUSTER_TILES_X + tile.x;
+
+  uvec2 range = texelFetch(u_clusterGrid, cluster).xy;
+
+  vec3 radiance = vec3(0, 0, 0);
+  for (uint i = 0u; i < range.y; ++i) {
+    int light = int(texelFetch(u_clusterIndices, int(range.x + i)).x);
+    vec4 position_radius = texelFetch(u_clusterLights, 2*light);
+    vec3 light_radiance = texelFetch(u_clusterLights, 2*light + 1).rgb;
+
+    vec3 to_light = position_radius.xyz - position;
+    float dist_light = length(to_light);
+    float falloff = clamp(1.0 - dist_light/position_radius.w, 0.0, 1.0);
+
+    radiance += light_radiance * falloff*falloff * max(0, dot(normal, to_light/dist_light));
   }
 
-  float attenuation = 1.0/(1.0 + light.attenuation*dist_light*dist_light);
-  return vec4(ambientFactor + diffuseFactor + specularFactor, 1) * attenuation * color;
+  return vec4(radiance * color.rgb, 0);
 }
 
 void main() {
   vec4 accumulatedColor = vec4(0, 0, 0, 0);
   accumulatedColor += u_emissivity; // Emissive light for this fragment
-  accumulatedColor += applyLighting(u_ruberLight); // Light from Ruber
-  accumulatedColor += applyLighting(u_globalLight); // Global illumination
-  accumulatedColor += applyLighting(u_headLight); // Directional illumination
+#ifdef LIGHT_RUBER
+  accumulatedColor += applyPointLight(u_ruberLight); // Light from Ruber
+#endif
+#ifdef LIGHT_GLOBAL
+  accumulatedColor += applyPointLight(u_globalLight); // Global illumination
+#endif
+#ifdef LIGHT_HEADLIGHT
+  accumulatedColor += applyDirectionalLight(u_headLight); // Directional illumination
+#endif
+  accumulatedColor += applyClusteredLights(); // Missile glows, silo beacons, etc.
 
   fragColor = accumulatedColor;
 }
@@ -0,0 +1,15 @@
+#version 330 core
+
+uniform sampler2D u_atlas;  // Glyph coverage in red
+
+in vec2 texCoord;
+in vec4 color;
+layout(location=0) out vec4 o_color;
+
+void main() {
+  float coverage = texture(u_atlas, texCoord).r;
+  if (coverage == 0) {
+    discard;
+  }
+  o_color = vec4(color.rgb, color.a*coverage);
+}
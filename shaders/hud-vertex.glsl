@@ -0,0 +1,29 @@
+#version 330 core
+
+// The size of a pixel in normalized device coordinates.
+uniform vec2 u_pixelSize;
+// The size of a glyph cell in texture coordinates.
+uniform vec2 u_cellSize;
+
+// One quad per instance (see HudQuad in Hud.h)
+layout(location=0) in vec4 v_rect;  // Top-left corner and size, in pixels from the top left
+layout(location=1) in vec4 v_color;
+layout(location=2) in uint v_glyph;  // Cell of the glyph atlas, row by row
+
+out vec2 texCoord;
+out vec4 color;
+
+// The corners of a quad, as a triangle strip, with y pointing down the screen.
+const vec2 CORNERS[4] = vec2[4](vec2(0, 1), vec2(1, 1), vec2(0, 0), vec2(1, 0));
+
+void main() {
+  vec2 corner = CORNERS[gl_VertexID];
+  vec2 pixel = v_rect.xy + corner*v_rect.zw;
+  gl_Position = vec4(pixel.x*u_pixelSize.x - 1, 1 - pixel.y*u_pixelSize.y, 0, 1);
+
+  // Atlas rows run down the texture, as glTexImage2D laid them out.
+  int columns = int(1/u_cellSize.x + 0.5);
+  vec2 cell = vec2(int(v_glyph) % columns, int(v_glyph) / columns);
+  texCoord = (cell + corner)*u_cellSize;
+  color = v_color;
+}
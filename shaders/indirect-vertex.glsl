@@ -0,0 +1,42 @@
+#version 430 core
+
+// The vertex shader for GPU-driven rendering (see IndirectRenderer.h).
+// Per-instance data comes from a storage buffer rather than uniforms.
+
+// A mirror of IndirectInstance in IndirectRenderer.h.
+// worldMatrix includes the mesh's position decoding (see Mesh::GetPositionMatrix).
+struct Instance {
+  mat4 worldMatrix;
+  mat4 normalMatrix;
+  vec4 emissivity;
+  vec4 sphere;
+  uint mesh;
+};
+
+layout(std430, binding=0) readonly buffer Instances {
+  Instance instances[];
+};
+
+uniform mat4 viewProjectionMatrix;
+
+layout(location=0) in vec3 v_position;
+layout(location=1) in vec3 v_normal;
+layout(location=2) in vec4 v_color;
+layout(location=3) in uint v_instance;  // Index into `instances`, from the visible list
+
+out vec3 position;
+out vec3 normal;
+out vec4 color;
+flat out vec4 emissivity;
+
+void main() {
+  Instance instance = instances[v_instance];
+
+  vec4 worldPosition = instance.worldMatrix * vec4(v_position, 1.0);
+  position = vec3(worldPosition);
+  normal = normalize(mat3(instance.normalMatrix)*v_normal);
+  color = v_color;
+  emissivity = instance.emissivity;
+
+  gl_Position = viewProjectionMatrix * worldPosition;
+}
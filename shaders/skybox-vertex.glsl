@@ -2,10 +2,14 @@
 
 uniform mat4 mvpMatrix;
 
+// Decodes the mesh's packed positions (see PackedVertex in MeshData.h)
+uniform vec3 u_positionOffset;
+uniform vec3 u_positionScale;
+
 layout(location=0) in vec3 v_position;
 out vec3 coord;
 
 void main() {
-  coord = v_position;
-  gl_Position = mvpMatrix*vec4(v_position, 1);
+  coord = u_positionOffset + u_positionScale*v_position;
+  gl_Position = mvpMatrix*vec4(coord, 1);
 }
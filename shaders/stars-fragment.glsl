@@ -0,0 +1,15 @@
+#version 330 core
+
+in vec2 corner;  // Position within the star's quad, from -1 to 1
+in vec4 color;
+layout(location=0) out vec4 o_color;
+
+void main() {
+  // A soft disc, brightest at the center.
+  float r2 = dot(corner, corner);
+  if (r2 > 1) {
+    discard;
+  }
+  float falloff = (1 - r2)*(1 - r2);
+  o_color = vec4(color.rgb*color.a*falloff, 1);
+}
@@ -0,0 +1,29 @@
+#version 330 core
+
+// Takes directions to clip space: the projection times the rotation of the view.
+uniform mat4 u_skyMatrix;
+// The size of a pixel in normalized device coordinates.
+uniform vec2 u_pixelSize;
+
+// One star per instance (see StarVertex in StarField.h)
+layout(location=0) in vec4 v_star;  // Direction, and sprite diameter in pixels
+layout(location=1) in vec4 v_color;  // RGB, and brightness
+
+out vec2 corner;
+out vec4 color;
+
+// The corners of a quad, as a triangle strip wound counter-clockwise.
+const vec2 CORNERS[4] = vec2[4](vec2(-1, -1), vec2(1, -1), vec2(-1, 1), vec2(1, 1));
+
+void main() {
+  corner = CORNERS[gl_VertexID];
+  color = v_color;
+
+  // A direction (w = 0) is a point at infinity; pin it to the far plane.
+  vec4 clip = u_skyMatrix*vec4(v_star.xyz, 0);
+  clip.z = clip.w;
+
+  // Grow the quad in screen space, so that every star keeps its size in pixels.
+  clip.xy += corner*(0.5*v_star.w)*u_pixelSize*clip.w;
+  gl_Position = clip;
+}
@@ -1,5 +1,7 @@
 #version 330 core
 
+// worldMatrix and mvpMatrix include the mesh's position decoding, since
+// positions arrive normalized onto the mesh's bounding box.
 uniform mat4 worldMatrix;
 uniform mat3 normalMatrix;
 uniform mat4 mvpMatrix;
@@ -0,0 +1,166 @@
+// Checks that a steady simulation step allocates nothing on the heap.
+//
+// Usage: alloccheck [steps]
+// Builds a scene like the game's (the Ruber system, its silos, the ship and the
+// cameras, plus missiles homing in from far off) without any GL, and warms it up.
+// It then steps every simulation system, and walks the entity queries, for `steps`
+// steps (default 2,000). It fails at the first step which allocates, printing where
+// the allocations came from. Nothing is created or destroyed meanwhile: the ship
+// stays out of the silos' range, and the missiles never get near anything.
+//
+// Only built when allocation tracking is compiled in (-DALLOC_TRACKING=ON), and
+// run by ctest.
+
+#include "../CollisionSystem.h"
+#include "../GravitySystem.h"
+#include "../MissileSystem.h"
+#include "../ScheduleSystem.h"
+#include "../SiloSystem.h"
+#include "../util/alloc.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+// The game's fine time step, in seconds.
+static double const STEP = 0.005;
+
+// Steps taken before checking, while the systems' scratch space grows to fit.
+static int const WARMUP_STEPS = 100;
+
+// Missiles in flight, in a grid high above the orbital plane.
+static int const MISSILE_ROWS = 6;
+
+// A mesh of the given bounding radius, which makes no GL calls.
+static MeshHandle MakeMesh(float bounding_radius) {
+  std::shared_ptr<Mesh> mesh{new Mesh{}};
+  mesh->boundingRadius = bounding_radius;
+  return MeshHandle{std::make_shared<std::shared_ptr<Mesh>>(mesh)};
+}
+
+// Adds a body orbiting its parent, as the game's planets and moons do.
+static void AddOrbiter(EntityDatabase& entities, char const* id, char const* parent, float distance, double period, float mass, MeshHandle const& mesh) {
+  glm::vec3 const translation{distance, 0.0f, 0.0f};
+  entities.positions.insert(std::make_pair(id, PositionComponent{parent, translation}));
+  entities.orbits.insert(std::make_pair(id, OrbitComponent{translation, 2.0 * M_PI / period, (float)(2.0 * M_PI / period)}));
+  entities.models.insert(std::make_pair(id, ModelComponent{mesh}));
+  entities.masses.insert(std::make_pair(id, MassComponent{mass}));
+}
+
+static void AddSilo(EntityDatabase& entities, char const* id, char const* parent, float height, MeshHandle const& mesh) {
+  entities.positions.insert(std::make_pair(id, PositionComponent{parent, glm::vec3{0.0f, height, 0.0f}}));
+  entities.models.insert(std::make_pair(id, ModelComponent{mesh}));
+  entities.silos.insert(std::make_pair(id, SiloComponent{5, 5000.0, 5000.0, 125.0}));
+  entities.schedules.insert(std::make_pair(id, ScheduleComponent{}));
+}
+
+static void BuildScene(GameState& state, MeshHandle const& missileMesh) {
+  EntityDatabase& entities = state.entities;
+  state.gravity_enabled = true;
+
+  entities.positions.insert(std::make_pair("Ruber", PositionComponent{"::world", glm::vec3{0.0f}}));
+  entities.models.insert(std::make_pair("Ruber", ModelComponent{MakeMesh(2000.0f)}));
+  entities.masses.insert(std::make_pair("Ruber", MassComponent{90000000.0f, true}));
+
+  MeshHandle const planet = MakeMesh(400.0f);
+  MeshHandle const moon = MakeMesh(150.0f);
+  MeshHandle const silo = MakeMesh(30.0f);
+  AddOrbiter(entities, "Unum", "Ruber", 4000.0f, 63.0, 1000000.0f, planet);
+  AddOrbiter(entities, "Duo", "Ruber", -9000.0f, 126.0, 2000000.0f, planet);
+  AddOrbiter(entities, "Primus", "Duo", 900.0f, 63.0, 250000.0f, moon);
+  AddOrbiter(entities, "Secundus", "Duo", 1750.0f, 126.0, 500000.0f, moon);
+  AddSilo(entities, "Unum Silo", "Unum", 250.0f, silo);
+  AddSilo(entities, "Secundus Silo", "Secundus", 200.0f, silo);
+
+  // Further from the sun than any silo can reach.
+  entities.positions.insert(std::make_pair("ship", PositionComponent{"::world", glm::vec3{15000.0f, 0.0f, 15000.0f}}));
+  entities.models.insert(std::make_pair("ship", ModelComponent{MakeMesh(30.0f), 10.0f}));
+  entities.masses.insert(std::make_pair("ship", MassComponent{1.0f}));
+  entities.silos.insert(std::make_pair("ship", SiloComponent{10, 0.0, 5000.0, 500.0}));
+
+  for (int i = 0; i < (int)(sizeof(CAMERAS) / sizeof(CAMERAS[0])); ++i) {
+    entities.positions.insert(std::make_pair(CAMERAS[i], PositionComponent{"::world", glm::vec3{0.0f, 10000.0f, 20000.0f}}));
+    entities.cameras.insert(std::make_pair(CAMERAS[i], CameraComponent{glm::vec3{0.0f}, glm::vec3{0.0f, 1.0f, 0.0f}}));
+  }
+
+  // Missiles from both sides, homing on targets thousands of units below them, so
+  // that some are scheduled in every tier. The names are long enough to be on the heap.
+  for (int row = 0; row < MISSILE_ROWS; ++row) {
+    for (int column = 0; column < MISSILE_ROWS; ++column) {
+      bool const ours = ((row + column) % 2 == 0);
+      char id[64];
+      snprintf(id, sizeof(id), "missile: %s %d", ours ? "ship" : "Unum Silo", row * MISSILE_ROWS + column);
+      glm::vec3 const position{-3000.0f + 1200.0f * column, 5000.0f, -3000.0f + 1200.0f * row};
+
+      MissileComponent missile{ours ? "ship" : "Unum Silo", ours ? SILO_TARGETING : SHIP_TARGETING, 100000.0, 125.0};
+      missile.time_to_live = MissileComponent::MAX_LIFETIME - MissileComponent::IDLE_PERIOD;
+      entities.positions.insert(std::make_pair(id, PositionComponent{"::world", position}));
+      entities.missiles.insert(std::make_pair(id, missile));
+      entities.models.insert(std::make_pair(id, ModelComponent{missileMesh, 10.0f}));
+      entities.masses.insert(std::make_pair(id, MassComponent{0.1f}));
+      entities.schedules.insert(std::make_pair(id, ScheduleComponent{}));
+    }
+  }
+}
+
+// Walks the queries the systems don't, as rendering does.
+static float WalkQueries(EntityDatabase& entities) {
+  float sum = 0.0f;
+  for (CollidableEntity entity : entities.Query<CollidableEntity>()) {
+    sum += entity.model->mesh->boundingRadius;
+  }
+  for (PositionComponent* position : entities.Query<PositionComponent>()) {
+    sum += position->translation.y;
+  }
+  return sum;
+}
+
+int main(int argc, char** argv) {
+  int const steps = (argc > 1) ? atoi(argv[1]) : 2000;
+  if (!isAllocTrackingEnabled()) {
+    printf("alloccheck needs allocation tracking; configure with -DALLOC_TRACKING=ON.\n");
+    return 1;
+  }
+
+  MeshHandle const missileMesh = MakeMesh(10.0f);
+  GameState state;
+  BuildScene(state, missileMesh);
+  size_t const entityCount = state.entities.positions.size();
+
+  CollisionSystem collisionSystem{};
+  ScheduleSystem scheduleSystem{};
+  GravitySystem gravitySystem{GravitySettings{}};
+  MissileSystem missileSystem{};
+  SiloSystem siloSystem{&missileMesh};
+
+  volatile float sink = 0.0f;
+  for (int step = -WARMUP_STEPS; step < steps; ++step) {
+    // The same systems in the same order as the game loop, which advances the clock in App::OnTimeStep.
+    {
+      ALLOC_SCOPE("step");
+      state.entities.time += STEP;
+      collisionSystem.Update(state, STEP);
+      scheduleSystem.Update(state, STEP);
+      gravitySystem.Update(state, STEP);
+      missileSystem.Update(state, STEP);
+      siloSystem.Update(state, STEP);
+      sink = WalkQueries(state.entities);
+    }
+    AllocFrameStats const allocs = endAllocFrame();
+
+    if (state.entities.positions.size() != entityCount) {
+      printf("Step %d made or destroyed entities; the scene isn't steady.\n", step);
+      return 1;
+    }
+    if (step >= 0 && allocs.checked > 0) {
+      printf("Steady step %d allocated %u times:\n", step + 1, (unsigned)allocs.checked);
+      printAllocStats();
+      return 1;
+    }
+  }
+
+  (void)sink;
+  printf("No allocations in %d steady steps of %u entities\n", steps, (unsigned)entityCount);
+  return 0;
+}
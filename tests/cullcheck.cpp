@@ -0,0 +1,224 @@
+// Checks GPU-driven culling against the CPU's frustum test.
+//
+// Usage: cullcheck [frames]
+// Opens a hidden window with a GL 4.3 context, and registers two small meshes of
+// two levels of detail each with an IndirectRenderer. Each frame (default 8), it
+// draws a fixed, scattered set of instances through IndirectRenderer::Draw, from a
+// camera turning about the origin, then reads back the draw commands and visible
+// list which shaders/cull.glsl wrote. It fails unless each mesh LOD slot's command
+// counts exactly the instances isSphereInFrustum keeps, its range of the visible
+// list holds exactly those instances, and GL raised no errors.
+//
+// Run by ctest on Mesa's software rasterizer (LIBGL_ALWAYS_SOFTWARE=1), from the
+// source directory so shaders/cull.glsl can be found. Exits with status 77, which
+// ctest counts as skipped, where no GL 4.3 context can be made.
+
+#include "../IndirectRenderer.h"
+#include "../shaders.h"
+
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// ctest's SKIP_RETURN_CODE for this test
+static int const SKIP = 77;
+
+static int const INSTANCE_COUNT = 1000;
+
+// Instances whose spheres come this close to crossing a frustum plane are left
+// out, so that rounding differences between the GPU and CPU can't decide them.
+static float const PLANE_MARGIN = 0.01f;
+
+static int const COMMAND_WORDS = 5;
+
+// A tetrahedron: its full detail is all four faces, and its coarse level one face.
+// Only the index ranges matter here, since the test program draws nothing visible.
+static Mesh MakeMesh(char const* label) {
+  MeshData data;
+  data.vertices.assign(4, PackedVertex{});
+  data.indices = {0, 1, 2, 0, 3, 1, 1, 3, 2, 2, 3, 0};
+  data.lods = {MeshLod{0, 12}, MeshLod{0, 3}};
+  data.boundingRadius = 1.0f;
+  return uploadMesh(label, data);
+}
+
+// A small deterministic generator, so every run culls the same scene.
+static float Random(unsigned* const state) {
+  *state = *state * 1664525u + 1013904223u;
+  return (float)(*state >> 8) / (float)(1u << 24);
+}
+
+// Whether a sphere sits within PLANE_MARGIN of being culled or kept by some plane.
+static bool IsNearPlane(glm::vec4 const planes[6], glm::vec4 sphere) {
+  for (int i = 0; i < 6; ++i) {
+    float const distance = glm::dot(glm::vec3{planes[i]}, glm::vec3{sphere}) + planes[i].w + sphere.w;
+    if (std::abs(distance) < PLANE_MARGIN) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Compares one frame's read-back culling results with the CPU's.
+// Returns the number of visible instances, or -1 after printing a mismatch.
+static int CheckFrame(int frame, std::vector<IndirectInstance> const& instances, std::vector<bool> const& expected, GLuint slot_count, std::vector<GLuint> const& commands, std::vector<GLuint> const& visible) {
+  if (commands.size() != COMMAND_WORDS * slot_count) {
+    printf("cullcheck: frame %d: read back %d command words, not %d\n", frame, (int)commands.size(), (int)(COMMAND_WORDS * slot_count));
+    return -1;
+  }
+
+  int visible_count = 0;
+  GLuint base_instance = 0;
+  std::vector<GLuint> gpu;
+  std::vector<GLuint> cpu;
+  for (GLuint slot = 0; slot < slot_count; ++slot) {
+    cpu.clear();
+    GLuint slot_instances = 0;
+    for (size_t i = 0; i < instances.size(); ++i) {
+      if (instances[i].mesh == slot) {
+        slot_instances += 1;
+        if (expected[i]) {
+          cpu.push_back((GLuint)i);
+        }
+      }
+    }
+
+    GLuint const instance_count = commands[COMMAND_WORDS*slot + 1];
+    GLuint const first = commands[COMMAND_WORDS*slot + 4];
+    if (first != base_instance || instance_count != cpu.size()) {
+      printf("cullcheck: frame %d: slot %u draws %u instances from %u; the CPU keeps %d, from %u\n", frame, slot, instance_count, first, (int)cpu.size(), base_instance);
+      return -1;
+    }
+
+    // The cull shader appends in whatever order its invocations run.
+    gpu.assign(visible.begin() + first, visible.begin() + first + instance_count);
+    std::sort(gpu.begin(), gpu.end());
+    if (gpu != cpu) {
+      printf("cullcheck: frame %d: slot %u's visible instances differ from the CPU's\n", frame, slot);
+      return -1;
+    }
+
+    visible_count += (int)instance_count;
+    base_instance += slot_instances;
+  }
+  return visible_count;
+}
+
+int main(int argc, char** argv) {
+  int const frames = (argc > 1) ? atoi(argv[1]) : 8;
+
+  if (!glfwInit()) {
+    printf("cullcheck: GLFW could not initialize; skipping\n");
+    return SKIP;
+  }
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  GLFWwindow* const window = glfwCreateWindow(64, 64, "cullcheck", nullptr, nullptr);
+  if (!window) {
+    printf("cullcheck: no GL 4.3 context; skipping\n");
+    glfwTerminate();
+    return SKIP;
+  }
+  glfwMakeContextCurrent(window);
+
+  glewExperimental = GL_TRUE;
+  if (glewInit() != GLEW_OK || !IndirectRenderer::IsSupported()) {
+    printf("cullcheck: GL 4.3 is not supported; skipping\n");
+    glfwTerminate();
+    return SKIP;
+  }
+
+  int result = EXIT_SUCCESS;
+  {
+    IndirectRenderer renderer;
+    Mesh const meshes[2] = {MakeMesh("cullcheck mesh 0"), MakeMesh("cullcheck mesh 1")};
+    GLuint slots[4];
+    for (int i = 0; i < 4; ++i) {
+      slots[i] = renderer.GetMeshSlot(meshes[i / 2], i % 2);
+    }
+    GLuint const slot_count = 4;
+
+    // A program which draws nothing, but still consumes every command.
+    static char const vs[] = "#version 430 core\nvoid main() { gl_Position = vec4(2.0, 2.0, 2.0, 1.0); }\n";
+    static char const fs[] = "#version 430 core\nout vec4 color;\nvoid main() { color = vec4(1.0); }\n";
+    GLuint const program = create_program(vs, sizeof(vs) - 1, fs, sizeof(fs) - 1);
+    if (program == GL_NONE) {
+      glfwTerminate();
+      return EXIT_FAILURE;
+    }
+
+    glm::mat4 const projection = glm::perspective(glm::radians(60.0f), 1.0f, 1.0f, 400.0f);
+    std::vector<IndirectInstance> instances;
+    std::vector<bool> expected;
+    std::vector<GLuint> commands;
+    std::vector<GLuint> visible;
+    int total_visible = 0;
+    int total_checked = 0;
+    for (int frame = 0; frame < frames && result == EXIT_SUCCESS; ++frame) {
+      float const angle = glm::radians(360.0f * frame / std::max(frames, 1));
+      glm::mat4 const view = glm::lookAt(glm::vec3{0.0f}, glm::vec3{std::sin(angle), 0.25f, std::cos(angle)}, glm::vec3{0.0f, 1.0f, 0.0f});
+      glm::mat4 const viewProjection = projection * view;
+      glm::vec4 planes[6];
+      getFrustumPlanes(viewProjection, planes);
+
+      // The same scattered spheres each frame, around the camera, some beyond the far plane.
+      instances.clear();
+      expected.clear();
+      unsigned seed = 465;
+      while ((int)instances.size() < INSTANCE_COUNT) {
+        glm::vec4 sphere{
+          500.0f * Random(&seed) - 250.0f,
+          500.0f * Random(&seed) - 250.0f,
+          500.0f * Random(&seed) - 250.0f,
+          0.5f + 20.0f * Random(&seed),
+        };
+        GLuint const mesh = slots[(int)(4.0f * Random(&seed)) % 4];
+        if (IsNearPlane(planes, sphere)) {
+          continue;
+        }
+        IndirectInstance instance{};
+        instance.worldMatrix = glm::translate(glm::mat4{1.0f}, glm::vec3{sphere});
+        instance.normalMatrix = glm::mat4{1.0f};
+        instance.sphere = sphere;
+        instance.mesh = mesh;
+        instances.push_back(instance);
+        expected.push_back(isSphereInFrustum(planes, sphere));
+      }
+
+      glClear(GL_COLOR_BUFFER_BIT);
+      renderer.Draw(program, instances, viewProjection);
+      renderer.ReadBack(&commands, &visible);
+      glfwSwapBuffers(window);
+
+      GLenum const error = glGetError();
+      if (error != GL_NO_ERROR) {
+        printf("cullcheck: frame %d: GL error 0x%04x\n", frame, error);
+        result = EXIT_FAILURE;
+        break;
+      }
+
+      int const visible_count = CheckFrame(frame, instances, expected, slot_count, commands, visible);
+      if (visible_count < 0) {
+        result = EXIT_FAILURE;
+        break;
+      }
+      total_visible += visible_count;
+      total_checked += (int)instances.size();
+    }
+
+    if (result == EXIT_SUCCESS) {
+      printf("cullcheck: %d frames, %d of %d instances visible, all as the CPU culls them\n", frames, total_visible, total_checked);
+    }
+    glDeleteProgram(program);
+  }
+
+  glfwDestroyWindow(window);
+  glfwTerminate();
+  return result;
+}
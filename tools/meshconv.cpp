@@ -0,0 +1,136 @@
+// Converts .TRI and AC3D (.ac) models into the binary .mesh format (see MeshFile.h).
+//
+// Usage: meshconv [--size <extent>] <input.tri|input.ac> [output.mesh]
+// The output defaults to the input path with a .mesh extension.
+//
+// AC3D models keep their smooth shading and shared vertices (see MeshAc3d.h).
+// --size centers an AC3D model and scales it so that the longest side of its
+// bounding box is <extent> units long, as the .TRI conversions were.
+//
+// Also checks that the packed vertices (see PackedVertex in MeshData.h) decode
+// close enough to the originals to render identically, and fails if they don't.
+
+#include "../MeshAc3d.h"
+#include "../MeshData.h"
+#include "../MeshFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// The largest decoding errors allowed for packed vertices.
+static float const MAX_POSITION_ERROR = 1e-4f;  // Relative to the bounding radius
+static float const MAX_NORMAL_ERROR = 0.5f;  // In degrees
+static float const MAX_COLOR_ERROR = 0.5f / 255.0f + 1e-6f;  // Rounding to the nearest byte
+
+// Centers a soup's bounding box on the origin, and scales it so that its longest side is `size` long.
+static void FitSoup(std::vector<GLfloat>* const soup, float size) {
+  size_t const vertex_floats = MESH_SOURCE_VERTEX_FLOATS;
+  if (soup->empty()) {
+    return;
+  }
+
+  glm::vec3 min{(*soup)[0], (*soup)[1], (*soup)[2]};
+  glm::vec3 max = min;
+  for (size_t i = 0; i < soup->size(); i += vertex_floats) {
+    glm::vec3 const position{(*soup)[i], (*soup)[i+1], (*soup)[i+2]};
+    min = glm::min(min, position);
+    max = glm::max(max, position);
+  }
+
+  glm::vec3 const center = 0.5f * (min + max);
+  glm::vec3 const extent = max - min;
+  float const scale = size / std::max(std::max(std::max(extent.x, extent.y), extent.z), 1e-6f);
+  for (size_t i = 0; i < soup->size(); i += vertex_floats) {
+    for (int axis = 0; axis < 3; ++axis) {
+      (*soup)[i + axis] = ((*soup)[i + axis] - center[axis]) * scale;
+    }
+  }
+}
+
+static bool HasExtension(char const* path, char const* extension) {
+  size_t const length = strlen(path);
+  size_t const extension_length = strlen(extension);
+  return length >= extension_length && strcmp(path + length - extension_length, extension) == 0;
+}
+
+int main(int argc, char** argv) {
+  float size = 0.0f;  // Zero keeps the model's own size
+  int arg = 1;
+  if (arg + 1 < argc && strcmp(argv[arg], "--size") == 0) {
+    size = (float)atof(argv[arg + 1]);
+    arg += 2;
+  }
+
+  if (argc - arg < 1 || argc - arg > 2 || size < 0.0f) {
+    fprintf(stderr, "Usage: %s [--size <extent>] <input.tri|input.ac> [output.mesh]\n", argv[0]);
+    return 2;
+  }
+
+  char const* const tri_path = argv[arg];
+  std::string const mesh_path = (argc - arg > 1) ? argv[arg + 1] : getMeshFilePath(tri_path);
+
+  MeshData data;
+  MeshReport report;
+  if (HasExtension(tri_path, ".ac")) {
+    std::vector<GLfloat> soup;
+    float crease_degrees = 0.0f;
+    if (!readAc3dFile(tri_path, &soup, &crease_degrees)) {
+      return 1;
+    }
+    if (size > 0.0f) {
+      FitSoup(&soup, size);
+    }
+    buildMeshData(soup, &data, &report, crease_degrees);
+  } else if (size > 0.0f) {
+    fprintf(stderr, "--size only applies to AC3D models.\n");
+    return 2;
+  } else if (!loadTriMeshData(tri_path, &data, &report)) {
+    return 1;
+  }
+
+  printf("%s -> %s\n", tri_path, mesh_path.c_str());
+  printf("  LOD  triangles  vertices (unindexed -> welded)  ACMR (welded -> optimized)\n");
+  for (size_t i = 0; i < report.lods.size(); ++i) {
+    MeshLodReport const& lod = report.lods[i];
+    printf("  %3u  %9u  %10u -> %-6u  %16.3f -> %.3f\n",
+      (unsigned)i,
+      (unsigned)lod.triangles,
+      (unsigned)lod.soupVertices,
+      (unsigned)lod.vertices,
+      lod.weldedAcmr,
+      lod.optimizedAcmr
+    );
+  }
+  printf("  %u -> %u bytes of vertices (%u -> %u bytes each), %u bytes of indices\n",
+    (unsigned)report.sourceVertexBytes,
+    (unsigned)report.packedVertexBytes,
+    (unsigned)(MESH_SOURCE_VERTEX_FLOATS * sizeof(GLfloat)),
+    (unsigned)MESH_VERTEX_STRIDE,
+    (unsigned)(sizeof(GLuint) * data.indices.size())
+  );
+
+  float const relative_position_error = report.maxPositionError / std::max(data.boundingRadius, 1e-6f);
+  printf("  packing error: position %g (%g of radius), normal %.3f deg, color %.5f\n",
+    report.maxPositionError,
+    relative_position_error,
+    report.maxNormalError,
+    report.maxColorError
+  );
+
+  if (relative_position_error > MAX_POSITION_ERROR
+      || report.maxNormalError > MAX_NORMAL_ERROR
+      || report.maxColorError > MAX_COLOR_ERROR) {
+    fprintf(stderr, "'%s': packed vertices differ visibly from the model.\n", tri_path);
+    return 1;
+  }
+
+  if (!writeMeshFile(mesh_path.c_str(), data)) {
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,63 @@
+// Converts .RAW images (tightly-packed 24-bit RGB) into the compressed .tex format
+// (see TextureFile.h), with a full mip chain.
+//
+// Usage: texconv <input.raw> <width> <height> [output.tex]
+// The output defaults to the input path with a .tex extension.
+//
+// The game converts images itself the first time it loads them, so this only
+// saves that first run the work.
+
+#include "../TextureData.h"
+#include "../TextureFile.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+  if (argc < 4 || argc > 5) {
+    fprintf(stderr, "Usage: %s <input.raw> <width> <height> [output.tex]\n", argv[0]);
+    return 2;
+  }
+
+  char const* const raw_path = argv[1];
+  int const width = atoi(argv[2]);
+  int const height = atoi(argv[3]);
+  std::string const texture_path = (argc > 4) ? argv[4] : getTextureFilePath(raw_path);
+  if (width <= 0 || height <= 0) {
+    fprintf(stderr, "Bad image size %sx%s.\n", argv[2], argv[3]);
+    return 2;
+  }
+
+  std::vector<unsigned char> rgb(3 * (size_t)width * height);
+  FILE* f = fopen(raw_path, "rb");
+  if (!f) {
+    fprintf(stderr, "Unable to open file '%s'.\n", raw_path);
+    return 1;
+  }
+  bool const read = fread(rgb.data(), rgb.size(), 1, f) == 1;
+  fclose(f);
+  if (!read) {
+    fprintf(stderr, "'%s' is smaller than %dx%d RGB pixels.\n", raw_path, width, height);
+    return 1;
+  }
+
+  TextureData data;
+  TextureReport report;
+  buildTextureData(rgb.data(), width, height, &data, &report);
+  if (!writeTextureFile(texture_path.c_str(), data)) {
+    return 1;
+  }
+
+  printf("%s: %dx%d, %u mip levels, %.1f KB -> %.1f KB (%.1fx smaller), %.1f dB PSNR\n",
+    texture_path.c_str(),
+    width, height,
+    (unsigned)data.levels.size(),
+    report.sourceBytes / 1024.0,
+    report.compressedBytes / 1024.0,
+    (double)report.sourceBytes / report.compressedBytes,
+    report.psnr
+  );
+  return 0;
+}
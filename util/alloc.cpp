@@ -0,0 +1,171 @@
+#include "alloc.h"
+
+#ifdef ALLOC_TRACKING
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Distinct scope names counted per thread; allocations in any more go to the thread itself.
+static int const MAX_SCOPES = 64;
+
+// Scopes nested deeper than this count towards the one enclosing them.
+static int const MAX_DEPTH = 32;
+
+struct ScopeCounts {
+  char const* name;  // Null for allocations outside of any scope
+  bool unchecked;
+
+  uint64_t count, bytes;  // In the current frame
+  uint64_t last_count, last_bytes;  // In the last frame ended
+  uint64_t total_count, total_bytes;  // Over the frames since the last print
+  uint64_t worst_count, worst_bytes;  // In the busiest of those frames
+};
+
+// Plain data, zeroed at thread start, so that counting never allocates itself.
+struct ThreadCounts {
+  ScopeCounts scopes[MAX_SCOPES];  // The first holds allocations outside of any scope
+  int scope_count;  // Zero until the first scope opens
+  int stack[MAX_DEPTH];  // Open scopes, innermost last, by index into `scopes`
+  int depth;
+  uint64_t frames;  // Ended since the last print
+};
+
+static thread_local ThreadCounts t_counts;
+
+static void Count(size_t size) {
+  ThreadCounts& counts = t_counts;
+  ScopeCounts& scope = counts.scopes[(counts.depth > 0) ? counts.stack[counts.depth - 1] : 0];
+  scope.count += 1;
+  scope.bytes += size;
+}
+
+void* operator new(std::size_t size) {
+  Count(size);
+  void* const pointer = std::malloc(std::max(size, (std::size_t)1));
+  if (!pointer) {
+    throw std::bad_alloc{};
+  }
+  return pointer;
+}
+
+void* operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept {
+  Count(size);
+  return std::malloc(std::max(size, (std::size_t)1));
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept {
+  return operator new(size, std::nothrow);
+}
+
+void operator delete(void* pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::nothrow_t const&) noexcept {
+  std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::nothrow_t const&) noexcept {
+  std::free(pointer);
+}
+
+AllocScope::AllocScope(char const* name, bool checked) {
+  ThreadCounts& counts = t_counts;
+  this->pushed = (counts.depth < MAX_DEPTH);
+  if (!this->pushed) {
+    return;
+  }
+
+  // Names are literals, so the same scope always has the same pointer.
+  counts.scope_count = std::max(counts.scope_count, 1);
+  int index = 1;
+  while (index < counts.scope_count && counts.scopes[index].name != name) {
+    ++index;
+  }
+  if (index == counts.scope_count) {
+    if (index == MAX_SCOPES) {
+      index = 0;
+    } else {
+      counts.scopes[index].name = name;
+      counts.scopes[index].unchecked = !checked;
+      ++counts.scope_count;
+    }
+  }
+
+  counts.stack[counts.depth++] = index;
+}
+
+AllocScope::~AllocScope() {
+  if (this->pushed) {
+    --t_counts.depth;
+  }
+}
+
+AllocFrameStats endAllocFrame() {
+  ThreadCounts& counts = t_counts;
+  AllocFrameStats frame;
+  for (int i = 0; i < std::max(counts.scope_count, 1); ++i) {
+    ScopeCounts& scope = counts.scopes[i];
+    frame.count += scope.count;
+    frame.bytes += scope.bytes;
+    if (!scope.unchecked) {
+      frame.checked += scope.count;
+    }
+
+    scope.last_count = scope.count;
+    scope.last_bytes = scope.bytes;
+    scope.total_count += scope.count;
+    scope.total_bytes += scope.bytes;
+    if (scope.count > scope.worst_count) {
+      scope.worst_count = scope.count;
+      scope.worst_bytes = scope.bytes;
+    }
+    scope.count = 0;
+    scope.bytes = 0;
+  }
+  counts.frames += 1;
+  return frame;
+}
+
+void printAllocStats() {
+  ThreadCounts& counts = t_counts;
+  uint64_t const frames = std::max(counts.frames, (uint64_t)1);
+
+  // Copy the counts out first: printing may allocate, and count towards them.
+  int const scope_count = std::max(counts.scope_count, 1);
+  ScopeCounts scopes[MAX_SCOPES];
+  std::copy(counts.scopes, counts.scopes + scope_count, scopes);
+
+  printf("Heap allocations over the last %u frames:\n", (unsigned)counts.frames);
+  printf("  %-28s %17s %17s %17s\n", "scope", "last frame", "per frame", "worst frame");
+  for (int i = 0; i < scope_count; ++i) {
+    ScopeCounts const& scope = scopes[i];
+    printf("  %-28s %6u (%7.1f KB) %6.1f (%7.1f KB) %6u (%7.1f KB)%s\n",
+      scope.name ? scope.name : "(outside scopes)",
+      (unsigned)scope.last_count, scope.last_bytes / 1024.0,
+      (double)scope.total_count / frames, (double)scope.total_bytes / frames / 1024.0,
+      (unsigned)scope.worst_count, scope.worst_bytes / 1024.0,
+      scope.unchecked ? " unchecked" : ""
+    );
+  }
+
+  for (int i = 0; i < scope_count; ++i) {
+    counts.scopes[i].total_count = 0;
+    counts.scopes[i].total_bytes = 0;
+    counts.scopes[i].worst_count = 0;
+    counts.scopes[i].worst_bytes = 0;
+  }
+  counts.frames = 0;
+}
+
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap allocation tracking, per frame and per scope.
+//
+// Tracking is only compiled in when ALLOC_TRACKING is defined (configure with
+// -DALLOC_TRACKING=ON). Otherwise ALLOC_SCOPE expands to nothing and every
+// function below is an empty inline, so normal builds keep the standard
+// operator new.
+//
+// When compiled in, the global operator new counts every allocation, and its
+// size, against the innermost ALLOC_SCOPE open on the calling thread (or against
+// the thread itself, outside of any scope). A scope counts only what it allocates
+// itself, not what the scopes nested inside it do. Counting takes no locks, and
+// allocates nothing: each thread keeps its own counts.
+//
+// A frame ends at each call to endAllocFrame, which folds the calling thread's
+// counts into its totals; other threads (the asset loader's, say) keep theirs
+// apart. The game loop ends a frame on the main thread, which simulates and
+// renders, and expects a frame in a steady state to allocate nothing there.
+
+// What a thread allocated over a frame.
+struct AllocFrameStats {
+  uint64_t count = 0;
+  uint64_t bytes = 0;
+
+  // Allocations outside of ALLOC_SCOPE_UNCHECKED scopes; the ones which ought not to happen.
+  uint64_t checked = 0;
+};
+
+#ifdef ALLOC_TRACKING
+
+inline bool isAllocTrackingEnabled() { return true; }
+
+// Ends the calling thread's frame, and returns what it allocated.
+AllocFrameStats endAllocFrame();
+
+// Prints what each of the calling thread's scopes allocated in its last frame,
+// on average per frame, and in its worst frame, since the last print.
+void printAllocStats();
+
+// Counts allocations during the lifetime of this object under `name`, which
+// must outlive the program; a string literal, say.
+class AllocScope {
+private:
+  bool pushed;
+
+public:
+  AllocScope(char const* name, bool checked);
+  ~AllocScope();
+
+  AllocScope(AllocScope const&) = delete;
+  AllocScope& operator=(AllocScope const&) = delete;
+};
+
+#define ALLOC_CONCAT_INNER(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_INNER(a, b)
+
+// Counts allocations in the rest of the enclosing scope under the given name.
+#define ALLOC_SCOPE(name) AllocScope const ALLOC_CONCAT(alloc_scope_, __LINE__){(name), true}
+
+// The same, for calls into libraries (the window system, say) whose allocations
+// are out of our hands, and don't fail a steady frame.
+#define ALLOC_SCOPE_UNCHECKED(name) AllocScope const ALLOC_CONCAT(alloc_scope_, __LINE__){(name), false}
+
+#else
+
+inline bool isAllocTrackingEnabled() { return false; }
+inline AllocFrameStats endAllocFrame() { return AllocFrameStats{}; }
+inline void printAllocStats() {}
+
+#define ALLOC_SCOPE(name) ((void)0)
+#define ALLOC_SCOPE_UNCHECKED(name) ((void)0)
+
+#endif
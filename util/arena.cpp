@@ -0,0 +1,43 @@
+#include "arena.h"
+
+#include <algorithm>
+
+// Enough for the main thread's scratch lists in a typical frame.
+static size_t const FRAME_ARENA_BYTES = 64 * 1024;
+
+FrameArena::FrameArena(size_t capacity)
+  : block{new char[capacity]}, capacity{capacity}
+{}
+
+void* FrameArena::Allocate(size_t bytes, size_t alignment) {
+  // Blocks from new[] are aligned for any fundamental type, so offsets need only be aligned.
+  size_t const start = (this->used + alignment - 1) & ~(alignment - 1);
+  if (start + bytes <= this->capacity) {
+    this->used = start + bytes;
+    return this->block.get() + start;
+  }
+
+  this->overflow.emplace_back(new char[std::max(bytes, (size_t)1)]);
+  this->overflowBytes += bytes;
+  return this->overflow.back().get();
+}
+
+void FrameArena::Reset() {
+  if (!this->overflow.empty()) {
+    // Grow geometrically, so that a slowly growing load settles after a few resets.
+    this->capacity = std::max(2 * this->capacity, this->used + this->overflowBytes);
+    this->block.reset(new char[this->capacity]);
+    this->overflow.clear();
+    this->overflowBytes = 0;
+  }
+  this->used = 0;
+}
+
+size_t FrameArena::GetCapacity() const {
+  return this->capacity;
+}
+
+FrameArena& getFrameArena() {
+  static FrameArena arena{FRAME_ARENA_BYTES};
+  return arena;
+}
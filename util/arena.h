@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// A bump allocator, for scratch data which lives no longer than a frame.
+//
+// Allocating hands out the next bytes of one block, and freeing does nothing:
+// Reset takes everything back at once, at the end of each frame. A frame which
+// needs more than the block holds spills over into blocks of their own from the
+// heap, and the next Reset replaces the block with one which holds all of it. So
+// once the arena has seen the busiest frame, it never touches the heap again.
+class FrameArena {
+private:
+  std::unique_ptr<char[]> block;
+  size_t capacity = 0;
+  size_t used = 0;
+
+  std::vector<std::unique_ptr<char[]>> overflow;  // This frame's spills
+  size_t overflowBytes = 0;
+
+public:
+  explicit FrameArena(size_t capacity);
+
+  FrameArena(FrameArena const&) = delete;
+  FrameArena& operator=(FrameArena const&) = delete;
+
+  // Returns `bytes` of memory aligned to `alignment`, a power of two no larger
+  // than that of std::max_align_t, which stays valid until the next Reset.
+  void* Allocate(size_t bytes, size_t alignment);
+
+  // Frees everything allocated since the last Reset, at once.
+  void Reset();
+
+  size_t GetCapacity() const;
+};
+
+// A standard allocator drawing from a FrameArena, for containers which are
+// thrown away within the frame they're built in.
+template<typename T>
+struct FrameAllocator {
+  typedef T value_type;
+
+  FrameArena* arena;
+
+  explicit FrameAllocator(FrameArena& arena)
+    : arena{&arena}
+  {}
+
+  template<typename U>
+  FrameAllocator(FrameAllocator<U> const& other)
+    : arena{other.arena}
+  {}
+
+  T* allocate(size_t count) {
+    return static_cast<T*>(this->arena->Allocate(count * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* /*pointer*/, size_t /*count*/) {}
+};
+
+template<typename T, typename U>
+bool operator==(FrameAllocator<T> const& a, FrameAllocator<U> const& b) {
+  return a.arena == b.arena;
+}
+
+template<typename T, typename U>
+bool operator!=(FrameAllocator<T> const& a, FrameAllocator<U> const& b) {
+  return a.arena != b.arena;
+}
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+// The main thread's arena, which the game loop resets after every frame. Only
+// use it from the main thread.
+FrameArena& getFrameArena();
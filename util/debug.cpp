@@ -1,36 +1,155 @@
-#include <GL/glew.h>
+#include "debug.h"
+
+#ifdef GL_DEBUG_LAYER
+
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 using namespace std;
 
-void showCurrentGlError() {
-  switch (glGetError()) {
-    case GL_NO_ERROR: {
-      cout << "GL_NO_ERROR: No error." << endl;
-    } break;
+// The most recently marked call site.
+static char const* g_site_file = "<unknown>";
+static int g_site_line = 0;
+static char const* g_site_what = "";
+
+// The debug groups we are currently nested within, for reporting purposes.
+static int const MAX_GROUP_DEPTH = 16;
+static char const* g_groups[MAX_GROUP_DEPTH];
+static int g_group_depth = 0;
+
+// Whether the driver reports to us through KHR_debug, or we must poll.
+static bool g_has_khr_debug = false;
+
+static char const* describeGlError(GLenum error) {
+  switch (error) {
+    case GL_NO_ERROR: return "GL_NO_ERROR: No error.";
+    case GL_INVALID_ENUM: return "GL_INVALID_ENUM: An unacceptable value is specified for an enumerated argument.";
+    case GL_INVALID_VALUE: return "GL_INVALID_VALUE: A numeric argument is out of range.";
+    case GL_INVALID_OPERATION: return "GL_INVALID_OPERATION: The specified operation is not allowed in the current state.";
+    case GL_INVALID_FRAMEBUFFER_OPERATION: return "GL_INVALID_FRAMEBUFFER_OPERATION: The framebuffer object is not complete.";
+    case GL_OUT_OF_MEMORY: return "GL_OUT_OF_MEMORY: There is not enough memory left to execute the command.";
+    default: return "Unknown error.";
+  }
+}
+
+static char const* describeSeverity(GLenum severity) {
+  switch (severity) {
+    case GL_DEBUG_SEVERITY_HIGH: return "high";
+    case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+    case GL_DEBUG_SEVERITY_LOW: return "low";
+    default: return "info";
+  }
+}
+
+// Prints the call site and debug group stack that a message belongs to.
+static void reportContext() {
+  cerr << "  at " << g_site_file << ":" << g_site_line;
+  if (g_site_what[0] != '\0') {
+    cerr << " (" << g_site_what << ")";
+  }
+  cerr << endl;
 
-    case GL_INVALID_ENUM: {
-      cout << "GL_INVALID_ENUM: An unacceptable value is specified for an enumerated argument." << endl;
-    } break;
+  for (int i = g_group_depth; i > 0; --i) {
+    if (i <= MAX_GROUP_DEPTH) {
+      cerr << "  in group '" << g_groups[i-1] << "'" << endl;
+    }
+  }
+}
 
-    case GL_INVALID_VALUE: {
-      cout << "GL_INVALID_VALUE: A numeric argument is out of range." << endl;
-    } break;
+static void GLAPIENTRY onGlDebugMessage(
+  GLenum /*source*/, GLenum type, GLuint id, GLenum severity,
+  GLsizei /*length*/, GLchar const* message, void const* /*userParam*/
+) {
+  // Notifications are mostly buffer placement chatter; skip them.
+  if (severity == GL_DEBUG_SEVERITY_NOTIFICATION) {
+    return;
+  }
 
-    case GL_INVALID_OPERATION: {
-      cout << "GL_INVALID_OPERATION: The specified operation is not allowed in the current state." << endl;
-    } break;
+  cerr << "GL " << (type == GL_DEBUG_TYPE_ERROR ? "error" : "warning")
+       << " [" << describeSeverity(severity) << ", id " << id << "]: "
+       << message << endl;
+  reportContext();
+}
 
-    case GL_INVALID_FRAMEBUFFER_OPERATION: {
-      cout << "GL_INVALID_FRAMEBUFFER_OPERATION: The framebuffer object is not complete." << endl;
-    } break;
+bool isGlDebugEnabled() {
+  static bool const enabled = [](){
+    char const* setting = getenv("COMP465_GL_DEBUG");
+    return !(setting && strcmp(setting, "0") == 0);
+  }();
 
-    case GL_OUT_OF_MEMORY: {
-      cout << "GL_OUT_OF_MEMORY: There is not enough memory left to execute the command." << endl;
-    } break;
+  return enabled;
+}
 
-    default: {
-      cout << "Unknown error." << endl;
-    } break;
+void installGlDebugOutput() {
+  if (!isGlDebugEnabled()) {
+    return;
   }
+
+  g_has_khr_debug = (GLEW_KHR_debug || GLEW_VERSION_4_3);
+  if (!g_has_khr_debug) {
+    cerr << "KHR_debug unavailable; GL errors will be polled at marked call sites." << endl;
+    return;
+  }
+
+  // Synchronous output makes the callback run inside the offending GL call,
+  // so the last marked call site is the right one to report.
+  glEnable(GL_DEBUG_OUTPUT);
+  glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  glDebugMessageCallback(&onGlDebugMessage, nullptr);
+  glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
 }
+
+void labelGlObject(GLenum identifier, GLuint name, char const* label) {
+  if (!isGlDebugEnabled() || !g_has_khr_debug || name == GL_NONE) {
+    return;
+  }
+
+  glObjectLabel(identifier, name, -1, label);
+}
+
+void pushGlDebugGroup(char const* name) {
+  if (!isGlDebugEnabled()) {
+    return;
+  }
+
+  if (g_group_depth < MAX_GROUP_DEPTH) {
+    g_groups[g_group_depth] = name;
+  }
+  g_group_depth += 1;
+
+  if (g_has_khr_debug) {
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+  }
+}
+
+void popGlDebugGroup() {
+  if (!isGlDebugEnabled() || g_group_depth == 0) {
+    return;
+  }
+
+  if (g_has_khr_debug) {
+    glPopDebugGroup();
+  }
+  g_group_depth -= 1;
+}
+
+void markGlCallSite(char const* file, int line, char const* what) {
+  if (!isGlDebugEnabled()) {
+    return;
+  }
+
+  // Without KHR_debug, drain any errors raised since the previous site.
+  if (!g_has_khr_debug) {
+    for (GLenum error = glGetError(); error != GL_NO_ERROR; error = glGetError()) {
+      cerr << "GL error: " << describeGlError(error) << endl;
+      reportContext();
+    }
+  }
+
+  g_site_file = file;
+  g_site_line = line;
+  g_site_what = what;
+}
+
+#endif
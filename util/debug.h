@@ -1,4 +1,50 @@
 #pragma once
 
-// Prints the current OpenGL error to stderr.
-void showCurrentGlError();
+#include <GL/glew.h>
+
+// A validation layer for OpenGL, built on KHR_debug.
+//
+// The layer is only compiled in when GL_DEBUG_LAYER is defined (Debug builds,
+// or when configured with -DGL_DEBUG_LAYER=ON). Otherwise every function below
+// is an empty inline and GL_DEBUG_SITE expands to nothing, so release builds
+// pay nothing for it.
+//
+// When compiled in, the layer is active unless the COMP465_GL_DEBUG
+// environment variable is set to "0".
+
+#ifdef GL_DEBUG_LAYER
+
+// Returns true if the validation layer should run in this process.
+// Safe to call before a GL context exists (e.g. to request a debug context).
+bool isGlDebugEnabled();
+
+// Hooks the validation layer into the current GL context.
+// Uses glDebugMessageCallback when KHR_debug is available; otherwise falls
+// back to polling glGetError at every GL_DEBUG_SITE.
+void installGlDebugOutput();
+
+// Attaches a human-readable label to a GL object, so that driver messages
+// about it can be traced back to the asset that created it.
+void labelGlObject(GLenum identifier, GLuint name, char const* label);
+
+// Names the region of GL calls that follows, until the matching pop.
+void pushGlDebugGroup(char const* name);
+void popGlDebugGroup();
+
+// Records the call site of the GL calls that follow. Messages raised by the
+// driver are reported against the most recently recorded site.
+void markGlCallSite(char const* file, int line, char const* what);
+
+#define GL_DEBUG_SITE(what) markGlCallSite(__FILE__, __LINE__, (what))
+
+#else
+
+inline bool isGlDebugEnabled() { return false; }
+inline void installGlDebugOutput() {}
+inline void labelGlObject(GLenum /*identifier*/, GLuint /*name*/, char const* /*label*/) {}
+inline void pushGlDebugGroup(char const* /*name*/) {}
+inline void popGlDebugGroup() {}
+
+#define GL_DEBUG_SITE(what) ((void)0)
+
+#endif
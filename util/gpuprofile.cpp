@@ -0,0 +1,91 @@
+#include "gpuprofile.h"
+
+#ifdef PROFILER
+
+// How often GL time is re-sampled against profiler time, in frames, to follow any drift between the clocks.
+static unsigned const CALIBRATION_PERIOD = 120;
+
+GpuProfiler::GpuProfiler() {
+  // Timer queries are core in GL 3.3.
+  this->supported = (GLEW_VERSION_3_3 || GLEW_ARB_timer_query);
+  if (!this->supported) {
+    return;
+  }
+
+  for (Frame& frame : this->frames) {
+    glGenQueries(2 * MAX_ZONES, frame.queries);
+  }
+  Calibrate();
+}
+
+GpuProfiler::~GpuProfiler() {
+  if (this->supported) {
+    for (Frame& frame : this->frames) {
+      glDeleteQueries(2 * MAX_ZONES, frame.queries);
+    }
+  }
+}
+
+int GpuProfiler::Begin(char const* name) {
+  Frame& frame = this->frames[this->current];
+  if (!this->supported || frame.zoneCount == MAX_ZONES) {
+    return -1;
+  }
+
+  int const zone = frame.zoneCount++;
+  frame.names[zone] = name;
+  glQueryCounter(frame.queries[2 * zone], GL_TIMESTAMP);
+  frame.lastQuery = 2 * zone;
+  return zone;
+}
+
+void GpuProfiler::End(int zone) {
+  if (zone >= 0) {
+    Frame& frame = this->frames[this->current];
+    glQueryCounter(frame.queries[2 * zone + 1], GL_TIMESTAMP);
+    frame.lastQuery = 2 * zone + 1;
+  }
+}
+
+void GpuProfiler::EndFrame() {
+  if (!this->supported) {
+    return;
+  }
+
+  if (++this->framesSinceCalibration >= CALIBRATION_PERIOD) {
+    Calibrate();
+  }
+
+  // The next frame's queries were issued FRAME_LATENCY - 1 frames ago. Collect
+  // them if the GPU is done with them; otherwise it's too far behind, and
+  // waiting would only hold us back further. Timestamps are written in the order
+  // their queries were issued, so once the last is in, so are all the others.
+  // That's the end of an enclosing zone (the whole frame's) rather than of the
+  // last zone begun.
+  this->current = (this->current + 1) % FRAME_LATENCY;
+  Frame& frame = this->frames[this->current];
+  if (frame.zoneCount > 0) {
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(frame.queries[frame.lastQuery], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+      for (int zone = 0; zone < frame.zoneCount; ++zone) {
+        GLuint64 begin = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(frame.queries[2 * zone], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame.queries[2 * zone + 1], GL_QUERY_RESULT, &end);
+        recordGpuProfileZone(frame.names[zone], (uint64_t)((int64_t)begin + this->clockOffset), (uint64_t)((int64_t)end + this->clockOffset));
+      }
+    }
+  }
+  frame.zoneCount = 0;
+  frame.lastQuery = -1;
+}
+
+void GpuProfiler::Calibrate() {
+  GLint64 gl_time = 0;
+  glGetInteger64v(GL_TIMESTAMP, &gl_time);
+  this->clockOffset = (int64_t)getProfileTime() - (int64_t)gl_time;
+  this->framesSinceCalibration = 0;
+}
+
+#endif
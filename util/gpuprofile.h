@@ -0,0 +1,92 @@
+#pragma once
+
+#include "profile.h"
+
+#include <GL/glew.h>
+
+// Times passes on the GPU, and merges them into the CPU profiler's timeline (see
+// profile.h) as zones on a "GPU" track.
+//
+// Like the CPU profiler, this is only compiled in when PROFILER is defined;
+// otherwise GpuProfiler is empty and GPU_PROFILE_ZONE expands to nothing.
+//
+// Each zone is a pair of GL_TIMESTAMP queries. Results are read back
+// FRAME_LATENCY frames later, by which time the GPU has long finished with them,
+// so reading them never stalls; a frame whose results still aren't in is dropped.
+// GL timestamps are mapped onto the profiler's clock by sampling both now and then.
+
+#ifdef PROFILER
+
+class GpuProfiler {
+private:
+  static int const FRAME_LATENCY = 4;  // Frames between issuing queries and reading them
+  static int const MAX_ZONES = 32;  // Per frame; any more go untimed
+
+  struct Frame {
+    GLuint queries[2 * MAX_ZONES] = {};  // Begin and end timestamps of each zone
+    char const* names[MAX_ZONES] = {};
+    int zoneCount = 0;
+    int lastQuery = -1;  // Index in `queries` of the one issued last; timestamps land in issue order
+  };
+
+  bool supported = false;  // Whether the driver has timer queries
+  Frame frames[FRAME_LATENCY];
+  int current = 0;  // The frame being recorded
+
+  int64_t clockOffset = 0;  // Profiler time less GL time, in nanoseconds
+  unsigned framesSinceCalibration = 0;
+
+public:
+  GpuProfiler();
+  ~GpuProfiler();
+
+  GpuProfiler(GpuProfiler const&) = delete;
+  GpuProfiler& operator=(GpuProfiler const&) = delete;
+
+  // Starts timing a zone; returns its index for End, or -1 if it can't be timed.
+  // `name` must outlive the profiler; a string literal, say.
+  int Begin(char const* name);
+  void End(int zone);
+
+  // Call after the last zone of each frame. Passes the results of the oldest
+  // frame to the CPU profiler, and starts a new frame.
+  void EndFrame();
+
+private:
+  void Calibrate();
+};
+
+// Times the GL commands issued during this object's lifetime.
+class GpuProfileZone {
+private:
+  GpuProfiler& profiler;
+  int zone;
+
+public:
+  GpuProfileZone(GpuProfiler& profiler, char const* name)
+    : profiler(profiler), zone{profiler.Begin(name)}
+  {}
+
+  ~GpuProfileZone() {
+    this->profiler.End(this->zone);
+  }
+
+  GpuProfileZone(GpuProfileZone const&) = delete;
+  GpuProfileZone& operator=(GpuProfileZone const&) = delete;
+};
+
+// Times the GL commands in the rest of the enclosing scope under the given name.
+#define GPU_PROFILE_ZONE(profiler, name) GpuProfileZone const PROFILE_CONCAT(gpu_profile_zone_, __LINE__){(profiler), (name)}
+
+#else
+
+class GpuProfiler {
+public:
+  int Begin(char const* /*name*/) { return -1; }
+  void End(int /*zone*/) {}
+  void EndFrame() {}
+};
+
+#define GPU_PROFILE_ZONE(profiler, name) ((void)0)
+
+#endif
@@ -0,0 +1,219 @@
+#include "profile.h"
+
+#ifdef PROFILER
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+
+typedef std::chrono::steady_clock Clock;
+
+// Zones which ended longer ago than this are left out of the statistics.
+static uint64_t const STATS_WINDOW = 5000000000ull;  // 5 s
+
+struct ProfileEvent {
+  char const* name;
+  uint64_t begin;
+  uint64_t end;
+};
+
+// The zones recorded by one thread. Only that thread writes to it.
+struct ThreadLog {
+  // Enough for several seconds of zones at a few hundred steps per second.
+  static size_t const CAPACITY = 1 << 16;
+
+  ProfileEvent events[CAPACITY];  // A ring, indexed by event count modulo CAPACITY
+  std::atomic<uint64_t> written{0};  // Events ever recorded; published after each is written
+
+  unsigned id = 0;
+  std::string name;
+};
+
+// Every thread's log, kept after the thread exits so its zones still show up.
+static std::mutex g_logs_mutex;
+static std::vector<std::unique_ptr<ThreadLog>> g_logs;
+
+static thread_local ThreadLog* t_log = nullptr;
+
+// Copies out the events in a log. The writer may carry on meanwhile; any events
+// it could have overwritten during the copy are dropped.
+static std::vector<ProfileEvent> ReadLog(ThreadLog const& log) {
+  uint64_t const end = log.written.load(std::memory_order_acquire);
+  uint64_t begin = (end > ThreadLog::CAPACITY) ? end - ThreadLog::CAPACITY : 0;
+
+  // The copies race with the writer on purpose, as a seqlock's readers do: a slot
+  // may be torn while it's copied, and the check below throws out any which could be.
+  std::vector<ProfileEvent> events;
+  events.reserve((size_t)(end - begin));
+  for (uint64_t i = begin; i < end; ++i) {
+    events.push_back(log.events[i % ThreadLog::CAPACITY]);
+  }
+
+  // An acquire load only orders what comes after it, and the copies come before; this
+  // fence keeps them from being reordered past the recheck, so that any slot the
+  // copies could have seen mid-write is counted in `after`.
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  // With `after` events published, the writer may be storing event `after` already,
+  // over event `after - CAPACITY`; so only events from `after + 1 - CAPACITY` on are whole.
+  uint64_t const after = log.written.load(std::memory_order_relaxed);
+  if (after + 1 > ThreadLog::CAPACITY && after + 1 - ThreadLog::CAPACITY > begin) {
+    size_t const lapped = (size_t)std::min(after + 1 - ThreadLog::CAPACITY - begin, end - begin);
+    events.erase(events.begin(), events.begin() + lapped);
+  }
+  return events;
+}
+
+// Writes a string as a JSON string literal.
+static void WriteJsonString(FILE* file, char const* string) {
+  fputc('"', file);
+  for (char const* c = string; *c; ++c) {
+    if (*c == '"' || *c == '\\') {
+      fputc('\\', file);
+    }
+    fputc(*c, file);
+  }
+  fputc('"', file);
+}
+
+// Registers a new log under the given name.
+static ThreadLog* AddLog(std::string const& name) {
+  std::unique_ptr<ThreadLog> log{new ThreadLog};
+  ThreadLog* const result = log.get();
+
+  std::lock_guard<std::mutex> lock{g_logs_mutex};
+  log->id = (unsigned)g_logs.size() + 1;
+  log->name = name;
+  g_logs.push_back(std::move(log));
+  return result;
+}
+
+// Appends an event to a log. Only the log's one writer may call this.
+static void Record(ThreadLog* const log, char const* name, uint64_t begin, uint64_t end) {
+  uint64_t const count = log->written.load(std::memory_order_relaxed);
+  log->events[count % ThreadLog::CAPACITY] = ProfileEvent{name, begin, end};
+  log->written.store(count + 1, std::memory_order_release);
+}
+
+uint64_t getProfileTime() {
+  static Clock::time_point const start = Clock::now();
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+// The calling thread's log, registering it on first use.
+static ThreadLog* GetThreadLog() {
+  if (!t_log) {
+    static std::atomic<unsigned> thread_count{0};
+    t_log = AddLog("thread " + std::to_string(++thread_count));
+  }
+  return t_log;
+}
+
+void recordProfileZone(char const* name, uint64_t begin, uint64_t end) {
+  Record(GetThreadLog(), name, begin, end);
+}
+
+void recordGpuProfileZone(char const* name, uint64_t begin, uint64_t end) {
+  static ThreadLog* const gpu_log = AddLog("GPU");
+  Record(gpu_log, name, begin, end);
+}
+
+void nameProfileThread(char const* name) {
+  ThreadLog* const log = GetThreadLog();
+
+  std::lock_guard<std::mutex> lock{g_logs_mutex};
+  log->name = name;
+}
+
+bool writeProfileTrace() {
+  char const* path = getenv("COMP465_PROFILE_TRACE");
+  if (!path || path[0] == '\0') {
+    path = "trace.json";
+  }
+
+  FILE* const file = fopen(path, "w");
+  if (!file) {
+    fprintf(stderr, "Unable to write the profile trace to %s\n", path);
+    return false;
+  }
+
+  // Trace timestamps are in microseconds; keep the nanoseconds as fractions.
+  fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  bool first = true;
+  size_t event_count = 0;
+  {
+    std::lock_guard<std::mutex> lock{g_logs_mutex};
+    for (std::unique_ptr<ThreadLog> const& log : g_logs) {
+      fprintf(file, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", first ? "" : ",\n", log->id);
+      WriteJsonString(file, log->name.c_str());
+      fprintf(file, "}}");
+      first = false;
+
+      for (ProfileEvent const& event : ReadLog(*log)) {
+        fprintf(file, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":",
+          log->id, event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+        WriteJsonString(file, event.name);
+        fprintf(file, "}");
+        ++event_count;
+      }
+    }
+  }
+  fprintf(file, "\n]}\n");
+
+  bool const ok = (fclose(file) == 0);
+  if (ok) {
+    printf("Wrote %u profiled zones to %s\n", (unsigned)event_count, path);
+  } else {
+    fprintf(stderr, "Unable to write the profile trace to %s\n", path);
+  }
+  return ok;
+}
+
+std::vector<ProfileZoneStats> getProfileStats() {
+  uint64_t const now = getProfileTime();
+  uint64_t const since = (now > STATS_WINDOW) ? now - STATS_WINDOW : 0;
+
+  // Durations by zone name. Equal names may be distinct literals, so compare contents.
+  std::map<std::string, std::vector<uint64_t>> durations;
+  {
+    std::lock_guard<std::mutex> lock{g_logs_mutex};
+    for (std::unique_ptr<ThreadLog> const& log : g_logs) {
+      for (ProfileEvent const& event : ReadLog(*log)) {
+        if (event.end >= since) {
+          durations[event.name].push_back(event.end - event.begin);
+        }
+      }
+    }
+  }
+
+  std::vector<ProfileZoneStats> stats;
+  for (auto& zone : durations) {
+    std::vector<uint64_t>& samples = zone.second;
+    std::sort(samples.begin(), samples.end());
+
+    // Nearest-rank percentiles, in milliseconds.
+    auto percentile = [&samples](double p) {
+      size_t const rank = (size_t)std::ceil(p * samples.size());
+      return samples[std::max(rank, (size_t)1) - 1] / 1e6;
+    };
+    stats.push_back(ProfileZoneStats{zone.first, samples.size(), percentile(0.50), percentile(0.95), percentile(0.99)});
+  }
+  return stats;
+}
+
+void printProfileStats() {
+  std::vector<ProfileZoneStats> const stats = getProfileStats();
+  printf("Profiled zones over the last %.0f s:\n", STATS_WINDOW / 1e9);
+  printf("  %-28s %8s %9s %9s %9s\n", "zone", "count", "p50 ms", "p95 ms", "p99 ms");
+  for (ProfileZoneStats const& zone : stats) {
+    printf("  %-28s %8u %9.3f %9.3f %9.3f\n", zone.name.c_str(), (unsigned)zone.count, zone.p50, zone.p95, zone.p99);
+  }
+}
+
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A scoped-zone CPU profiler.
+//
+// The profiler is only compiled in when PROFILER is defined (configure with
+// -DPROFILER=ON). Otherwise PROFILE_ZONE expands to nothing and every function
+// below is an empty inline, so normal builds pay nothing for it.
+//
+// When compiled in, each PROFILE_ZONE records its name and its start and end
+// times, in nanoseconds, into a buffer belonging to the calling thread. Recording
+// takes no locks: each buffer is a ring with a single writer, holding that
+// thread's most recent zones. The buffers can be dumped as a Chrome trace (for
+// chrome://tracing or https://ui.perfetto.dev), and summarized as percentiles of
+// each zone's duration over the last few seconds.
+
+// Duration statistics for all of the zones with one name.
+struct ProfileZoneStats {
+  std::string name;
+  size_t count;  // Zones which ended within the window
+  double p50, p95, p99;  // In milliseconds
+};
+
+#ifdef PROFILER
+
+// Nanoseconds since the profiler's clock started.
+uint64_t getProfileTime();
+
+// Records a zone on the calling thread. `name` must outlive the profiler; a string literal, say.
+void recordProfileZone(char const* name, uint64_t begin, uint64_t end);
+
+// Records a zone on the GPU's track, with times already on the profiler's clock.
+// Call from the GL thread only; see gpuprofile.h.
+void recordGpuProfileZone(char const* name, uint64_t begin, uint64_t end);
+
+// Names the calling thread in traces.
+void nameProfileThread(char const* name);
+
+// Writes every thread's recorded zones to a Chrome trace JSON file, named by the
+// COMP465_PROFILE_TRACE environment variable ("trace.json" by default).
+bool writeProfileTrace();
+
+// Returns statistics for each zone name, over zones which ended in the last few seconds.
+std::vector<ProfileZoneStats> getProfileStats();
+
+// Prints getProfileStats() as a table.
+void printProfileStats();
+
+// Records the lifetime of this object as a zone.
+class ProfileZone {
+private:
+  char const* name;
+  uint64_t begin;
+
+public:
+  explicit ProfileZone(char const* name)
+    : name{name}, begin{getProfileTime()}
+  {}
+
+  ~ProfileZone() {
+    recordProfileZone(this->name, this->begin, getProfileTime());
+  }
+
+  ProfileZone(ProfileZone const&) = delete;
+  ProfileZone& operator=(ProfileZone const&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// Profiles the rest of the enclosing scope under the given name.
+#define PROFILE_ZONE(name) ProfileZone const PROFILE_CONCAT(profile_zone_, __LINE__){(name)}
+
+#else
+
+inline void nameProfileThread(char const* /*name*/) {}
+inline bool writeProfileTrace() { return false; }
+inline std::vector<ProfileZoneStats> getProfileStats() { return std::vector<ProfileZoneStats>{}; }
+inline void printProfileStats() {}
+
+#define PROFILE_ZONE(name) ((void)0)
+
+#endif